@@ -164,6 +164,7 @@ where
                 key: OrderingKey::NameVersion as i32,
             }),
             publisher_email: String::new(),
+            continuation_token: String::new(),
         }))
         .await?
         .into_inner()
@@ -337,6 +337,110 @@ where
     _get_channel(key)
 }
 
+#[cfg(any(test, feature = "runtime"))]
+fn _get_channel_batch<S>(key: S, offset: usize, count: usize) -> Result<Channel, Error>
+where
+    S: AsRef<str>,
+{
+    let mut size: u64 = 0;
+    host_call!(raw::get_input_batch_len(
+        key.as_ref().as_ptr(),
+        key.as_ref().as_bytes().len(),
+        offset as u64,
+        count as u64,
+        &mut size as *mut u64
+    ))?;
+
+    let mut value_buffer = Vec::with_capacity(size as usize);
+    host_call!(raw::get_input_batch(
+        key.as_ref().as_ptr(),
+        key.as_ref().as_bytes().len(),
+        offset as u64,
+        count as u64,
+        value_buffer.as_mut_ptr(),
+        size as usize,
+    ))?;
+    unsafe {
+        value_buffer.set_len(size as usize);
+    }
+    Channel::decode(value_buffer.as_slice()).map_err(|e| e.into())
+}
+
+/// Get at most `count` values starting at `offset` from the input designated by `key`
+///
+/// The returned channel has the same type as the input and
+/// is empty when `offset` is past the last value of the input.
+#[cfg(feature = "runtime")]
+pub fn get_channel_batch<S>(key: S, offset: usize, count: usize) -> Result<Channel, Error>
+where
+    S: AsRef<str>,
+{
+    _get_channel_batch(key, offset, count)
+}
+
+#[cfg(any(test, feature = "runtime"))]
+fn _get_channel_buffer_len<S>(
+    key: S,
+) -> Result<(usize, Option<firm_types::functions::ChannelType>), Error>
+where
+    S: AsRef<str>,
+{
+    let mut len: u64 = 0;
+    let mut channel_type: i32 = -1;
+    host_call!(raw::get_input_buffer_len(
+        key.as_ref().as_ptr(),
+        key.as_ref().as_bytes().len(),
+        &mut len as *mut u64,
+        &mut channel_type as *mut i32
+    ))
+    .map(|_| {
+        (
+            len as usize,
+            firm_types::functions::ChannelType::from_i32(channel_type),
+        )
+    })
+}
+
+/// Get the size in bytes and the type of the input designated by `key` as a buffer
+///
+/// The type is `None` if the input has no values. String inputs can not be
+/// read as a buffer and have a size of 0.
+#[cfg(feature = "runtime")]
+pub fn get_channel_buffer_len<S>(
+    key: S,
+) -> Result<(usize, Option<firm_types::functions::ChannelType>), Error>
+where
+    S: AsRef<str>,
+{
+    _get_channel_buffer_len(key)
+}
+
+#[cfg(any(test, feature = "runtime"))]
+fn _read_channel_buffer<S>(key: S, buffer: &mut [u8]) -> Result<(), Error>
+where
+    S: AsRef<str>,
+{
+    host_call!(raw::get_input_buffer(
+        key.as_ref().as_ptr(),
+        key.as_ref().as_bytes().len(),
+        buffer.as_mut_ptr(),
+        buffer.len()
+    ))
+}
+
+/// Read the values of the input designated by `key` straight into `buffer`
+///
+/// Values are packed little endian, integers and floats as 8 bytes
+/// and booleans and bytes as 1 byte each. Use `get_channel_buffer_len`
+/// to get the required size of `buffer`.
+#[cfg(feature = "runtime")]
+pub fn read_channel_buffer<S>(key: S, buffer: &mut [u8]) -> Result<(), Error>
+where
+    S: AsRef<str>,
+{
+    _read_channel_buffer(key, buffer)
+}
+
 /// get an input for the function designated by `key`
 pub fn get_input<S, T>(key: S) -> InputValue<T>
 where
@@ -457,6 +561,7 @@ pub mod runtime_context {
                 code: None,
                 entrypoint: "in-here".to_owned(),
                 name: "Yaharr!".to_owned(),
+                attachments: vec![],
             };
             write_context!("super-context", written_ctx);
             let r = RuntimeContext::from_file("super-context");
@@ -477,7 +582,8 @@ pub mod net {
     use std::{
         fs::File,
         io::{self, Read, Write},
-        os::wasi::io::FromRawFd,
+        os::wasi::io::{AsRawFd, FromRawFd, RawFd},
+        time::Duration,
     };
 
     use super::{raw, ToResult};
@@ -503,6 +609,79 @@ pub mod net {
         }
     }
 
+    impl AsRawFd for TcpConnection {
+        fn as_raw_fd(&self) -> RawFd {
+            self.file.as_raw_fd()
+        }
+    }
+
+    pub const POLL_READABLE: u16 = 1;
+    pub const POLL_WRITABLE: u16 = 2;
+    pub const POLL_HANGUP: u16 = 4;
+    pub const POLL_ERROR: u16 = 8;
+
+    const POLL_KIND_SOCKET: u16 = 0;
+    const POLL_KIND_PROCESS: u16 = 1;
+
+    /// Something to wait for with `poll`
+    ///
+    /// This has the same layout as on the host. After polling, `revents`
+    /// contains what the socket or process is ready for.
+    #[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+    #[repr(C)]
+    pub struct PollEntry {
+        id: u64,
+        kind: u16,
+        events: u16,
+        revents: u16,
+        reserved: u16,
+    }
+
+    impl PollEntry {
+        /// Wait for the socket with file descriptor `fd` to be ready for `events`
+        pub fn socket(fd: RawFd, events: u16) -> Self {
+            Self {
+                id: fd as u64,
+                kind: POLL_KIND_SOCKET,
+                events,
+                ..Default::default()
+            }
+        }
+
+        /// Wait for the host process `pid` to exit, it is then readable
+        pub fn process(pid: u64) -> Self {
+            Self {
+                id: pid,
+                kind: POLL_KIND_PROCESS,
+                events: POLL_READABLE,
+                ..Default::default()
+            }
+        }
+
+        pub fn revents(&self) -> u16 {
+            self.revents
+        }
+    }
+
+    /// Wait for any of `entries` to become ready
+    ///
+    /// A `timeout` of `None` waits until at least one entry is ready.
+    /// Returns the number of ready entries.
+    pub fn poll(
+        entries: &mut [PollEntry],
+        timeout: Option<Duration>,
+    ) -> Result<usize, super::Error> {
+        let mut ready: u32 = 0;
+        host_call!(raw::poll(
+            entries.as_mut_ptr(),
+            entries.len(),
+            timeout.map_or(-1, |timeout| timeout.as_millis() as i64),
+            &mut ready as *mut u32
+        ))?;
+
+        Ok(ready as usize)
+    }
+
     pub fn connect<S: AsRef<str>>(address: S) -> Result<TcpConnection, super::Error> {
         let mut file_descriptor: i32 = 0;
         host_call!(raw::connect(
@@ -557,6 +736,35 @@ pub mod net {
             assert!(tcp_connection.is_err());
             assert!(matches!(tcp_connection.unwrap_err(), Error::HostError(_)));
         }
+
+        #[test]
+        fn test_poll() {
+            MockResultRegistry::set_poll_impl(|entries, timeout_ms| {
+                assert_eq!(timeout_ms, 250);
+                assert_eq!(entries.len(), 2);
+                entries[1] = net::PollEntry {
+                    revents: net::POLL_READABLE,
+                    ..entries[1]
+                };
+                Ok(1)
+            });
+
+            let mut entries = [
+                net::PollEntry::socket(3, net::POLL_READABLE | net::POLL_WRITABLE),
+                net::PollEntry::process(1337),
+            ];
+            let ready = net::poll(&mut entries, Some(std::time::Duration::from_millis(250)));
+            assert!(matches!(ready, Ok(1)));
+            assert_eq!(entries[0].revents(), 0);
+            assert_eq!(entries[1].revents(), net::POLL_READABLE);
+
+            MockResultRegistry::set_poll_impl(|_, timeout_ms| {
+                assert_eq!(timeout_ms, -1, "No timeout must wait forever");
+                Err(18)
+            });
+            let ready = net::poll(&mut entries, None);
+            assert!(matches!(ready.unwrap_err(), Error::HostError(18)));
+        }
     }
 }
 
@@ -738,6 +946,49 @@ mod tests {
         assert!(matches!(res.unwrap_err(), Error::HostError(_)));
     }
 
+    #[test]
+    fn test_get_channel_batch() {
+        MockResultRegistry::set_input_stream(
+            firm_types::stream!({"values" => vec![1i64, 2i64, 3i64]}),
+        );
+
+        let res = _get_channel_batch("values", 1, 5);
+        assert!(res.is_ok());
+        assert_eq!(
+            <Vec<i64> as TryFromChannel>::try_from(&res.unwrap()).unwrap(),
+            vec![2i64, 3i64]
+        );
+
+        let res = _get_channel_batch("values", 3, 5);
+        assert!(res.is_ok());
+        assert!(matches!(res.unwrap().value, Some(ValueType::Integers(x)) if x.values.is_empty()));
+
+        let res = _get_channel_batch("not-values", 0, 5);
+        assert!(res.is_err());
+        assert!(matches!(res.unwrap_err(), Error::HostError(_)));
+    }
+
+    #[test]
+    fn test_read_channel_buffer() {
+        MockResultRegistry::set_input_stream(
+            firm_types::stream!({"values" => vec![1i64, 2i64], "text" => "string"}),
+        );
+
+        let (len, channel_type) = _get_channel_buffer_len("values").unwrap();
+        assert_eq!(16, len);
+        assert_eq!(Some(firm_types::functions::ChannelType::Int), channel_type);
+
+        let mut buffer = vec![0u8; len];
+        assert!(_read_channel_buffer("values", &mut buffer).is_ok());
+        assert_eq!([1i64.to_le_bytes(), 2i64.to_le_bytes()].concat(), buffer);
+
+        let res = _read_channel_buffer("text", &mut []);
+        assert!(matches!(res.unwrap_err(), Error::HostError(19)));
+
+        let res = _get_channel_buffer_len("not-values");
+        assert!(matches!(res.unwrap_err(), Error::HostError(_)));
+    }
+
     #[test]
     fn test_set_output() {
         // String
@@ -7,7 +7,7 @@ use std::{
 use firm_types::{
     functions::{Attachment, Channel, Stream},
     prost::Message,
-    stream::StreamExt,
+    stream::{ChannelExt, StreamExt},
     wasi::StartProcessRequest,
 };
 use lazy_static::lazy_static;
@@ -147,6 +147,67 @@ pub unsafe fn get_input(
     MockResultRegistry::execute_get_input(key_ptr, key_len, value_ptr, value_len)
 }
 
+/// Get length of a batch of values from an input
+///
+/// # Safety
+/// This is a mock implementation and while it uses
+/// unsafe functions it does nothing technically unsafe
+pub unsafe fn get_input_batch_len(
+    key_ptr: *const u8,
+    key_len: usize,
+    offset: u64,
+    count: u64,
+    value: *mut u64,
+) -> u32 {
+    MockResultRegistry::execute_get_input_batch_len(key_ptr, key_len, offset, count, value)
+}
+
+/// Get a batch of values from a function input
+///
+/// # Safety
+/// This is a mock implementation and while it uses
+/// unsafe functions it does nothing technically unsafe
+pub unsafe fn get_input_batch(
+    key_ptr: *const u8,
+    key_len: usize,
+    offset: u64,
+    count: u64,
+    value_ptr: *mut u8,
+    value_len: usize,
+) -> u32 {
+    MockResultRegistry::execute_get_input_batch(
+        key_ptr, key_len, offset, count, value_ptr, value_len,
+    )
+}
+
+/// Get the size and type of a function input as a buffer
+///
+/// # Safety
+/// This is a mock implementation and while it uses
+/// unsafe functions it does nothing technically unsafe
+pub unsafe fn get_input_buffer_len(
+    key_ptr: *const u8,
+    key_len: usize,
+    len: *mut u64,
+    channel_type: *mut i32,
+) -> u32 {
+    MockResultRegistry::execute_get_input_buffer_len(key_ptr, key_len, len, channel_type)
+}
+
+/// Get the values of a function input as a buffer
+///
+/// # Safety
+/// This is a mock implementation and while it uses
+/// unsafe functions it does nothing technically unsafe
+pub unsafe fn get_input_buffer(
+    key_ptr: *const u8,
+    key_len: usize,
+    buffer_ptr: *mut u8,
+    buffer_len: usize,
+) -> u32 {
+    MockResultRegistry::execute_get_input_buffer(key_ptr, key_len, buffer_ptr, buffer_len)
+}
+
 /// Set a function output
 ///
 /// # Safety
@@ -180,6 +241,21 @@ pub unsafe fn connect(addr_ptr: *const u8, addr_len: usize, file_descriptor: *mu
     MockResultRegistry::execute_connect(addr_ptr, addr_len, file_descriptor)
 }
 
+#[cfg(feature = "net")]
+/// Poll sockets and host processes for readiness
+///
+/// # Safety
+/// This is a mock implementation and while it uses
+/// unsafe functions it does nothing technically unsafe
+pub unsafe fn poll(
+    entries_ptr: *mut crate::net::PollEntry,
+    entries_len: usize,
+    timeout_ms: i64,
+    ready: *mut u32,
+) -> u32 {
+    MockResultRegistry::execute_poll(entries_ptr, entries_len, timeout_ms, ready)
+}
+
 lazy_static! {
     static ref MOCK_RESULT_REGISTRY: Mutex<MockResultRegistry> =
         Mutex::new(MockResultRegistry::default());
@@ -203,11 +279,16 @@ pub struct MockResultRegistry {
     run_host_process_closure: MockCallbacks<dyn Fn(StartProcessRequest) -> Result<i32, u32> + Send>,
     get_input_len_closure: MockCallbacks<dyn Fn(&str) -> Result<usize, u32> + Send>,
     get_input_closure: MockCallbacks<dyn Fn(&str) -> Result<Channel, u32> + Send>,
+    get_input_batch_closure: MockCallbacks<dyn Fn(&str, u64, u64) -> Result<Channel, u32> + Send>,
     set_output_closure: MockCallbacks<dyn Fn(&str, Channel) -> Result<(), u32> + Send>,
     set_error_closure: MockCallbacks<dyn Fn(&str) -> Result<(), u32> + Send>,
 
     #[cfg(feature = "net")]
     connect_closure: MockCallbacks<dyn Fn(&str) -> Result<i32, u32> + Send>,
+
+    #[cfg(feature = "net")]
+    poll_closure:
+        MockCallbacks<dyn Fn(&mut [crate::net::PollEntry], i64) -> Result<u32, u32> + Send>,
 }
 
 impl MockResultRegistry {
@@ -603,6 +684,142 @@ impl MockResultRegistry {
             )
     }
 
+    fn execute_get_input_buffer_len(
+        key_ptr: *const u8,
+        len: usize,
+        buffer_len: *mut u64,
+        channel_type: *mut i32,
+    ) -> u32 {
+        let key = unsafe {
+            let slice = std::slice::from_raw_parts(key_ptr, len);
+            std::str::from_utf8(slice).unwrap()
+        };
+
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .get_input_closure
+            .get(&thread::current().id())
+            .map_or_else(
+                || 1,
+                |c| match c(key) {
+                    Ok(f) => {
+                        unsafe {
+                            *buffer_len = f.buffer_len().unwrap_or_default() as u64;
+                            *channel_type = f.channel_type().map_or(-1, |t| t as i32);
+                        }
+                        0
+                    }
+                    Err(e) => e,
+                },
+            )
+    }
+
+    fn execute_get_input_buffer(
+        key_ptr: *const u8,
+        len: usize,
+        buffer: *mut u8,
+        buffer_len: usize,
+    ) -> u32 {
+        let key = unsafe {
+            let slice = std::slice::from_raw_parts(key_ptr, len);
+            std::str::from_utf8(slice).unwrap()
+        };
+
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .get_input_closure
+            .get(&thread::current().id())
+            .map_or_else(
+                || 1,
+                |c| match c(key) {
+                    // same error code as the host uses for strings
+                    Ok(f) => f
+                        .write_buffer(unsafe { std::slice::from_raw_parts_mut(buffer, buffer_len) })
+                        .map_or(19, |_| 0),
+                    Err(e) => e,
+                },
+            )
+    }
+
+    /// Set the implementation used for both `get_input_batch_len` and `get_input_batch`
+    pub fn set_get_input_batch_impl<F>(closure: F)
+    where
+        F: Fn(&str, u64, u64) -> Result<Channel, u32> + 'static + Send,
+    {
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .get_input_batch_closure
+            .insert(thread::current().id(), Box::new(closure));
+    }
+
+    fn execute_get_input_batch_len(
+        key_ptr: *const u8,
+        len: usize,
+        offset: u64,
+        count: u64,
+        value: *mut u64,
+    ) -> u32 {
+        let key = unsafe {
+            let slice = std::slice::from_raw_parts(key_ptr, len);
+            std::str::from_utf8(slice).unwrap()
+        };
+
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .get_input_batch_closure
+            .get(&thread::current().id())
+            .map_or_else(
+                || 1,
+                |c| match c(key, offset, count) {
+                    Ok(f) => {
+                        unsafe {
+                            *value = f.encoded_len() as u64;
+                        }
+                        0
+                    }
+                    Err(e) => e,
+                },
+            )
+    }
+
+    fn execute_get_input_batch(
+        key_ptr: *const u8,
+        len: usize,
+        offset: u64,
+        count: u64,
+        value: *mut u8,
+        value_len: usize,
+    ) -> u32 {
+        let key = unsafe {
+            let slice = std::slice::from_raw_parts(key_ptr, len);
+            std::str::from_utf8(slice).unwrap()
+        };
+
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .get_input_batch_closure
+            .get(&thread::current().id())
+            .map_or_else(
+                || 1,
+                |c| match c(key, offset, count) {
+                    Ok(f) => {
+                        let mut buff = Vec::with_capacity(value_len);
+                        f.encode(&mut buff).unwrap();
+                        unsafe {
+                            buff.as_ptr().copy_to(value, value_len);
+                        }
+                        0
+                    }
+                    Err(e) => e,
+                },
+            )
+    }
+
     pub fn set_set_output_impl<F>(closure: F)
     where
         F: Fn(&str, Channel) -> Result<(), u32> + 'static + Send,
@@ -714,6 +931,45 @@ impl MockResultRegistry {
             )
     }
 
+    #[cfg(feature = "net")]
+    pub fn set_poll_impl<F>(closure: F)
+    where
+        F: Fn(&mut [crate::net::PollEntry], i64) -> Result<u32, u32> + 'static + Send,
+    {
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .poll_closure
+            .insert(thread::current().id(), Box::new(closure));
+    }
+
+    #[cfg(feature = "net")]
+    fn execute_poll(
+        entries_ptr: *mut crate::net::PollEntry,
+        entries_len: usize,
+        timeout_ms: i64,
+        ready: *mut u32,
+    ) -> u32 {
+        let entries = unsafe { std::slice::from_raw_parts_mut(entries_ptr, entries_len) };
+        MOCK_RESULT_REGISTRY
+            .lock()
+            .unwrap()
+            .poll_closure
+            .get(&thread::current().id())
+            .map_or_else(
+                || 1,
+                |c| match c(entries, timeout_ms) {
+                    Ok(count) => {
+                        unsafe {
+                            *ready = count;
+                        }
+                        0
+                    }
+                    Err(e) => e,
+                },
+            )
+    }
+
     pub fn set_input_stream(stream: Stream) {
         let channel_lengths: HashMap<String, usize> = stream
             .channels
@@ -725,6 +981,14 @@ impl MockResultRegistry {
             Some(len) => Ok(*len),
         });
 
+        let batch_stream = stream.clone();
+        MockResultRegistry::set_get_input_batch_impl(move |key, offset, count| {
+            batch_stream
+                .get_channel(key)
+                .map(|channel| channel.slice(offset as usize, count as usize))
+                .ok_or(1)
+        });
+
         MockResultRegistry::set_get_input_impl(move |key| match stream.get_channel(key) {
             None => Err(1),
             Some(channel) => Ok(channel.clone()),
@@ -42,6 +42,33 @@ extern "C" {
         value_ptr: *mut u8,
         value_len: usize,
     ) -> u32;
+    pub fn get_input_batch_len(
+        key_ptr: *const u8,
+        key_len: usize,
+        offset: u64,
+        count: u64,
+        value: *mut u64,
+    ) -> u32;
+    pub fn get_input_batch(
+        key_ptr: *const u8,
+        key_len: usize,
+        offset: u64,
+        count: u64,
+        value_ptr: *mut u8,
+        value_len: usize,
+    ) -> u32;
+    pub fn get_input_buffer_len(
+        key_ptr: *const u8,
+        key_len: usize,
+        len: *mut u64,
+        channel_type: *mut i32,
+    ) -> u32;
+    pub fn get_input_buffer(
+        key_ptr: *const u8,
+        key_len: usize,
+        buffer_ptr: *mut u8,
+        buffer_len: usize,
+    ) -> u32;
     pub fn set_output(
         key_ptr: *const u8,
         key_len: usize,
@@ -52,4 +79,12 @@ extern "C" {
 
     #[cfg(feature = "net")]
     pub fn connect(addr_ptr: *const u8, addr_len: usize, file_descriptor: *mut i32) -> u32;
+
+    #[cfg(feature = "net")]
+    pub fn poll(
+        entries_ptr: *mut crate::net::PollEntry,
+        entries_len: usize,
+        timeout_ms: i64,
+        ready: *mut u32,
+    ) -> u32;
 }
@@ -0,0 +1,154 @@
+//! Building blocks for in-process caches of registry responses
+use std::{
+    collections::{BTreeMap, HashMap, VecDeque},
+    hash::Hash,
+    sync::Mutex,
+};
+
+use crate::functions::Filters;
+
+#[derive(Debug)]
+struct Entries<K, V> {
+    values: HashMap<K, V>,
+    order: VecDeque<K>,
+}
+
+/// Thread safe map that evicts the oldest entry when full
+///
+/// A poisoned lock only means that some other request panicked while using
+/// the cache, so that is treated as a miss instead of failing this request too.
+#[derive(Debug)]
+pub struct BoundedCache<K, V> {
+    entries: Mutex<Entries<K, V>>,
+    max_entries: usize,
+}
+
+impl<K: Hash + Eq + Clone, V> BoundedCache<K, V> {
+    pub fn new(max_entries: usize) -> Self {
+        Self {
+            entries: Mutex::new(Entries {
+                values: HashMap::new(),
+                order: VecDeque::new(),
+            }),
+            max_entries,
+        }
+    }
+
+    pub fn get(&self, key: &K) -> Option<V>
+    where
+        V: Clone,
+    {
+        self.modify(key, |value| value.clone())
+    }
+
+    /// Call `f` with the value for `key`, if there is one, and return what it returns
+    pub fn modify<F, R>(&self, key: &K, f: F) -> Option<R>
+    where
+        F: FnOnce(&mut V) -> R,
+    {
+        self.entries
+            .lock()
+            .ok()
+            .and_then(|mut entries| entries.values.get_mut(key).map(f))
+    }
+
+    /// Insert `value` as `key`, replacing a value does not change when it is evicted
+    pub fn insert(&self, key: K, value: V) {
+        if let Ok(mut entries) = self.entries.lock() {
+            if entries.values.insert(key.clone(), value).is_none() {
+                entries.order.push_back(key);
+            }
+
+            while entries.order.len() > self.max_entries {
+                if let Some(oldest) = entries.order.pop_front() {
+                    entries.values.remove(&oldest);
+                }
+            }
+        }
+    }
+
+    /// Remove all entries with a key that `keep` returns false for
+    pub fn retain<F: Fn(&K) -> bool>(&self, keep: F) {
+        if let Ok(mut entries) = self.entries.lock() {
+            entries.values.retain(|key, _| keep(key));
+            entries.order.retain(|key| keep(key));
+        }
+    }
+}
+
+/// Cache key for everything in `filters` except the name
+///
+/// Callers add the name themselves, as part of the key or next to it.
+pub fn listing_query(filters: &Filters) -> String {
+    format!(
+        "{:?}|{:?}|{:?}|{}|{}",
+        filters
+            .version_requirement
+            .as_ref()
+            .map(|requirement| &requirement.expression),
+        filters.metadata.iter().collect::<BTreeMap<_, _>>(),
+        filters
+            .order
+            .as_ref()
+            .map(|order| (order.key, order.reverse, order.offset, order.limit)),
+        filters.publisher_email,
+        filters.continuation_token,
+    )
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use crate::{filters, functions::VersionRequirement};
+
+    #[test]
+    fn bounded() {
+        let cache = BoundedCache::new(2);
+        cache.insert("sune", 1);
+        cache.insert("rune", 2);
+        assert_eq!(cache.get(&"sune"), Some(1));
+
+        // replacing a value keeps its place in line
+        cache.insert("sune", 3);
+        cache.insert("bune", 4);
+        assert!(
+            cache.get(&"sune").is_none(),
+            "The oldest entry must be evicted first"
+        );
+        assert_eq!(cache.get(&"rune"), Some(2));
+        assert_eq!(cache.get(&"bune"), Some(4));
+
+        assert_eq!(
+            cache.modify(&"rune", |value| std::mem::replace(value, 5)),
+            Some(2)
+        );
+        assert_eq!(cache.get(&"rune"), Some(5));
+        assert!(cache.modify(&"sune", |_| ()).is_none());
+
+        cache.retain(|key| *key != "rune");
+        assert!(cache.get(&"rune").is_none());
+        cache.insert("sune", 6);
+        assert_eq!(
+            cache.get(&"bune"),
+            Some(4),
+            "Removed entries must not count towards the limit"
+        );
+    }
+
+    #[test]
+    fn listing_queries() {
+        let mut filters = filters!("sune");
+        assert_eq!(listing_query(&filters), listing_query(&filters!("rune")));
+        assert_ne!(
+            listing_query(&filters),
+            listing_query(&filters!("sune", {"a" => "b"}))
+        );
+
+        let query = listing_query(&filters);
+        filters.version_requirement = Some(VersionRequirement {
+            expression: "^1".to_owned(),
+        });
+        assert_ne!(listing_query(&filters), query);
+    }
+}
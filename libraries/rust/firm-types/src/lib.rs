@@ -1,5 +1,7 @@
 pub use ::firm_protocols::*;
 
+pub mod cache;
+pub mod pagination;
 pub mod stream;
 pub mod test_helpers;
 
@@ -0,0 +1,129 @@
+//! Continuation tokens for paging through function listings
+use thiserror::Error;
+
+use crate::functions::Function;
+
+/// Separates name and version in an encoded token, never part of either
+const SEPARATOR: u8 = 0;
+
+#[derive(Error, Debug, PartialEq, Eq)]
+#[error("Invalid continuation token \"{0}\"")]
+pub struct InvalidContinuationToken(String);
+
+/// Position in a function listing to continue from
+///
+/// Listings are ordered by name and version so the last function seen is enough to
+/// know where to continue, regardless of how many functions came before it. This also
+/// makes tokens valid across registries that list the same ordering. Tokens are opaque
+/// to clients.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ContinuationToken {
+    pub name: String,
+    pub version: String,
+}
+
+impl ContinuationToken {
+    /// Create a token continuing after `function`
+    pub fn after(function: &Function) -> Self {
+        Self {
+            name: function.name.clone(),
+            version: function.version.clone(),
+        }
+    }
+
+    /// Token for the page after `functions` or an empty string if there are no more
+    ///
+    /// A page that is not full has to be the last one.
+    pub fn next_page(functions: &[Function], limit: usize) -> String {
+        match functions.last() {
+            Some(last) if limit > 0 && functions.len() >= limit => Self::after(last).encode(),
+            _ => String::new(),
+        }
+    }
+
+    pub fn encode(&self) -> String {
+        self.name
+            .bytes()
+            .chain(std::iter::once(SEPARATOR))
+            .chain(self.version.bytes())
+            .map(|b| format!("{:02x}", b))
+            .collect()
+    }
+
+    /// Decode `token`, an empty token means to start from the beginning
+    pub fn decode(token: &str) -> Result<Option<Self>, InvalidContinuationToken> {
+        if token.is_empty() {
+            return Ok(None);
+        }
+
+        let invalid = || InvalidContinuationToken(token.to_owned());
+        let bytes = (0..token.len())
+            .step_by(2)
+            .map(|i| {
+                token
+                    .get(i..i + 2)
+                    .and_then(|hex| u8::from_str_radix(hex, 16).ok())
+                    .ok_or_else(invalid)
+            })
+            .collect::<Result<Vec<u8>, _>>()?;
+
+        let mut parts = bytes.splitn(2, |b| *b == SEPARATOR);
+        match (parts.next(), parts.next()) {
+            (Some(name), Some(version)) if !name.is_empty() && !version.is_empty() => {
+                Ok(Some(Self {
+                    name: String::from_utf8(name.to_vec()).map_err(|_| invalid())?,
+                    version: String::from_utf8(version.to_vec()).map_err(|_| invalid())?,
+                }))
+            }
+            _ => Err(invalid()),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn function(name: &str, version: &str) -> Function {
+        Function {
+            name: name.to_owned(),
+            version: version.to_owned(),
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn roundtrip() {
+        let token = ContinuationToken::after(&function("sune-ö", "1.2.3-dev"));
+        let encoded = token.encode();
+        assert!(encoded.chars().all(|c| c.is_ascii_hexdigit()));
+        assert_eq!(ContinuationToken::decode(&encoded), Ok(Some(token)));
+
+        assert_eq!(ContinuationToken::decode(""), Ok(None));
+    }
+
+    #[test]
+    fn invalid() {
+        // not hex
+        assert!(ContinuationToken::decode("sune").is_err());
+        // odd length
+        assert!(ContinuationToken::decode("616").is_err());
+        // no separator
+        assert!(ContinuationToken::decode("6162").is_err());
+        // no version
+        assert!(ContinuationToken::decode("616200").is_err());
+        // not utf-8
+        assert!(ContinuationToken::decode("ff0031").is_err());
+    }
+
+    #[test]
+    fn next_page() {
+        let functions = vec![function("a", "1.0.0"), function("b", "2.0.0")];
+        assert_eq!(
+            ContinuationToken::next_page(&functions, 2),
+            ContinuationToken::after(&functions[1]).encode()
+        );
+        assert!(ContinuationToken::next_page(&functions, 3).is_empty());
+        assert!(ContinuationToken::next_page(&[], 0).is_empty());
+    }
+}
@@ -232,6 +232,128 @@ to_channel_impl!(f64, ValueType::Floats, Floats);
 // bools
 to_channel_impl!(bool, ValueType::Booleans, Booleans);
 
+/// Convenience extensions on a channel
+pub trait ChannelExt {
+    /// Get the number of values in the channel
+    fn len(&self) -> usize;
+
+    /// Check if the channel contains no values
+    fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Get a new channel with at most `count` values starting at `offset`
+    ///
+    /// The returned channel has the same type as this channel, even
+    /// when `offset` is past the last value and the result is empty.
+    fn slice(&self, offset: usize, count: usize) -> Channel;
+
+    /// Get the type of the values in the channel, `None` if it has no value
+    fn channel_type(&self) -> Option<ChannelType>;
+
+    /// Get the size in bytes of the values as one contiguous buffer
+    ///
+    /// Integers and floats take 8 bytes, booleans and bytes 1 byte per
+    /// value. Strings can not be represented as a buffer and give `None`.
+    fn buffer_len(&self) -> Option<usize>;
+
+    /// Write the values to `buffer` as little endian, packed like described in `buffer_len`
+    ///
+    /// Returns the number of bytes written, which is less than `buffer_len`
+    /// if `buffer` is too small. Strings give `None`.
+    fn write_buffer(&self, buffer: &mut [u8]) -> Option<usize>;
+}
+
+fn write_values<const N: usize, T: Copy>(
+    values: &[T],
+    buffer: &mut [u8],
+    to_le_bytes: impl Fn(T) -> [u8; N],
+) -> usize {
+    buffer
+        .chunks_exact_mut(N)
+        .zip(values)
+        .map(|(chunk, value)| chunk.copy_from_slice(&to_le_bytes(*value)))
+        .count()
+        * N
+}
+
+fn slice_values<T: Clone>(values: &[T], offset: usize, count: usize) -> Vec<T> {
+    let start = offset.min(values.len());
+    let end = start.saturating_add(count).min(values.len());
+    values[start..end].to_vec()
+}
+
+impl ChannelExt for Channel {
+    fn len(&self) -> usize {
+        match &self.value {
+            Some(ValueType::Strings(x)) => x.values.len(),
+            Some(ValueType::Integers(x)) => x.values.len(),
+            Some(ValueType::Floats(x)) => x.values.len(),
+            Some(ValueType::Booleans(x)) => x.values.len(),
+            Some(ValueType::Bytes(x)) => x.values.len(),
+            None => 0,
+        }
+    }
+
+    fn slice(&self, offset: usize, count: usize) -> Channel {
+        Channel {
+            value: self.value.as_ref().map(|value| match value {
+                ValueType::Strings(x) => ValueType::Strings(Strings {
+                    values: slice_values(&x.values, offset, count),
+                }),
+                ValueType::Integers(x) => ValueType::Integers(Integers {
+                    values: slice_values(&x.values, offset, count),
+                }),
+                ValueType::Floats(x) => ValueType::Floats(Floats {
+                    values: slice_values(&x.values, offset, count),
+                }),
+                ValueType::Booleans(x) => ValueType::Booleans(Booleans {
+                    values: slice_values(&x.values, offset, count),
+                }),
+                ValueType::Bytes(x) => ValueType::Bytes(Bytes {
+                    values: slice_values(&x.values, offset, count),
+                }),
+            }),
+        }
+    }
+
+    fn channel_type(&self) -> Option<ChannelType> {
+        self.value.as_ref().map(|value| match value {
+            ValueType::Strings(_) => ChannelType::String,
+            ValueType::Integers(_) => ChannelType::Int,
+            ValueType::Floats(_) => ChannelType::Float,
+            ValueType::Booleans(_) => ChannelType::Bool,
+            ValueType::Bytes(_) => ChannelType::Bytes,
+        })
+    }
+
+    fn buffer_len(&self) -> Option<usize> {
+        match &self.value {
+            Some(ValueType::Strings(_)) => None,
+            Some(ValueType::Integers(x)) => Some(x.values.len() * 8),
+            Some(ValueType::Floats(x)) => Some(x.values.len() * 8),
+            Some(ValueType::Booleans(x)) => Some(x.values.len()),
+            Some(ValueType::Bytes(x)) => Some(x.values.len()),
+            None => Some(0),
+        }
+    }
+
+    fn write_buffer(&self, buffer: &mut [u8]) -> Option<usize> {
+        match &self.value {
+            Some(ValueType::Strings(_)) => None,
+            Some(ValueType::Integers(x)) => Some(write_values(&x.values, buffer, i64::to_le_bytes)),
+            Some(ValueType::Floats(x)) => Some(write_values(&x.values, buffer, f64::to_le_bytes)),
+            Some(ValueType::Booleans(x)) => Some(write_values(&x.values, buffer, |b| [b as u8])),
+            Some(ValueType::Bytes(x)) => {
+                let len = x.values.len().min(buffer.len());
+                buffer[..len].copy_from_slice(&x.values[..len]);
+                Some(len)
+            }
+            None => Some(0),
+        }
+    }
+}
+
 /// Convenience extensions on a stream
 ///
 /// A stream is a collection of named
@@ -613,4 +735,69 @@ mod tests {
         assert!(r.is_err());
         assert_eq!(5, r.unwrap_err().len());
     }
+
+    #[test]
+    fn slice_channel() {
+        let channel = vec![1i64, 2, 3, 4, 5].to_channel();
+        assert_eq!(5, channel.len());
+
+        let slice = channel.slice(1, 3);
+        assert_eq!(
+            vec![2i64, 3, 4],
+            <Vec<i64> as TryFromChannel>::try_from(&slice).unwrap()
+        );
+
+        // slices are clamped to the end of the channel
+        let slice = channel.slice(3, 10);
+        assert_eq!(
+            vec![4i64, 5],
+            <Vec<i64> as TryFromChannel>::try_from(&slice).unwrap()
+        );
+
+        // slicing past the end keeps the type
+        let slice = channel.slice(10, 10);
+        assert!(slice.is_empty());
+        assert!(matches!(slice.value, Some(ValueType::Integers(_))));
+
+        let slice = vec![1u8, 2, 3].to_channel().slice(0, 2);
+        assert_eq!(&[1u8, 2], <[u8]>::try_ref_from(&slice).unwrap());
+
+        let slice = Channel { value: None }.slice(0, 10);
+        assert!(slice.value.is_none());
+    }
+
+    #[test]
+    fn channel_buffer() {
+        let channel = vec![1i64, -2].to_channel();
+        assert_eq!(Some(ChannelType::Int), channel.channel_type());
+        assert_eq!(Some(16), channel.buffer_len());
+        let mut buffer = vec![0u8; 16];
+        assert_eq!(Some(16), channel.write_buffer(&mut buffer));
+        assert_eq!([1i64.to_le_bytes(), (-2i64).to_le_bytes()].concat(), buffer);
+
+        let channel = vec![0.5f64].to_channel();
+        let mut buffer = vec![0u8; 8];
+        assert_eq!(Some(8), channel.write_buffer(&mut buffer));
+        assert_eq!(0.5f64.to_le_bytes().to_vec(), buffer);
+
+        let channel = vec![true, false, true].to_channel();
+        let mut buffer = vec![0u8; 3];
+        assert_eq!(Some(3), channel.write_buffer(&mut buffer));
+        assert_eq!(vec![1u8, 0, 1], buffer);
+
+        // a too small buffer gets as many values as fit
+        let channel = vec![1u8, 2, 3].to_channel();
+        let mut buffer = vec![0u8; 2];
+        assert_eq!(Some(2), channel.write_buffer(&mut buffer));
+        assert_eq!(vec![1u8, 2], buffer);
+
+        let channel = vec!["string"].to_channel();
+        assert_eq!(Some(ChannelType::String), channel.channel_type());
+        assert!(channel.buffer_len().is_none());
+        assert!(channel.write_buffer(&mut []).is_none());
+
+        let channel = Channel { value: None };
+        assert!(channel.channel_type().is_none());
+        assert_eq!(Some(0), channel.buffer_len());
+    }
 }
@@ -275,6 +275,7 @@ macro_rules! filters {
             }),
             version_requirement: None,
             publisher_email: String::from($publisher_email),
+            continuation_token: String::new(),
         }
     }};
 }
@@ -0,0 +1,36 @@
+;; Function for the execution benchmarks
+;;
+;; Copies the input "numbers" to the output "numbers" through guest memory,
+;; which is what a function reading and writing large channels has to do.
+(module
+  ;; unused, makes the module a WASI module
+  (import "wasi_snapshot_preview1" "proc_exit" (func $proc_exit (param i32)))
+  (import "firm" "get_input_len" (func $get_input_len (param i32 i32 i32) (result i32)))
+  (import "firm" "get_input" (func $get_input (param i32 i32 i32 i32) (result i32)))
+  (import "firm" "set_output" (func $set_output (param i32 i32 i32 i32) (result i32)))
+
+  ;; the key is at 0, the length of the value at 8 and the value in the pages after
+  (memory (export "memory") 1)
+  (data (i32.const 0) "numbers")
+
+  (func $check (param $error i32)
+    (if (local.get $error)
+      (then unreachable)))
+
+  (func (export "_start")
+    (local $len i32)
+    (local $value i32)
+    (call $check (call $get_input_len (i32.const 0) (i32.const 7) (i32.const 8)))
+    (local.set $len (i32.load (i32.const 8)))
+
+    (local.set $value
+      (memory.grow
+        (i32.div_u
+          (i32.add (local.get $len) (i32.const 65535))
+          (i32.const 65536))))
+    (if (i32.eq (local.get $value) (i32.const -1))
+      (then unreachable))
+    (local.set $value (i32.mul (local.get $value) (i32.const 65536)))
+
+    (call $check (call $get_input (i32.const 0) (i32.const 7) (local.get $value) (local.get $len)))
+    (call $check (call $set_output (i32.const 0) (i32.const 7) (local.get $value) (local.get $len)))))
@@ -0,0 +1,513 @@
+//! Benchmarks for function execution in Avery
+//!
+//! The stages of an execution (compile, instantiate, attachment mapping,
+//! argument validation and execution) are measured separately, together with
+//! the whole queue → run → result round trip through the execution service.
+//! Execution benchmarks run modules that are already compiled. Large channels
+//! are read and written by `channels.wat`, which copies its input to its
+//! output. Everything runs offline against the internal registry.
+//!
+//! Every benchmark prints one JSON line with its name, the iteration count,
+//! the total and per-iteration nanoseconds and, where it makes sense, the
+//! throughput. `AVERY_BENCH_ITERATIONS` overrides the number of iterations.
+//!
+//! The Python benchmarks need the Python runtime and the `hello` example
+//! function, which are built with nix. Point `AVERY_BENCH_RUNTIMES_DIR` to a
+//! runtime directory containing the Python runtime and
+//! `AVERY_BENCH_PYTHON_HELLO` to the packaged `hello` example to run them.
+use std::{
+    collections::HashMap,
+    path::{Path, PathBuf},
+    time::{Duration, Instant},
+};
+
+use sha2::{Digest, Sha256};
+use slog::o;
+use wasmer::{Instance, Module};
+use wasmer_wasi::WasiState;
+
+use avery::{
+    auth::AuthService,
+    config::{Compiler, CompilerConfig, InternalRegistryConfig},
+    executor::{AttachmentDownload, ExecutionService},
+    registry::RegistryService,
+    runtime::{
+        filesystem_source::FileSystemSource,
+        wasi::{compiler, WasiRuntime},
+        FunctionDirectory, InternalRuntimeSource, RuntimeParameters, RuntimeSource,
+    },
+};
+use firm_types::{
+    functions::{
+        execution_server::Execution, registry_server::Registry, Attachment, AttachmentStreamUpload,
+        AttachmentUrl, AuthMethod, ChannelSpec, ChannelType, ExecutionParameters, RuntimeSpec,
+        Stream,
+    },
+    stream::{StreamExt, ToChannel},
+    tonic,
+};
+
+use firm_types::{attachment_data, channel_specs, filters, function_data, stream};
+
+const HELLO_WASM: &[u8] = include_bytes!("../src/runtime/hello.wasm");
+
+/// Function copying the channel "numbers" from its input to its output
+const CHANNELS_WAT: &str = include_str!("channels.wat");
+
+/// Number of values in the large channels
+const LARGE_INPUT_LEN: usize = 1_000_000;
+
+/// Size of the attachment used for attachment mapping
+const ATTACHMENT_SIZE: usize = 16 * 1024 * 1024;
+
+/// Number of iterations for each benchmark unless `AVERY_BENCH_ITERATIONS` is set
+const DEFAULT_ITERATIONS: u32 = 100;
+
+macro_rules! null_logger {
+    () => {{
+        slog::Logger::root(slog::Discard, o!())
+    }};
+}
+
+#[derive(Clone, Copy)]
+enum Throughput {
+    Bytes(u64),
+    Elements(u64),
+}
+
+fn iterations() -> u32 {
+    std::env::var("AVERY_BENCH_ITERATIONS")
+        .ok()
+        .and_then(|iterations| iterations.parse().ok())
+        .unwrap_or(DEFAULT_ITERATIONS)
+}
+
+/// Run `routine` `iterations` times, after one warm-up run, and print the result
+///
+/// Only `routine` is timed, `setup` runs before every iteration and the
+/// output of `routine` is dropped after the clock is stopped.
+fn bench<I, O>(
+    name: &str,
+    iterations: u32,
+    throughput: Option<Throughput>,
+    mut setup: impl FnMut() -> I,
+    mut routine: impl FnMut(I) -> O,
+) {
+    drop(routine(setup()));
+
+    let mut total = Duration::default();
+    for _ in 0..iterations {
+        let input = setup();
+        let started = Instant::now();
+        let output = routine(input);
+        total += started.elapsed();
+        drop(output);
+    }
+
+    let mut result = serde_json::json!({
+        "name": name,
+        "iterations": iterations,
+        "total_ns": total.as_nanos() as u64,
+        "per_iteration_ns": (total / iterations.max(1)).as_nanos() as u64,
+    });
+    let per_second = |amount: u64| amount as f64 * f64::from(iterations) / total.as_secs_f64();
+    match throughput {
+        Some(Throughput::Bytes(bytes)) => {
+            result["bytes_per_second"] = per_second(bytes).into();
+        }
+        Some(Throughput::Elements(elements)) => {
+            result["elements_per_second"] = per_second(elements).into();
+        }
+        None => {}
+    }
+    println!("{}", result);
+}
+
+fn file_attachment(path: &Path) -> Attachment {
+    Attachment {
+        name: "code".to_owned(),
+        url: Some(AttachmentUrl {
+            url: url::Url::from_file_path(path.canonicalize().unwrap())
+                .unwrap()
+                .to_string(),
+            auth_method: AuthMethod::None as i32,
+        }),
+        ..Default::default()
+    }
+}
+
+/// Directory with `code` written to the file "code"
+fn code_dir(code: &[u8]) -> tempfile::TempDir {
+    let dir = tempfile::TempDir::new().unwrap();
+    std::fs::write(dir.path().join("code"), code).unwrap();
+    dir
+}
+
+/// Compile `code` like an execution with the `kind` compiler does
+fn compile_code(kind: Compiler, code: &[u8]) -> Module {
+    let dir = code_dir(code);
+    compiler::compile(kind, &dir.path().join("code"), &null_logger!())
+        .unwrap()
+        .1
+}
+
+fn large_input() -> Stream {
+    let mut s = Stream::new();
+    s.set_channel(
+        "numbers",
+        (0..LARGE_INPUT_LEN as i64).collect::<Vec<_>>().to_channel(),
+    );
+    s
+}
+
+fn large_channel_specs() -> HashMap<String, ChannelSpec> {
+    channel_specs!({
+        "numbers" => ChannelSpec {
+            description: "A lot of numbers".to_owned(),
+            r#type: ChannelType::Int as i32,
+        }
+    })
+    .0
+}
+
+/// Execution service with `code` registered as the function "bench-function"
+///
+/// The function takes `channels` as required inputs and has them as outputs.
+struct BenchFunction {
+    execution_service: ExecutionService,
+    name: String,
+    version: String,
+    _root_dir: tempfile::TempDir,
+}
+
+impl BenchFunction {
+    fn new(
+        runtime: RuntimeSpec,
+        code: Vec<u8>,
+        channels: HashMap<String, ChannelSpec>,
+        runtime_source: Box<dyn RuntimeSource>,
+    ) -> Self {
+        let registry_service =
+            RegistryService::new(InternalRegistryConfig::default(), null_logger!()).unwrap();
+        let sha256 = format!("{:x}", Sha256::digest(&code));
+
+        let code_attachment = futures::executor::block_on(
+            registry_service
+                .register_attachment(tonic::Request::new(attachment_data!("code", &sha256))),
+        )
+        .unwrap()
+        .into_inner();
+        futures::executor::block_on(registry_service.upload_stream_attachment(
+            tonic::Request::new(futures::stream::iter(vec![Ok(AttachmentStreamUpload {
+                id: code_attachment.id.clone(),
+                content: code,
+            })])),
+        ))
+        .unwrap();
+
+        futures::executor::block_on(registry_service.register(tonic::Request::new(
+            function_data!(
+                "bench-function",
+                "1.0.0",
+                runtime,
+                code_attachment.id,
+                channels.clone(),
+                channel_specs!({}).0,
+                channels,
+                "Publisher",
+                "publisher@company.com",
+                [], // attachments
+                {}  // metadata
+            ),
+        )))
+        .unwrap();
+
+        let function =
+            futures::executor::block_on(registry_service.list(tonic::Request::new(filters!())))
+                .unwrap()
+                .into_inner()
+                .functions
+                .remove(0);
+
+        let root_dir = tempfile::TempDir::new().unwrap();
+        Self {
+            execution_service: ExecutionService::new(
+                null_logger!(),
+                registry_service,
+                vec![runtime_source],
+                AuthService::default(),
+                root_dir.path(),
+            )
+            .unwrap(),
+            name: function.name,
+            version: function.version,
+            _root_dir: root_dir,
+        }
+    }
+
+    /// Queue the function, run it and wait for the result
+    async fn execute(&self, arguments: Stream) {
+        let execution_id = self
+            .execution_service
+            .queue_function(tonic::Request::new(ExecutionParameters {
+                name: self.name.clone(),
+                version_requirement: self.version.clone(),
+                arguments: Some(arguments),
+            }))
+            .await
+            .unwrap()
+            .into_inner();
+
+        self.execution_service
+            .run_function(tonic::Request::new(execution_id))
+            .await
+            .unwrap();
+    }
+}
+
+fn compile() {
+    bench(
+        "compile/fast",
+        iterations(),
+        None,
+        || code_dir(HELLO_WASM),
+        |dir| {
+            compiler::compile(Compiler::Fast, &dir.path().join("code"), &null_logger!()).unwrap();
+            dir
+        },
+    );
+
+    // includes writing the compiled module to the cache
+    bench(
+        "compile/optimized",
+        iterations(),
+        None,
+        || code_dir(HELLO_WASM),
+        |dir| {
+            compiler::compile(
+                Compiler::Optimized,
+                &dir.path().join("code"),
+                &null_logger!(),
+            )
+            .unwrap();
+            dir
+        },
+    );
+
+    let cached = code_dir(HELLO_WASM);
+    let code_path = cached.path().join("code");
+    compiler::compile(Compiler::Optimized, &code_path, &null_logger!()).unwrap();
+    bench(
+        "compile/cached",
+        iterations(),
+        None,
+        || (),
+        |_| compiler::compile(Compiler::Optimized, &code_path, &null_logger!()).unwrap(),
+    );
+}
+
+fn instantiate() {
+    let module = compile_code(Compiler::Fast, HELLO_WASM);
+
+    bench(
+        "instantiate",
+        iterations(),
+        None,
+        || (),
+        |_| {
+            let mut wasi_env = WasiState::new("hello").finalize().unwrap();
+            Instance::new(&module, &wasi_env.import_object(&module).unwrap()).unwrap()
+        },
+    );
+}
+
+fn attachment_map() {
+    let source_dir = tempfile::TempDir::new().unwrap();
+    let source_path = source_dir.path().join("attachment");
+    std::fs::write(&source_path, vec![0xfeu8; ATTACHMENT_SIZE]).unwrap();
+    let attachment = file_attachment(&source_path);
+    let auth = AuthService::default();
+    let async_runtime = tokio::runtime::Runtime::new().unwrap();
+    let throughput = Some(Throughput::Bytes(ATTACHMENT_SIZE as u64));
+
+    bench(
+        "attachment_map/cold",
+        iterations(),
+        throughput,
+        || tempfile::TempDir::new().unwrap(),
+        |target_dir| {
+            async_runtime
+                .block_on(attachment.download_cached(target_dir.path(), &auth))
+                .unwrap();
+            target_dir
+        },
+    );
+
+    let cache_dir = tempfile::TempDir::new().unwrap();
+    bench(
+        "attachment_map/cached",
+        iterations(),
+        throughput,
+        || (),
+        |_| {
+            async_runtime
+                .block_on(attachment.download_cached(cache_dir.path(), &auth))
+                .unwrap()
+        },
+    );
+}
+
+fn validation() {
+    let arguments = large_input();
+    let specs = large_channel_specs();
+
+    bench(
+        "validation/large_input",
+        iterations(),
+        Some(Throughput::Elements(LARGE_INPUT_LEN as u64)),
+        || (),
+        |_| arguments.validate(&specs, None).unwrap(),
+    );
+}
+
+fn execution() {
+    let root_dir = tempfile::TempDir::new().unwrap();
+    let runtime = WasiRuntime::new(null_logger!());
+    let mut execution = 0usize;
+    let mut parameters = || {
+        execution += 1;
+        RuntimeParameters::new(
+            "bench",
+            FunctionDirectory::new(
+                root_dir.path(),
+                "bench",
+                "1.0.0",
+                "bench",
+                &execution.to_string(),
+            )
+            .unwrap(),
+        )
+        .unwrap()
+    };
+
+    let hello = compile_code(Compiler::Optimized, HELLO_WASM);
+    bench(
+        "execution/hello",
+        iterations(),
+        None,
+        &mut parameters,
+        |parameters| {
+            runtime
+                .execute_module(&hello, parameters, Stream::new(), vec![])
+                .unwrap()
+                .unwrap()
+        },
+    );
+
+    let channels = compile_code(Compiler::Optimized, CHANNELS_WAT.as_bytes());
+    let arguments = large_input();
+    bench(
+        "execution/large_channels",
+        iterations(),
+        Some(Throughput::Elements(LARGE_INPUT_LEN as u64)),
+        || (parameters(), arguments.clone()),
+        |(parameters, arguments)| {
+            let results = runtime
+                .execute_module(&channels, parameters, arguments, vec![])
+                .unwrap()
+                .unwrap();
+            assert!(results.has_channel("numbers"));
+            results
+        },
+    );
+}
+
+fn end_to_end() {
+    let async_runtime = tokio::runtime::Runtime::new().unwrap();
+    let wasi_runtime = || RuntimeSpec {
+        name: "wasi".to_owned(),
+        entrypoint: String::new(),
+        arguments: HashMap::new(),
+    };
+    let hello = BenchFunction::new(
+        wasi_runtime(),
+        HELLO_WASM.to_vec(),
+        HashMap::new(),
+        Box::new(InternalRuntimeSource::new(null_logger!())),
+    );
+
+    bench(
+        "end_to_end/hello",
+        iterations(),
+        None,
+        || (),
+        |_| async_runtime.block_on(hello.execute(stream!())),
+    );
+
+    let channels = BenchFunction::new(
+        wasi_runtime(),
+        CHANNELS_WAT.as_bytes().to_vec(),
+        large_channel_specs(),
+        Box::new(InternalRuntimeSource::new(null_logger!())),
+    );
+    let arguments = large_input();
+    bench(
+        "end_to_end/large_channels",
+        iterations(),
+        Some(Throughput::Elements(LARGE_INPUT_LEN as u64)),
+        || arguments.clone(),
+        |arguments| async_runtime.block_on(channels.execute(arguments)),
+    );
+}
+
+fn python() {
+    let (runtimes_dir, hello_code) = match (
+        std::env::var_os("AVERY_BENCH_RUNTIMES_DIR"),
+        std::env::var_os("AVERY_BENCH_PYTHON_HELLO"),
+    ) {
+        (Some(runtimes_dir), Some(hello_code)) => {
+            (PathBuf::from(runtimes_dir), PathBuf::from(hello_code))
+        }
+        _ => {
+            eprintln!(
+                "Skipping Python benchmarks, set AVERY_BENCH_RUNTIMES_DIR \
+                 and AVERY_BENCH_PYTHON_HELLO to run them"
+            );
+            return;
+        }
+    };
+
+    let async_runtime = tokio::runtime::Runtime::new().unwrap();
+    let hello = BenchFunction::new(
+        RuntimeSpec {
+            name: "python".to_owned(),
+            entrypoint: "hello:main".to_owned(),
+            arguments: HashMap::new(),
+        },
+        std::fs::read(&hello_code).unwrap(),
+        HashMap::new(),
+        Box::new(
+            FileSystemSource::new(&runtimes_dir, &CompilerConfig::default(), null_logger!())
+                .unwrap(),
+        ),
+    );
+
+    // Python executions are slow, do not spend forever on them
+    bench(
+        "python/hello",
+        iterations().min(10),
+        None,
+        || (),
+        |_| async_runtime.block_on(hello.execute(stream!())),
+    );
+}
+
+fn main() {
+    compile();
+    instantiate();
+    attachment_map();
+    validation();
+    execution();
+    end_to_end();
+    python();
+}
@@ -2,14 +2,16 @@ use std::collections::HashMap;
 
 use firm_types::functions;
 use pyo3::{
+    buffer::PyBuffer,
+    class::iter::PyIterProtocol,
     create_exception,
-    exceptions::PyException,
+    exceptions::{PyException, PyTypeError},
     ffi,
     prelude::FromPyObject,
-    proc_macro::{pyfunction, pymodule},
+    proc_macro::{pyclass, pyfunction, pymodule, pyproto},
     types::PyBytes,
-    types::{PyIterator, PyModule},
-    wrap_pyfunction, IntoPy, PyAny, PyResult, Python, ToPyObject,
+    types::{PyByteArray, PyModule, PySequence},
+    wrap_pyfunction, IntoPy, PyAny, PyObject, PyRef, PyRefMut, PyResult, Python, ToPyObject,
 };
 
 create_exception!(firm, GetInputError, PyException);
@@ -20,29 +22,136 @@ create_exception!(firm, HostProcessError, PyException);
 create_exception!(firm, MapAttachmentError, PyException);
 create_exception!(firm, SetErrorError, PyException);
 
+/// Number of values fetched from the host at a time when iterating an input
+const INPUT_STREAM_BATCH_SIZE: usize = 1024;
+
+fn channel_to_objects(py: Python<'_>, value: functions::channel::Value) -> Vec<PyObject> {
+    match value {
+        functions::channel::Value::Strings(x) => {
+            x.values.into_iter().map(|v| v.into_py(py)).collect()
+        }
+        functions::channel::Value::Integers(x) => {
+            x.values.into_iter().map(|v| v.into_py(py)).collect()
+        }
+        functions::channel::Value::Floats(x) => {
+            x.values.into_iter().map(|v| v.into_py(py)).collect()
+        }
+        functions::channel::Value::Booleans(x) => {
+            x.values.into_iter().map(|v| v.into_py(py)).collect()
+        }
+        functions::channel::Value::Bytes(x) => {
+            x.values.into_iter().map(|v| v.into_py(py)).collect()
+        }
+    }
+}
+
+/// Get the batch of values starting at `offset` from the input designated by `key`
+///
+/// Returns `None` if the input has no value at all.
+fn get_input_batch(py: Python<'_>, key: &str, offset: usize) -> PyResult<Option<Vec<PyObject>>> {
+    firm::get_channel_batch(key, offset, INPUT_STREAM_BATCH_SIZE)
+        .map_err(|e| GetInputError::new_err(e.to_string().into_py(py)))
+        .map(|channel| channel.value.map(|value| channel_to_objects(py, value)))
+}
+
+/// Iterator over the values of an input
+///
+/// Values are fetched from the host in batches as the
+/// iterator advances, so large inputs never have to be
+/// copied into the runtime all at once.
+#[pyclass]
+struct InputStream {
+    key: String,
+    offset: usize,
+    batch: std::vec::IntoIter<PyObject>,
+    exhausted: bool,
+}
+
+impl InputStream {
+    fn new(key: String, first_batch: Vec<PyObject>) -> Self {
+        Self {
+            key,
+            offset: first_batch.len(),
+            exhausted: first_batch.len() < INPUT_STREAM_BATCH_SIZE,
+            batch: first_batch.into_iter(),
+        }
+    }
+}
+
+#[pyproto]
+impl PyIterProtocol for InputStream {
+    fn __iter__(slf: PyRef<Self>) -> PyRef<Self> {
+        slf
+    }
+
+    fn __next__(mut slf: PyRefMut<Self>) -> PyResult<Option<PyObject>> {
+        if let Some(value) = slf.batch.next() {
+            return Ok(Some(value));
+        }
+
+        // a short batch means that we have reached the end
+        if slf.exhausted {
+            return Ok(None);
+        }
+
+        let batch = get_input_batch(slf.py(), &slf.key, slf.offset)?.unwrap_or_default();
+        slf.offset += batch.len();
+        slf.exhausted = batch.len() < INPUT_STREAM_BATCH_SIZE;
+        slf.batch = batch.into_iter();
+        Ok(slf.batch.next())
+    }
+}
+
 /// Get an input designated by `key` as a "stream"
+///
+/// The returned iterator fetches the values lazily.
 #[pyfunction]
-fn get_input_stream(py: Python<'_>, key: String) -> PyResult<Option<&'_ PyIterator>> {
-    firm::get_channel(key)
-        .map_err(|e| GetInputError::new_err(e.to_string().into_py(py)))
-        .and_then(|channel| {
-            channel
-                .value
-                .map(|value| {
-                    PyIterator::from_object(
-                        py,
-                        &match value {
-                            functions::channel::Value::Strings(x) => x.values.to_object(py),
-                            functions::channel::Value::Integers(x) => x.values.to_object(py),
-                            functions::channel::Value::Floats(x) => x.values.to_object(py),
-                            functions::channel::Value::Booleans(x) => x.values.to_object(py),
-                            functions::channel::Value::Bytes(x) => x.values.to_object(py),
-                        }
-                        .to_object(py),
-                    )
-                })
-                .transpose()
-        })
+fn get_input_stream(py: Python<'_>, key: String) -> PyResult<Option<InputStream>> {
+    get_input_batch(py, &key, 0).map(|batch| batch.map(|batch| InputStream::new(key, batch)))
+}
+
+/// Get an input designated by `key` as a `memoryview`
+///
+/// Integers, floats, booleans and bytes are written
+/// by the host straight into the memory of a bytearray
+/// instead of being converted to Python objects one by
+/// one, the memoryview is cast to the matching format
+/// ("q", "d", "?" or "B"). String inputs can not be
+/// accessed as a buffer.
+#[pyfunction]
+fn get_input_buffer(py: Python<'_>, key: String) -> PyResult<Option<&'_ PyAny>> {
+    let (len, channel_type) = firm::get_channel_buffer_len(&key)
+        .map_err(|e| GetInputError::new_err(e.to_string().into_py(py)))?;
+
+    let format = match channel_type {
+        Some(functions::ChannelType::Int) => "q",
+        Some(functions::ChannelType::Float) => "d",
+        Some(functions::ChannelType::Bool) => "?",
+        Some(functions::ChannelType::Bytes) => "B",
+        Some(functions::ChannelType::String) => {
+            return Err(GetInputError::new_err(
+                "String inputs can not be accessed as a buffer",
+            ))
+        }
+        None => return Ok(None),
+    };
+
+    // Safety: a bytearray created from a null pointer is
+    // uninitialized and is filled in by the host below
+    let buffer: &PyByteArray = unsafe {
+        py.from_owned_ptr_or_err(ffi::PyByteArray_FromStringAndSize(
+            std::ptr::null(),
+            len as ffi::Py_ssize_t,
+        ))?
+    };
+    firm::read_channel_buffer(&key, unsafe { buffer.as_bytes_mut() })
+        .map_err(|e| GetInputError::new_err(e.to_string().into_py(py)))?;
+
+    py.import("builtins")?
+        .getattr("memoryview")?
+        .call1((buffer,))?
+        .call_method1("cast", (format,))
+        .map(Some)
 }
 
 /// Get a single input designated by `key`
@@ -75,6 +184,53 @@ fn get_input(py: Python<'_>, key: String) -> PyResult<Option<&'_ PyAny>> {
         })
 }
 
+/// Output values from an object supporting the buffer protocol
+///
+/// Buffers (bytearray, memoryview, numpy arrays etc.) are copied
+/// in one go instead of converting each value to a Rust type. They
+/// get the same channel type as when each value is converted.
+enum BufferValues {
+    Bytes(Vec<u8>),
+    Booleans(Vec<bool>),
+    Integers(Vec<i64>),
+    Floats(Vec<f64>),
+}
+
+impl<'a> FromPyObject<'a> for BufferValues {
+    fn extract(obj: &'a PyAny) -> PyResult<Self> {
+        let py = obj.py();
+
+        // the buffer format decides which type the buffer can be read
+        // as, booleans are read as bytes since they are one byte each
+        let view = py
+            .import("builtins")?
+            .getattr("memoryview")?
+            .call1((obj,))?;
+        if view.getattr("format")?.extract::<&str>()? == "?" {
+            PyBuffer::<u8>::get(view.call_method1("cast", ("B",))?)?
+                .to_vec(py)
+                .map(|bytes| Self::Booleans(bytes.into_iter().map(|b| b != 0).collect()))
+        } else if let Ok(buffer) = PyBuffer::<i64>::get(obj) {
+            buffer.to_vec(py).map(Self::Integers)
+        } else if let Ok(buffer) = PyBuffer::<f64>::get(obj) {
+            buffer.to_vec(py).map(Self::Floats)
+        } else if let Ok(buffer) = PyBuffer::<u8>::get(obj) {
+            // bytearray and memoryview are sequences of ints and have always
+            // been output as ints, only buffers that are not sequences are bytes
+            let bytes = buffer.to_vec(py)?;
+            Ok(if obj.downcast::<PySequence>().is_ok() {
+                Self::Integers(bytes.into_iter().map(i64::from).collect())
+            } else {
+                Self::Bytes(bytes)
+            })
+        } else {
+            Err(PyTypeError::new_err(
+                "Expected a buffer of bytes, bools, 64 bit integers or 64 bit floats",
+            ))
+        }
+    }
+}
+
 /// Representation of an output value
 #[derive(FromPyObject)]
 enum OutputValues<'a> {
@@ -82,6 +238,8 @@ enum OutputValues<'a> {
     // since it overlaps with int
     #[pyo3(transparent, annotation = "bytes")]
     Bytes(&'a PyBytes),
+    #[pyo3(transparent, annotation = "Buffer")]
+    Buffer(BufferValues),
     #[pyo3(transparent, annotation = "Sequence[str]")]
     Strings(Vec<String>),
 
@@ -97,12 +255,20 @@ enum OutputValues<'a> {
 
 /// Set an output designated by `key` to `value`
 ///
-/// `value` has to be a sequence of str, int, float, bool, or bytes
+/// `value` has to be a sequence of str, int, float, bool, or bytes.
+/// Objects supporting the buffer protocol with a matching format
+/// (like bytearray, memoryview or numpy arrays of int64, float64 or
+/// bool) are copied without converting each value. Sequences of
+/// unsigned bytes, like bytearray, are still output as ints.
 #[pyfunction]
 fn set_output(key: String, values: OutputValues) -> PyResult<()> {
     // check the value of the first item
     match values {
         OutputValues::Bytes(bytes) => firm::set_output(key, bytes.as_bytes().to_vec()),
+        OutputValues::Buffer(BufferValues::Bytes(bytes)) => firm::set_output(key, bytes),
+        OutputValues::Buffer(BufferValues::Booleans(booleans)) => firm::set_output(key, booleans),
+        OutputValues::Buffer(BufferValues::Integers(integers)) => firm::set_output(key, integers),
+        OutputValues::Buffer(BufferValues::Floats(floats)) => firm::set_output(key, floats),
         OutputValues::Strings(strings) => firm::set_output(key, strings),
         OutputValues::Integers(integers) => firm::set_output(key, integers),
         OutputValues::Floats(floats) => firm::set_output(key, floats),
@@ -182,6 +348,8 @@ fn set_error(message: String) -> PyResult<()> {
 fn firm(_py: Python, m: &PyModule) -> PyResult<()> {
     m.add_function(wrap_pyfunction!(get_input, m)?)?;
     m.add_function(wrap_pyfunction!(get_input_stream, m)?)?;
+    m.add_function(wrap_pyfunction!(get_input_buffer, m)?)?;
+    m.add_class::<InputStream>()?;
 
     m.add_function(wrap_pyfunction!(set_output, m)?)?;
     m.add_function(wrap_pyfunction!(set_error, m)?)?;
@@ -1,11 +1,21 @@
-use std::{env, fmt::Display, fs::File};
+use std::{
+    collections::hash_map::RandomState,
+    env,
+    fmt::Display,
+    fs::File,
+    hash::{BuildHasher, Hasher},
+    io::{ErrorKind, Write},
+    path::{Path, PathBuf},
+    sync::atomic::{AtomicBool, AtomicPtr, Ordering},
+};
 
 use ::firm::{
     runtime_context::{RuntimeContext, RuntimeContextExt},
     AttachmentDownload,
 };
 
-use pyo3::{ffi, PyResult, Python};
+use firm_types::functions::Attachment;
+use pyo3::{ffi, types::PyList, IntoPyPointer, PyObject, PyResult, Python};
 use zip::ZipArchive;
 
 // pub use to not have symbols stripped
@@ -14,6 +24,22 @@ pub use wasi_python_shims::*;
 mod firm;
 mod socket;
 
+/// Name of the attachment containing the wheels the function depends on
+const DEPENDENCIES_ATTACHMENT: &str = "dependencies";
+
+const DEPENDENCIES_CACHE_PATH: &str = "/cache/python-dependencies";
+
+/// Function code is copied here so that the bytecode CPython writes
+/// next to it (`__pycache__`) survives between executions
+const CODE_CACHE_PATH: &str = "/cache/python-code";
+
+/// Runtime argument that functions set to `true` to be kept warm
+const WARM_ARGUMENT: &str = "warm";
+
+static INITIALIZED: AtomicBool = AtomicBool::new(false);
+static MAIN_THREAD_STATE: AtomicPtr<ffi::PyThreadState> = AtomicPtr::new(std::ptr::null_mut());
+static WARM_ENTRYPOINT: AtomicPtr<ffi::PyObject> = AtomicPtr::new(std::ptr::null_mut());
+
 struct Entrypoint {
     module: String,
     function: String,
@@ -29,9 +55,243 @@ impl Display for Entrypoint {
     }
 }
 
-fn run() -> Result<(), Box<dyn std::error::Error>> {
-    let runtime_context = RuntimeContext::from_default()?;
+fn initialize_python() -> Result<(), Box<dyn std::error::Error>> {
+    env::set_var("PYTHONHOME", "/runtime-fs:{}");
+
+    // function code and dependencies are added to sys.path
+    // for each execution since they are not known here
+    env::set_var("PYTHONPATH", "/runtime-fs/lib");
+
+    unsafe {
+        // Add our module(s), this needs to be called before initalize
+        // for it to be considered an "internal" module
+        ffi::PyImport_AppendInittab("firm\0".as_ptr() as *const i8, Some(firm::init));
+        ffi::PyImport_AppendInittab("wasi_socket\0".as_ptr() as *const i8, Some(socket::init));
+
+        ffi::Py_InitializeEx(0);
+        if ffi::Py_IsInitialized() == 0 {
+            return Err(Box::<dyn std::error::Error>::from(
+                "🐍 Python failed to initialize!",
+            ));
+        };
+
+        // Release the GIL so we can use with_gil and friends
+        MAIN_THREAD_STATE.store(ffi::PyEval_SaveThread(), Ordering::SeqCst);
+    }
+
+    INITIALIZED.store(true, Ordering::SeqCst);
+    Ok(())
+}
+
+extern "C" {
+    fn __wasm_call_ctors();
+}
+
+/// Initialize the Python interpreter ahead of any function execution
+///
+/// The host calls this once and snapshots the resulting state, later
+/// executions are started from the snapshot with Python already
+/// initialized and enter through `firm.main` instead of `_start`.
+/// Hosts without snapshot support never call this and the interpreter
+/// gets initialized in `run` instead.
+///
+/// A failed initialization traps so that the host does not snapshot it.
+///
+/// The hash seed is picked when the interpreter is initialized, so hash
+/// randomization is fixed per snapshot and shared by all executions started
+/// from it. The `random` module is reseeded for each execution in `run`.
+#[export_name = "wizer.initialize"]
+pub extern "C" fn initialize() {
+    // _start is not called before this so the constructors (setting up
+    // preopened directories among other things) have to be run here
+    unsafe { __wasm_call_ctors() };
+
+    if let Err(e) = initialize_python() {
+        eprintln!("Failed to initialize Python: {}", e);
+        std::process::abort();
+    }
+}
+
+/// Entrypoint for instances initialized with `wizer.initialize`
+///
+/// Same as `_start` except that the constructors are not run again.
+#[export_name = "firm.main"]
+pub extern "C" fn initialized_main() {
+    main();
+    let _ = std::io::stdout().flush();
+}
+
+/// Create a directory next to `target` that no other extraction uses
+fn create_partial_dir(target: &Path) -> Result<PathBuf, String> {
+    loop {
+        // RandomState is seeded from the WASI random source once per thread, so
+        // executions started from the same snapshot try the same names. Only one
+        // of them gets to create each directory and the others try the next name
+        let partial = PathBuf::from(format!(
+            "{}.{:016x}.partial",
+            target.display(),
+            RandomState::new().build_hasher().finish()
+        ));
+        match std::fs::create_dir(&partial) {
+            Ok(_) => return Ok(partial),
+            Err(e) if e.kind() == ErrorKind::AlreadyExists => continue,
+            Err(e) => return Err(format!("Failed to create \"{}\": {}", partial.display(), e)),
+        }
+    }
+}
+
+/// Fill the cache folder `target` by calling `fill` with a temporary folder
+///
+/// The temporary folder is moved in place when `fill` is done so that
+/// half-written folders are never used.
+fn fill_cache_dir<F>(target: &Path, fill: F) -> Result<(), String>
+where
+    F: FnOnce(&Path) -> Result<(), String>,
+{
+    let partial = create_partial_dir(target)?;
+    fill(&partial)
+        .and_then(|_| {
+            std::fs::rename(&partial, target).or_else(|e| {
+                // someone else might have filled the same folder at the same time
+                if target.exists() {
+                    std::fs::remove_dir_all(&partial).map_err(|e| e.to_string())
+                } else {
+                    Err(e.to_string())
+                }
+            })
+        })
+        .map_err(|e| {
+            let _ = std::fs::remove_dir_all(&partial);
+            e
+        })
+}
+
+/// Get the sha256 checksum of `attachment` to use as a cache key
+fn cache_key(attachment: &Attachment) -> Result<&str, String> {
+    attachment
+        .checksums
+        .as_ref()
+        .map(|checksums| checksums.sha256.as_str())
+        .filter(|sha256| !sha256.is_empty())
+        .ok_or_else(|| {
+            format!(
+                "The {} attachment does not have a sha256 checksum",
+                attachment.name
+            )
+        })
+}
+
+/// Map the dependencies attachment and extract all wheels in it to `target`
+fn extract_dependencies(target: &Path) -> Result<(), String> {
+    let wheels = ::firm::map_attachment_and_unpack(DEPENDENCIES_ATTACHMENT)
+        .map_err(|e| e.to_string())?
+        .join("dependencies");
+
+    fill_cache_dir(target, |partial| {
+        wheels
+            .read_dir()
+            .map_err(|e| e.to_string())
+            .and_then(|mut wheels| {
+                wheels.try_for_each(|wheel| {
+                    let wheel = wheel.map_err(|e| e.to_string())?.path();
+                    let file_name = wheel.file_name().unwrap_or_default();
+                    print!("Installing dependency {}...", file_name.to_string_lossy());
+                    File::open(&wheel)
+                        .map_err(|e| e.to_string())
+                        .and_then(|wheel| ZipArchive::new(wheel).map_err(|e| e.to_string()))
+                        .and_then(|mut zip| {
+                            zip.extract(partial.join(file_name))
+                                .map_err(|e| e.to_string())
+                        })
+                        .map(|_| println!("done!"))
+                })
+            })
+    })
+}
+
+/// Get the extracted wheels of the function in `runtime_context` from the persistent cache
+///
+/// Extracted wheels are keyed by the checksum of the dependencies attachment,
+/// so the attachment is only mapped and extracted the first time it is seen.
+/// Returns the paths to the extracted wheels.
+fn cached_dependencies(runtime_context: &RuntimeContext) -> Result<Vec<PathBuf>, String> {
+    let dependencies = match runtime_context
+        .attachments
+        .iter()
+        .find(|attachment| attachment.name == DEPENDENCIES_ATTACHMENT)
+    {
+        Some(dependencies) => dependencies,
+        None => return Ok(vec![]),
+    };
+
+    let target = Path::new(DEPENDENCIES_CACHE_PATH).join(cache_key(dependencies)?);
+    if !target.exists() {
+        extract_dependencies(&target)?;
+    }
+
+    let mut wheels = target
+        .read_dir()
+        .and_then(|wheels| {
+            wheels
+                .map(|wheel| wheel.map(|w| w.path()))
+                .collect::<Result<Vec<_>, _>>()
+        })
+        .map_err(|e| e.to_string())?;
+    wheels.sort();
+    Ok(wheels)
+}
+
+fn copy_dir(source: &Path, target: &Path) -> std::io::Result<()> {
+    std::fs::create_dir_all(target)?;
+    source.read_dir()?.try_for_each(|entry| {
+        let entry = entry?;
+        let target = target.join(entry.file_name());
+        if entry.file_type()?.is_dir() {
+            copy_dir(&entry.path(), &target)
+        } else {
+            std::fs::copy(entry.path(), target).map(|_| ())
+        }
+    })
+}
 
+/// Get the unpacked code of the function in `runtime_context` from the persistent cache
+///
+/// Like the dependencies, the code is keyed by the checksum of its attachment
+/// and only unpacked the first time it is seen. Keeping the code in the cache
+/// means that it only needs to be compiled to bytecode once. The standard
+/// library uses the bytecode compiled when the runtime was installed.
+fn cached_code(runtime_context: &RuntimeContext) -> Result<PathBuf, String> {
+    let code = runtime_context
+        .code
+        .as_ref()
+        .ok_or("code is required for python")?;
+
+    let target = Path::new(CODE_CACHE_PATH).join(cache_key(code)?);
+    if !target.exists() {
+        let unpacked = code.download_unpacked().map_err(|e| e.to_string())?;
+        fill_cache_dir(&target, |partial| {
+            copy_dir(&unpacked, partial).map_err(|e| e.to_string())
+        })?;
+    }
+
+    Ok(target)
+}
+
+/// Function code and dependencies, downloaded and unpacked
+struct PreparedFunction {
+    entrypoint: Entrypoint,
+    code_path: PathBuf,
+    dependency_paths: Vec<PathBuf>,
+}
+
+/// Download and unpack the code and dependencies of the function in `runtime_context`
+///
+/// Everything is cached so this is cheap for all but the first execution,
+/// but it still needs to happen for every execution since the function
+/// might read (or lazily import) files from the code or dependencies.
+fn prepare_function(
+    runtime_context: &RuntimeContext,
+) -> Result<PreparedFunction, Box<dyn std::error::Error>> {
     let mut parts = runtime_context.entrypoint.splitn(2, ':');
 
     let entrypoint = Entrypoint {
@@ -39,12 +299,8 @@ fn run() -> Result<(), Box<dyn std::error::Error>> {
         function: parts.next().unwrap_or("main").to_owned(),
     };
 
-    let code = runtime_context
-        .code
-        .ok_or("code is required for python")?
-        .download_unpacked()?;
-
-    env::set_var("PYTHONHOME", "/runtime-fs:{}");
+    std::fs::create_dir_all(CODE_CACHE_PATH)?;
+    let code = cached_code(runtime_context)?;
 
     // python sdists always contain a single top-level
     // folder so add this to sys.path so we can
@@ -54,81 +310,121 @@ fn run() -> Result<(), Box<dyn std::error::Error>> {
         .ok_or("no folder in unpacked python sdist")?
         .map(|de| de.path())?;
 
-    // unpack all dependencies
-    let dependency_wheels = ::firm::map_attachment_and_unpack("dependencies")
-        .map(Some)
-        .or_else(|e| {
-            if let ::firm::Error::FailedToFindAttachment(_) = e {
-                Ok(None)
-            } else {
-                Err(e)
-            }
-        })?;
-    const DEPENDENCIES_PATH: &str = "/sandbox/dependencies";
-    std::fs::create_dir_all(DEPENDENCIES_PATH)?;
-    dependency_wheels
-        .map(|path| {
-            path.join("dependencies")
-                .read_dir()
-                .map_err(|e| e.to_string())?
-                .try_for_each(|de| {
-                    de.map_err(|e| e.to_string()).and_then(|whl| {
-                        File::open(whl.path())
-                            .map_err(|e| e.to_string())
-                            .and_then(|f| {
-                                ZipArchive::new(f)
-                                    .map_err(|e| e.to_string())
-                                    .and_then(|mut zip| {
-                                        print!("Installing dependency {}...", whl.path().display());
-                                        let r = zip
-                                            .extract(DEPENDENCIES_PATH)
-                                            .map_err(|e| e.to_string());
-                                        println!("done!");
-                                        r
-                                    })
-                            })
-                    })
-                })
-        })
-        .transpose()?;
-
-    env::set_var(
-        "PYTHONPATH",
-        // need to prepend a slash to the given path here
-        // to make it absolute for python to be happy
-        // if later this is done for us (download() returns
-        // an absolute path), remove this slash
-        format!(
-            "/runtime-fs/lib:/{}:{}",
-            first_dir.display(),
-            DEPENDENCIES_PATH
-        ),
-    );
+    std::fs::create_dir_all(DEPENDENCIES_CACHE_PATH)?;
+    let dependency_paths = cached_dependencies(runtime_context)?;
 
-    unsafe {
-        // Add our module(s), this needs to be called before initalize
-        // for it to be considered an "internal" module
-        ffi::PyImport_AppendInittab("firm\0".as_ptr() as *const i8, Some(firm::init));
-        ffi::PyImport_AppendInittab("wasi_socket\0".as_ptr() as *const i8, Some(socket::init));
+    Ok(PreparedFunction {
+        entrypoint,
+        code_path: first_dir,
+        dependency_paths,
+    })
+}
 
-        ffi::Py_InitializeEx(0);
-        if ffi::Py_IsInitialized() == 0 {
-            return Err(Box::<dyn std::error::Error>::from(
-                "🐍 Python failed to initialize!",
-            ));
-        };
+/// Add the code and dependencies of `function` to sys.path
+/// and import the entrypoint function
+fn import_entrypoint(py: Python, function: &PreparedFunction) -> PyResult<PyObject> {
+    // need to prepend a slash to the given path here
+    // to make it absolute for python to be happy
+    // if later this is done for us (download() returns
+    // an absolute path), remove this slash
+    let sys_path = py.import("sys")?.getattr("path")?.downcast::<PyList>()?;
+    sys_path.insert(1, format!("/{}", function.code_path.display()))?;
+    function
+        .dependency_paths
+        .iter()
+        .enumerate()
+        .try_for_each(|(i, path)| sys_path.insert(2 + i, path.display().to_string()))?;
+
+    socket::load_py_module(py)?;
+    let main_module = py.import(&function.entrypoint.module)?;
+    Ok(main_module.getattr(&function.entrypoint.function)?.into())
+}
+
+fn warm_function() -> Result<bool, Box<dyn std::error::Error>> {
+    let runtime_context = RuntimeContext::from_default()?;
+    if runtime_context
+        .arguments
+        .get(WARM_ARGUMENT)
+        .map(String::as_str)
+        != Some("true")
+    {
+        return Ok(false);
+    }
+
+    let function = prepare_function(&runtime_context)?;
+    if !INITIALIZED.load(Ordering::SeqCst) {
+        initialize_python()?;
+    }
+
+    let entrypoint = Python::with_gil(|py| import_entrypoint(py, &function))?;
+    WARM_ENTRYPOINT.store(entrypoint.into_ptr(), Ordering::SeqCst);
+    Ok(true)
+}
+
+/// Import the function to run ahead of its execution
+///
+/// The host calls this after `initialize` and snapshots the resulting
+/// state per function so that later executions of the same function skip
+/// importing it. Since anything a module does at import time is then only
+/// done once, functions have to opt in to this by setting the runtime
+/// argument `warm` to `true`. Returns 0 if the function was imported.
+///
+/// Like for `initialize` the hash seed is fixed per snapshot. `random` is
+/// reseeded for each execution but `random.Random` instances created at
+/// import time keep the state they have in the snapshot.
+#[export_name = "firm.warm"]
+pub extern "C" fn warm() -> u32 {
+    match warm_function() {
+        Ok(true) => 0,
+        Ok(false) => 1,
+        Err(e) => {
+            eprintln!("Failed to warm function: {}", e);
+            2
+        }
     }
+}
+
+/// Reseed the `random` module if it was imported before the snapshot was taken
+///
+/// Executions started from a snapshot would otherwise
+/// all get the same sequence of random numbers.
+fn reseed_random(py: Python) -> PyResult<()> {
+    match py.import("sys")?.getattr("modules")?.get_item("random") {
+        // seeding without a value uses os.urandom
+        Ok(random) => random.call_method0("seed").map(|_| ()),
+        Err(_) => Ok(()),
+    }
+}
+
+fn run() -> Result<(), Box<dyn std::error::Error>> {
+    let runtime_context = RuntimeContext::from_default()?;
+    let function = prepare_function(&runtime_context)?;
 
-    println!("Starting python code with entrypoint: {}", entrypoint);
+    // an interpreter that is already initialized was restored from a snapshot
+    let from_snapshot = INITIALIZED.load(Ordering::SeqCst);
+    if !from_snapshot {
+        initialize_python()?;
+    }
 
-    // Release the GIL so we can use with_gil and friends
-    let ts = unsafe { ffi::PyEval_SaveThread() };
+    println!(
+        "Starting python code with entrypoint: {}",
+        function.entrypoint
+    );
 
+    let warm_entrypoint = WARM_ENTRYPOINT.load(Ordering::SeqCst);
     let res = Python::with_gil(|py| -> PyResult<()> {
-        socket::load_py_module(py)?;
-        let main_module = py.import(&entrypoint.module)?;
-        main_module.getattr(&entrypoint.function)?.call0()?;
+        if from_snapshot {
+            reseed_random(py)?;
+        }
+
+        let entrypoint = if warm_entrypoint.is_null() {
+            import_entrypoint(py, &function)?
+        } else {
+            // Safety: the warm entrypoint is kept alive by the reference leaked in `warm`
+            unsafe { PyObject::from_borrowed_ptr(py, warm_entrypoint) }
+        };
 
+        entrypoint.call0(py)?;
         Ok(())
     });
 
@@ -142,7 +438,7 @@ fn run() -> Result<(), Box<dyn std::error::Error>> {
     }
 
     unsafe {
-        ffi::PyEval_RestoreThread(ts);
+        ffi::PyEval_RestoreThread(MAIN_THREAD_STATE.load(Ordering::SeqCst));
         ffi::Py_Finalize();
     }
 
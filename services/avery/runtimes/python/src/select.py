@@ -1,5 +1,33 @@
+import wasi_socket
+
+
 def __getattr__(key):
     raise AttributeError(
         f'"{key}" is not implemented for the WASI select module. '
         "It needs to be implemented in the Python WASI runtime."
     )
+
+
+error = OSError
+
+
+def select(rlist, wlist, xlist, timeout=None):
+    """Wait until sockets in `rlist` are readable or sockets in `wlist` are writable
+
+    Sockets are polled on the host. Exceptional conditions are not
+    supported so `xlist` is never part of the result.
+    """
+
+    def fd(fileobj):
+        return fileobj if isinstance(fileobj, int) else fileobj.fileno()
+
+    entries = [
+        (wasi_socket.POLL_SOCKET, fd(f), wasi_socket.POLL_READABLE) for f in rlist
+    ] + [(wasi_socket.POLL_SOCKET, fd(f), wasi_socket.POLL_WRITABLE) for f in wlist]
+    if not entries and timeout is None:
+        raise ValueError("select() with nothing to wait for would block forever")
+
+    revents = wasi_socket.poll(entries, timeout)
+    readable = [f for f, r in zip(rlist, revents) if r]
+    writable = [f for f, r in zip(wlist, revents[len(rlist) :]) if r]
+    return readable, writable, []
@@ -1,3 +1,6 @@
+import io
+import time
+
 import wasi_socket
 
 
@@ -8,23 +11,155 @@ def __getattr__(key):
     )
 
 
+AF_UNSPEC = 0
+AF_INET = 2
+AF_INET6 = 10
+SOCK_STREAM = 1
+IPPROTO_TCP = 6
+TCP_NODELAY = 1
+
+_GLOBAL_DEFAULT_TIMEOUT = object()
+
+
 class socket:
-    def __init__(self, *args, **kwargs):
+    def __init__(self, family=AF_INET, type=SOCK_STREAM, proto=0, fileno=None):
         self.wasi_socket = wasi_socket.new_socket()
         self.closed = False
+        self.family = family
+        self.type = type
+        self.proto = proto
+        self._address = None
+        self._timeout = None
 
     def connect(self, address):
+        # the host connects before returning so there is nothing to poll for
+        # while connecting, connect first and set the timeout after that
+        if self._timeout:
+            raise NotImplementedError(
+                "connect() with a timeout is not supported for WASI sockets, "
+                "use settimeout() after connecting"
+            )
+
+        # connecting always blocks, also for non-blocking sockets
         wasi_socket.connect(self.wasi_socket, address)
+        self._address = address
+
+    def fileno(self):
+        return -1 if self.closed else wasi_socket.fileno(self.wasi_socket)
+
+    def getpeername(self):
+        if self._address is None:
+            raise OSError("socket is not connected")
+        return self._address
+
+    def getsockname(self):
+        raise OSError("getsockname is not supported for WASI sockets")
+
+    def setsockopt(self, *args):
+        # options are handled by the host
+        pass
+
+    def setblocking(self, flag):
+        self._timeout = None if flag else 0.0
+
+    def getblocking(self):
+        return self._timeout != 0.0
+
+    def settimeout(self, value):
+        if value is not None and value < 0:
+            raise ValueError("Timeout value out of range")
+        self._timeout = value
+
+    def gettimeout(self):
+        return self._timeout
+
+    def _wait(self, events, seconds):
+        """Wait for `events` on the host for at most `seconds`
+
+        Raises `BlockingIOError` for non-blocking sockets
+        and `timeout` when the timeout runs out.
+        """
+        if seconds is None:
+            return
+
+        if not wasi_socket.poll(
+            [(wasi_socket.POLL_SOCKET, self.fileno(), events)], max(seconds, 0.0)
+        )[0]:
+            if self._timeout == 0.0:
+                raise BlockingIOError("operation would block")
+            raise timeout("timed out")
 
     def send(self, data, flags=None):
-        wasi_socket.send(self.wasi_socket, data, flags)
+        self._wait(wasi_socket.POLL_WRITABLE, self._timeout)
+        return wasi_socket.send(self.wasi_socket, data, flags)
+
+    def sendall(self, data, flags=None):
+        if self._timeout is None:
+            wasi_socket.sendall(self.wasi_socket, data, flags)
+            return
+
+        # the timeout is for sending all of the data, like for regular sockets
+        deadline = time.monotonic() + self._timeout
+        with memoryview(data) as view, view.cast("B") as view:
+            sent = 0
+            while sent < len(view):
+                self._wait(wasi_socket.POLL_WRITABLE, deadline - time.monotonic())
+                sent += wasi_socket.send(self.wasi_socket, view[sent:], flags)
 
     def recv(self, bufsize, flags=None):
-        wasi_socket.recv(self.wasi_socket, bufsize, flags)
+        self._wait(wasi_socket.POLL_READABLE, self._timeout)
+        return wasi_socket.recv(self.wasi_socket, bufsize, flags)
+
+    def recv_into(self, buffer, nbytes=0, flags=None):
+        self._wait(wasi_socket.POLL_READABLE, self._timeout)
+        return wasi_socket.recv_into(self.wasi_socket, buffer, nbytes, flags)
+
+    def makefile(
+        self, mode="r", buffering=None, *, encoding=None, errors=None, newline=None
+    ):
+        if not set(mode) <= {"r", "w", "b"}:
+            raise ValueError(f"invalid mode {mode!r} (only r, w, b allowed)")
+
+        reading = "r" in mode
+        writing = "w" in mode
+        binary = "b" in mode
+        raw_mode = ("r" if reading else "") + ("w" if writing else "")
+        raw = SocketIO(self, raw_mode)
+
+        if buffering is None:
+            buffering = -1
+        if buffering < 0:
+            buffering = io.DEFAULT_BUFFER_SIZE
+        if buffering == 0:
+            if not binary:
+                raise ValueError("unbuffered streams must be binary")
+            return raw
+
+        if reading and writing:
+            buffer = io.BufferedRWPair(raw, raw, buffering)
+        elif reading:
+            buffer = io.BufferedReader(raw, buffering)
+        else:
+            buffer = io.BufferedWriter(raw, buffering)
+
+        if binary:
+            return buffer
+
+        text = io.TextIOWrapper(buffer, encoding, errors, newline)
+        text.mode = mode
+        return text
 
     def close(self):
+        if not self.closed:
+            wasi_socket.close(self.wasi_socket)
         self.closed = True
 
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
     def __getattr__(cls, key):
         raise AttributeError(
             f'"{key}" is not implemented for WASI sockets. '
@@ -32,9 +167,43 @@ class socket:
         )
 
 
-def create_connection(address, timeout=None, source_address=None):
+class SocketIO(io.RawIOBase):
+    """Raw stream on top of a socket, used by `socket.makefile`
+
+    Reads go straight into the buffer of the wrapping buffered
+    reader through `recv_into` without any intermediate copies.
+    """
+
+    def __init__(self, sock, mode):
+        super().__init__()
+        self._sock = sock
+        self._reading = "r" in mode
+        self._writing = "w" in mode
+
+    def readinto(self, b):
+        self._checkClosed()
+        return self._sock.recv_into(b)
+
+    def write(self, b):
+        self._checkClosed()
+        return self._sock.send(b)
+
+    def readable(self):
+        return self._reading
+
+    def writable(self):
+        return self._writing
+
+    def seekable(self):
+        return False
+
+
+def create_connection(address, timeout=_GLOBAL_DEFAULT_TIMEOUT, source_address=None):
     s = socket()
     s.connect(address)
+    # the timeout is not used while connecting, see socket.connect
+    if timeout is not _GLOBAL_DEFAULT_TIMEOUT:
+        s.settimeout(timeout)
     return s
 
 
@@ -1,22 +1,63 @@
 #![allow(clippy::borrow_deref_ref)] // pyfunction procmacro causes this lint to trigger.
-use std::io::{Read, Write};
+use std::{
+    io::{Read, Write},
+    os::wasi::io::AsRawFd,
+    time::Duration,
+};
+
+use ::firm::net::PollEntry;
 
 use pyo3::{
+    buffer::PyBuffer,
     create_exception,
     exceptions::PyException,
     ffi,
     prelude::{pyclass, pyfunction, pymodule},
-    types::PyModule,
+    types::{PyBytes, PyModule},
     wrap_pyfunction, PyAny, PyResult, Python,
 };
 
 create_exception!(firm, ConnectionError, PyException);
 create_exception!(firm, SocketError, PyException);
 
+/// Size of the per-socket buffer that `recv` reads into
+/// before the received bytes are handed to Python
+const DEFAULT_RECV_BUFFER_SIZE: usize = 64 * 1024;
+
 #[pyclass]
 #[derive(Default)]
 pub struct WasiSocket {
     stream: Option<::firm::net::TcpConnection>,
+
+    /// Reused between calls to `recv` so that reading
+    /// does not allocate once the buffer is large enough
+    recv_buffer: Vec<u8>,
+}
+
+impl WasiSocket {
+    fn stream(&mut self) -> PyResult<&mut ::firm::net::TcpConnection> {
+        self.stream
+            .as_mut()
+            .ok_or_else(|| SocketError::new_err("Call connect() first!".to_owned()))
+    }
+}
+
+/// Call `f` with the bytes in the Python object `data`
+///
+/// Anything supporting the buffer protocol (bytes, bytearray, memoryview
+/// etc.) is accepted and contiguous buffers are used without copying.
+fn with_bytes<T>(py: Python, data: &PyAny, f: impl FnOnce(&[u8]) -> PyResult<T>) -> PyResult<T> {
+    let buffer = PyBuffer::<u8>::get(data)?;
+    if buffer.is_c_contiguous() {
+        // Safety: the buffer is contiguous and kept alive (and
+        // the GIL held) for as long as the slice is used
+        let bytes = unsafe {
+            std::slice::from_raw_parts(buffer.buf_ptr() as *const u8, buffer.len_bytes())
+        };
+        f(bytes)
+    } else {
+        f(&buffer.to_vec(py)?)
+    }
 }
 
 #[pyfunction]
@@ -29,27 +70,138 @@ fn connect(slf: &mut WasiSocket, address: (String, i64)) -> PyResult<()> {
 }
 
 #[pyfunction]
-fn send(slf: &mut WasiSocket, bytes: Vec<u8>, _flags: &PyAny) -> PyResult<usize> {
-    slf.stream
-        .as_mut()
-        .ok_or_else(|| SocketError::new_err("Call connect() first!".to_owned()))
-        .and_then(|s| {
-            s.write(&bytes)
-                .map_err(|e| SocketError::new_err(e.to_string()))
-        })
+fn send(py: Python, slf: &mut WasiSocket, data: &PyAny, _flags: &PyAny) -> PyResult<usize> {
+    let stream = slf.stream()?;
+    with_bytes(py, data, |bytes| {
+        stream
+            .write(bytes)
+            .map_err(|e| SocketError::new_err(e.to_string()))
+    })
+}
+
+#[pyfunction]
+fn sendall(py: Python, slf: &mut WasiSocket, data: &PyAny, _flags: &PyAny) -> PyResult<()> {
+    let stream = slf.stream()?;
+    with_bytes(py, data, |bytes| {
+        stream
+            .write_all(bytes)
+            .map_err(|e| SocketError::new_err(e.to_string()))
+    })
 }
 
 #[pyfunction]
-fn recv(slf: &mut WasiSocket, bufsize: usize, _flags: &PyAny) -> PyResult<Vec<u8>> {
-    let mut buf = Vec::with_capacity(bufsize);
-    slf.stream
+fn recv<'a>(
+    py: Python<'a>,
+    slf: &mut WasiSocket,
+    bufsize: usize,
+    _flags: &PyAny,
+) -> PyResult<&'a PyBytes> {
+    let WasiSocket {
+        stream,
+        recv_buffer,
+    } = slf;
+    let stream = stream
         .as_mut()
-        .ok_or_else(|| SocketError::new_err("Call connect() first!".to_owned()))
-        .and_then(|s| {
-            s.read(&mut buf)
-                .map(|_| buf)
-                .map_err(|e| SocketError::new_err(e.to_string()))
+        .ok_or_else(|| SocketError::new_err("Call connect() first!".to_owned()))?;
+
+    if recv_buffer.len() < bufsize {
+        recv_buffer.resize(bufsize.max(DEFAULT_RECV_BUFFER_SIZE), 0);
+    }
+
+    stream
+        .read(&mut recv_buffer[..bufsize])
+        .map(|read| PyBytes::new(py, &recv_buffer[..read]))
+        .map_err(|e| SocketError::new_err(e.to_string()))
+}
+
+/// Receive up to `nbytes` bytes into `buffer`, or as many as fits if `nbytes` is 0
+///
+/// The bytes are read straight into the memory of `buffer` when it
+/// is contiguous, without going through an intermediate bytes object.
+#[pyfunction]
+fn recv_into(
+    py: Python,
+    slf: &mut WasiSocket,
+    buffer: &PyAny,
+    nbytes: usize,
+    _flags: &PyAny,
+) -> PyResult<usize> {
+    let target = PyBuffer::<u8>::get(buffer)?;
+    if target.readonly() {
+        return Err(SocketError::new_err(
+            "recv_into() requires a writable buffer".to_owned(),
+        ));
+    }
+
+    let nbytes = match nbytes {
+        0 => target.len_bytes(),
+        n if n > target.len_bytes() => {
+            return Err(SocketError::new_err(
+                "nbytes is greater than the length of the buffer".to_owned(),
+            ))
+        }
+        n => n,
+    };
+
+    let stream = slf.stream()?;
+    if target.is_c_contiguous() {
+        // Safety: the buffer is contiguous, writable and kept alive (and
+        // the GIL held) for as long as the slice is used
+        let bytes = unsafe { std::slice::from_raw_parts_mut(target.buf_ptr() as *mut u8, nbytes) };
+        stream
+            .read(bytes)
+            .map_err(|e| SocketError::new_err(e.to_string()))
+    } else {
+        // non-contiguous buffers can not be read into directly so
+        // read into a copy and then write the whole copy back
+        let mut bytes = target.to_vec(py)?;
+        let read = stream
+            .read(&mut bytes[..nbytes])
+            .map_err(|e| SocketError::new_err(e.to_string()))?;
+        target.copy_from_slice(py, &bytes)?;
+        Ok(read)
+    }
+}
+
+#[pyfunction]
+fn fileno(slf: &mut WasiSocket) -> PyResult<i32> {
+    slf.stream().map(|s| s.as_raw_fd())
+}
+
+/// Kind of object to poll, matching the kinds on the host
+const POLL_SOCKET: u8 = 0;
+const POLL_PROCESS: u8 = 1;
+
+/// Wait for sockets and host processes to become ready
+///
+/// `entries` are tuples of `(kind, id, events)` where `id` is a file
+/// descriptor for sockets and a process id for host processes. A `timeout`
+/// (in seconds) of `None` waits until something is ready. Returns the ready
+/// events for each entry, in the same order.
+#[pyfunction]
+fn poll(entries: Vec<(u8, u64, u16)>, timeout: Option<f64>) -> PyResult<Vec<u16>> {
+    let mut poll_entries = entries
+        .iter()
+        .map(|(kind, id, events)| match *kind {
+            POLL_SOCKET => Ok(PollEntry::socket(*id as i32, *events)),
+            POLL_PROCESS => Ok(PollEntry::process(*id)),
+            _ => Err(SocketError::new_err(format!("Invalid poll kind {}", kind))),
         })
+        .collect::<PyResult<Vec<_>>>()?;
+
+    ::firm::net::poll(
+        &mut poll_entries,
+        timeout.map(|t| Duration::from_secs_f64(t.max(0.0))),
+    )
+    .map_err(|e| SocketError::new_err(e.to_string()))?;
+
+    Ok(poll_entries.iter().map(PollEntry::revents).collect())
+}
+
+#[pyfunction]
+fn close(slf: &mut WasiSocket) {
+    slf.stream = None;
+    slf.recv_buffer = Vec::new();
 }
 
 #[pyfunction]
@@ -63,7 +215,19 @@ fn socket_module(_py: Python, m: &PyModule) -> PyResult<()> {
     m.add_function(wrap_pyfunction!(connect, m)?)?;
 
     m.add_function(wrap_pyfunction!(send, m)?)?;
+    m.add_function(wrap_pyfunction!(sendall, m)?)?;
     m.add_function(wrap_pyfunction!(recv, m)?)?;
+    m.add_function(wrap_pyfunction!(recv_into, m)?)?;
+    m.add_function(wrap_pyfunction!(close, m)?)?;
+    m.add_function(wrap_pyfunction!(fileno, m)?)?;
+    m.add_function(wrap_pyfunction!(poll, m)?)?;
+
+    m.add("POLL_SOCKET", POLL_SOCKET)?;
+    m.add("POLL_PROCESS", POLL_PROCESS)?;
+    m.add("POLL_READABLE", ::firm::net::POLL_READABLE)?;
+    m.add("POLL_WRITABLE", ::firm::net::POLL_WRITABLE)?;
+    m.add("POLL_HANGUP", ::firm::net::POLL_HANGUP)?;
+    m.add("POLL_ERROR", ::firm::net::POLL_ERROR)?;
 
     Ok(())
 }
@@ -75,4 +239,12 @@ pub extern "C" fn init() -> *mut ffi::PyObject {
 pub fn load_py_module(py: Python<'_>) -> PyResult<&'_ PyModule> {
     PyModule::from_code(py, include_str!("socket.py"), "socket_shim", "socket")
         .and_then(|_| PyModule::from_code(py, include_str!("select.py"), "select_shim", "select"))
+        .and_then(|_| {
+            PyModule::from_code(
+                py,
+                include_str!("wasi_asyncio.py"),
+                "wasi_asyncio_shim",
+                "wasi_asyncio",
+            )
+        })
 }
@@ -0,0 +1,230 @@
+"""asyncio support for the Python WASI runtime
+
+Sockets and host processes are waited on together with a single poll on the
+host so that many requests (and processes) can be in flight at once. Use
+`wasi_asyncio.run` instead of `asyncio.run`, or call `wasi_asyncio.install`
+to make asyncio use the WASI event loop by default.
+"""
+import collections.abc
+import selectors
+
+import wasi_socket
+
+_event_loop_class = None
+
+
+class HostProcess:
+    """A host process started with `firm.start_host_process`
+
+    Host processes are readable in the selector once they have exited.
+    """
+
+    def __init__(self, pid):
+        self.pid = pid
+
+    def fileno(self):
+        # negative so that it never collides with a socket
+        return -1 - self.pid
+
+
+def _fileno(fileobj):
+    """Get the file descriptor for `fileobj`, which is negative for host processes"""
+    if isinstance(fileobj, int):
+        return fileobj
+    try:
+        return int(fileobj.fileno())
+    except (AttributeError, TypeError, ValueError):
+        raise ValueError(f"Invalid file object: {fileobj!r}") from None
+
+
+class _SelectorMapping(collections.abc.Mapping):
+    """Mapping of file objects to selector keys, see `selectors.BaseSelector.get_map`"""
+
+    def __init__(self, selector):
+        self._selector = selector
+
+    def __len__(self):
+        return len(self._selector._keys)
+
+    def __getitem__(self, fileobj):
+        return self._selector._lookup(fileobj)
+
+    def __iter__(self):
+        return iter(self._selector._keys)
+
+
+class WasiSelector(selectors.BaseSelector):
+    """Selector for sockets and host processes that polls on the host"""
+
+    def __init__(self):
+        self._keys = {}
+        self._map = _SelectorMapping(self)
+
+    def _lookup(self, fileobj):
+        """Get the key for `fileobj`, also when it has been closed since it was registered"""
+        try:
+            return self._keys[_fileno(fileobj)]
+        except (KeyError, ValueError):
+            # closed sockets have no file descriptor, look for the socket itself
+            for key in self._keys.values():
+                if key.fileobj is fileobj:
+                    return key
+            raise KeyError(f"{fileobj!r} is not registered") from None
+
+    def register(self, fileobj, events, data=None):
+        if not events or events & ~(selectors.EVENT_READ | selectors.EVENT_WRITE):
+            raise ValueError(f"Invalid events: {events!r}")
+
+        fd = _fileno(fileobj)
+        if fd < 0 and not isinstance(fileobj, HostProcess):
+            raise ValueError(f"Invalid file descriptor: {fd}")
+        if fd in self._keys:
+            raise KeyError(f"{fileobj!r} (FD {fd}) is already registered")
+
+        key = selectors.SelectorKey(fileobj, fd, events, data)
+        self._keys[fd] = key
+        return key
+
+    def unregister(self, fileobj):
+        key = self._lookup(fileobj)
+        del self._keys[key.fd]
+        return key
+
+    def get_map(self):
+        return self._map
+
+    def close(self):
+        self._keys.clear()
+
+    @staticmethod
+    def _poll_entry(key):
+        if isinstance(key.fileobj, HostProcess):
+            return (wasi_socket.POLL_PROCESS, key.fileobj.pid, wasi_socket.POLL_READABLE)
+
+        events = 0
+        if key.events & selectors.EVENT_READ:
+            events |= wasi_socket.POLL_READABLE
+        if key.events & selectors.EVENT_WRITE:
+            events |= wasi_socket.POLL_WRITABLE
+        return (wasi_socket.POLL_SOCKET, key.fd, events)
+
+    def select(self, timeout=None):
+        keys = list(self._keys.values())
+        revents = wasi_socket.poll([self._poll_entry(key) for key in keys], timeout)
+
+        # hangups and errors are reported as ready so that
+        # the next read or write gets to see what happened
+        failed = wasi_socket.POLL_HANGUP | wasi_socket.POLL_ERROR
+        ready = []
+        for key, revent in zip(keys, revents):
+            events = 0
+            if revent & (wasi_socket.POLL_READABLE | failed):
+                events |= key.events & selectors.EVENT_READ
+            if revent & (wasi_socket.POLL_WRITABLE | failed):
+                events |= key.events & selectors.EVENT_WRITE
+            if events:
+                ready.append((key, events))
+        return ready
+
+
+def event_loop_class():
+    """Get the WASI event loop class
+
+    The class is created on first use so that asyncio is
+    only imported by functions that actually use it.
+    """
+    global _event_loop_class
+    if _event_loop_class is not None:
+        return _event_loop_class
+
+    import asyncio
+    import socket
+
+    class WasiEventLoop(asyncio.SelectorEventLoop):
+        """Selector event loop that polls sockets and host processes on the host
+
+        There are no threads that need to wake the loop up so it does not
+        have a self-pipe. TLS connections are not supported.
+        """
+
+        def __init__(self):
+            super().__init__(WasiSelector())
+
+        def _make_self_pipe(self):
+            self._ssock = None
+            self._csock = None
+
+        def _close_self_pipe(self):
+            pass
+
+        async def create_connection(
+            self, protocol_factory, host=None, port=None, *, ssl=None, sock=None, **kwargs
+        ):
+            if ssl:
+                raise NotImplementedError(
+                    "TLS is not supported by the WASI event loop"
+                )
+
+            if sock is None:
+                if host is None or port is None:
+                    raise ValueError("host and port must be given when sock is not")
+                # the connection is made on the host and blocks until connected
+                sock = socket.create_connection((host, port))
+
+            sock.setblocking(False)
+            return await self._create_connection_transport(
+                sock, protocol_factory, None, None
+            )
+
+        async def wait_host_process(self, pid):
+            """Wait for the host process `pid` to exit"""
+            process = HostProcess(pid)
+            exited = self.create_future()
+
+            def on_exit():
+                self.remove_reader(process)
+                if not exited.done():
+                    exited.set_result(None)
+
+            self.add_reader(process, on_exit)
+            try:
+                await exited
+            finally:
+                self.remove_reader(process)
+
+    _event_loop_class = WasiEventLoop
+    return _event_loop_class
+
+
+def new_event_loop():
+    return event_loop_class()()
+
+
+def install():
+    """Make asyncio create WASI event loops, for example in `asyncio.run`"""
+    import asyncio
+
+    class WasiEventLoopPolicy(asyncio.DefaultEventLoopPolicy):
+        _loop_factory = event_loop_class()
+
+    asyncio.set_event_loop_policy(WasiEventLoopPolicy())
+
+
+def run(main, *, debug=False):
+    """Run the coroutine `main` on a WASI event loop, like `asyncio.run`"""
+    import asyncio
+
+    install()
+    return asyncio.run(main, debug=debug)
+
+
+async def wait_host_process(pid):
+    """Wait for the host process `pid` (from `firm.start_host_process`) to exit"""
+    import asyncio
+
+    loop = asyncio.get_running_loop()
+    if not isinstance(loop, event_loop_class()):
+        raise RuntimeError(
+            "wait_host_process requires the WASI event loop, see wasi_asyncio.install"
+        )
+    await loop.wait_host_process(pid)
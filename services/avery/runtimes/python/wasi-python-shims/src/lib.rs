@@ -1,7 +1,7 @@
 pub mod thread;
 
 use std::{
-    ffi::CString,
+    ffi::CStr,
     os::raw::{c_char, c_int},
 };
 
@@ -38,9 +38,14 @@ pub extern "C" fn umask(_mask: mode_t) -> mode_t {
     0
 }
 
-const DEFAULT_USERNAME: &str = "wasi-user";
-const DEFAULT_HOMEDIR: &str = "/homeless/";
-const DEFAULT_SHELL: &str = "/unshelled";
+// these are nul terminated so that they
+// can be handed out as C strings directly
+const DEFAULT_USERNAME: &str = "wasi-user\0";
+const DEFAULT_HOMEDIR: &str = "/homeless/\0";
+const DEFAULT_SHELL: &str = "/unshelled\0";
+
+/// Max length of a user name, including the nul terminator
+const MAX_USERNAME_LEN: usize = 256;
 
 struct PasswdBuffer {
     buffer: *mut c_char,
@@ -63,30 +68,12 @@ struct PasswdBuilder {
 }
 
 impl PasswdBuilder {
-    fn new() -> Self {
-        Self {
-            passwd: Box::new(passwd {
-                pw_name: std::ptr::null_mut::<c_char>(),
-                pw_uid: 0,
-                pw_gid: 0,
-                pw_dir: std::ptr::null_mut::<c_char>(),
-                pw_shell: std::ptr::null_mut::<c_char>(),
-            }),
-        }
-    }
-
     unsafe fn from_raw(passwd: *mut passwd) -> Self {
         Self {
             passwd: Box::from_raw(passwd),
         }
     }
 
-    fn name(mut self, name: &str) -> Self {
-        self.passwd.pw_name = CString::new(name).unwrap().into_raw();
-
-        self
-    }
-
     unsafe fn name_with_buffer(mut self, name: &str, buffer: &mut PasswdBuffer) -> Self {
         if buffer.capacity >= name.len() + buffer.offset {
             buffer
@@ -118,12 +105,6 @@ impl PasswdBuilder {
         self
     }
 
-    fn home_dir(mut self, home_dir: &str) -> Self {
-        self.passwd.pw_dir = CString::new(home_dir).unwrap().into_raw();
-
-        self
-    }
-
     unsafe fn home_dir_with_buffer(mut self, home_dir: &str, buffer: &mut PasswdBuffer) -> Self {
         if buffer.capacity >= home_dir.len() + buffer.offset {
             buffer
@@ -137,12 +118,6 @@ impl PasswdBuilder {
         self
     }
 
-    fn shell(mut self, shell: &str) -> Self {
-        self.passwd.pw_shell = CString::new(shell).unwrap().into_raw();
-
-        self
-    }
-
     unsafe fn shell_with_buffer(mut self, shell: &str, buffer: &mut PasswdBuffer) -> Self {
         if buffer.capacity >= shell.len() + buffer.offset {
             buffer
@@ -159,22 +134,6 @@ impl PasswdBuilder {
     fn into_raw(self) -> *mut passwd {
         Box::into_raw(self.passwd)
     }
-
-    fn build(self) -> Box<passwd> {
-        self.passwd
-    }
-}
-
-impl Default for Box<passwd> {
-    fn default() -> Self {
-        PasswdBuilder::new()
-            .name(DEFAULT_USERNAME)
-            .home_dir(DEFAULT_HOMEDIR)
-            .shell(DEFAULT_SHELL)
-            .gid(1)
-            .uid(1)
-            .build()
-    }
 }
 
 /// Passwd entry
@@ -187,27 +146,68 @@ pub struct passwd {
     pw_shell: *mut c_char,
 }
 
-/// Get a pwd entry from a uid
+/// Record returned by the non-reentrant passwd functions
+///
+/// Like in glibc, every call overwrites the record
+/// returned by the previous one and it must not be freed.
+static mut PASSWD: passwd = passwd {
+    pw_name: std::ptr::null_mut(),
+    pw_uid: 1,
+    pw_gid: 1,
+    pw_dir: DEFAULT_HOMEDIR.as_ptr() as *mut c_char,
+    pw_shell: DEFAULT_SHELL.as_ptr() as *mut c_char,
+};
+static mut PASSWD_NAME: [c_char; MAX_USERNAME_LEN] = [0; MAX_USERNAME_LEN];
+
+/// Fill in the static passwd record for the user `name` (without nul terminator)
+///
+/// # Safety
+/// Overwrites the static passwd record
+unsafe fn static_passwd(name: &[u8]) -> *mut passwd {
+    if name.len() >= MAX_USERNAME_LEN {
+        return std::ptr::null_mut();
+    }
+
+    let passwd_name = &mut *std::ptr::addr_of_mut!(PASSWD_NAME);
+    passwd_name
+        .as_mut_ptr()
+        .copy_from(name.as_ptr() as *const c_char, name.len());
+    passwd_name[name.len()] = 0;
+
+    let passwd = std::ptr::addr_of_mut!(PASSWD);
+    (*passwd).pw_name = passwd_name.as_mut_ptr();
+    passwd
+}
+
+fn default_username() -> &'static [u8] {
+    DEFAULT_USERNAME
+        .strip_suffix('\0')
+        .unwrap_or(DEFAULT_USERNAME)
+        .as_bytes()
+}
+
+/// Get a pwd entry from a username
 ///
-/// The caller is responsible for freeing allocated memory
+/// The returned entry is static and overwritten by the next call,
+/// it must not be freed. Returns null if the name is too long.
 /// # Safety
-/// Freeing the original name and replacing it with the input name.
+/// `name` must be a valid, nul terminated string
 #[no_mangle]
 pub unsafe extern "C" fn getpwnam(name: *const c_char) -> *mut passwd {
-    let mut passwd = Box::<passwd>::default();
-    let c_string = CString::from_raw(passwd.pw_name);
-    std::mem::drop(c_string);
-    passwd.pw_name = name as *mut c_char;
+    if name.is_null() {
+        return std::ptr::null_mut();
+    }
 
-    Box::into_raw(passwd)
+    static_passwd(CStr::from_ptr(name).to_bytes())
 }
 
 /// Get a pwd entry from a uid
 ///
-/// The caller is responsible for freeing allocated memory
+/// The returned entry is static and overwritten by the next call,
+/// it must not be freed.
 #[no_mangle]
 pub extern "C" fn getpwuid(_uid: uid_t) -> *mut passwd {
-    Box::into_raw(Box::<passwd>::default())
+    unsafe { static_passwd(default_username()) }
 }
 
 /// Get a pwd entry from a username, using a provided buffer
@@ -266,13 +266,15 @@ static mut PWENT_INDEX: usize = 0;
 
 /// Get the next pw entry
 ///
+/// The returned entry is static and overwritten by the next call,
+/// it must not be freed.
 /// # Safety
 /// The global pw entry index is mutated
 #[no_mangle]
 pub unsafe extern "C" fn getpwent() -> *mut passwd {
     if PWENT_INDEX == 0 {
         PWENT_INDEX += 1;
-        Box::into_raw(Box::<passwd>::default())
+        static_passwd(default_username())
     } else {
         std::ptr::null_mut()
     }
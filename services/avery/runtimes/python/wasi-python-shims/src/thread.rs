@@ -1,5 +1,7 @@
-use lazy_static::lazy_static;
-use std::{collections::HashMap, ffi::c_void, sync::RwLock};
+use std::{
+    ffi::c_void,
+    sync::atomic::{AtomicPtr, Ordering},
+};
 
 /// Lock data structure that is used as a cookie.
 #[repr(C)]
@@ -7,9 +9,17 @@ pub struct WasiThreadLock {
     locked: bool,
 }
 
-lazy_static! {
-    static ref TSS_STORAGE: RwLock<HashMap<u64, u64>> = RwLock::new(HashMap::new());
-}
+/// Number of thread specific storage keys, keys must be smaller than this
+pub const TSS_CAPACITY: usize = 128;
+
+#[allow(clippy::declare_interior_mutable_const)]
+const EMPTY_TSS_SLOT: AtomicPtr<c_void> = AtomicPtr::new(std::ptr::null_mut());
+
+/// Thread specific storage, indexed directly by key
+///
+/// There is only one thread so there is only one table. Once
+/// threads can run, each of them needs a table of its own.
+static TSS: [AtomicPtr<c_void>; TSS_CAPACITY] = [EMPTY_TSS_SLOT; TSS_CAPACITY];
 
 /// Initialize the threading library at lightning speed!
 #[no_mangle]
@@ -85,26 +95,23 @@ pub unsafe extern "C" fn wt_release_lock(lock: *mut WasiThreadLock) {
 
 /// Creates thread specific storage
 ///
-///(or just returns true without doing any work)
+/// Returns false if `key` is not smaller than `TSS_CAPACITY`.
 #[no_mangle]
-pub extern "C" fn wt_tss_create(_key: u64) -> bool {
-    true
+pub extern "C" fn wt_tss_create(key: u64) -> bool {
+    (key as usize) < TSS_CAPACITY
 }
 
 /// Deletes thread specific storage at the provided key.
 #[no_mangle]
 pub extern "C" fn wt_tss_delete(key: u64) -> bool {
-    TSS_STORAGE.write().map_or(false, |mut tss| {
-        tss.remove(&key);
-        true
-    })
+    wt_tss_set(key, std::ptr::null_mut())
 }
 
 /// Sets thread specific storage at the provided key.
 #[no_mangle]
 pub extern "C" fn wt_tss_set(key: u64, value: *mut c_void) -> bool {
-    TSS_STORAGE.write().map_or(false, |mut tss| {
-        tss.insert(key, value as u64);
+    TSS.get(key as usize).map_or(false, |slot| {
+        slot.store(value, Ordering::Relaxed);
         true
     })
 }
@@ -112,9 +119,6 @@ pub extern "C" fn wt_tss_set(key: u64, value: *mut c_void) -> bool {
 /// Gets the thread specific storage stored at provided key.
 #[no_mangle]
 pub extern "C" fn wt_tss_get(key: u64) -> *mut c_void {
-    TSS_STORAGE.read().map_or(std::ptr::null_mut(), |tss| {
-        tss.get(&key)
-            .map(|a| *a as *mut c_void)
-            .unwrap_or(std::ptr::null_mut())
-    })
+    TSS.get(key as usize)
+        .map_or(std::ptr::null_mut(), |slot| slot.load(Ordering::Relaxed))
 }
@@ -0,0 +1,102 @@
+#include "wasi_python_shims.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 1000000
+
+// results are written as one JSON object per line
+// so that they can be compared between releases
+static void report(const char *name, long iterations,
+                   const struct timespec *start, const struct timespec *end) {
+  double total_ns = (double)(end->tv_sec - start->tv_sec) * 1e9 +
+                    (double)(end->tv_nsec - start->tv_nsec);
+  printf("{\"name\": \"%s\", \"iterations\": %ld, \"total_ns\": %.0f, "
+         "\"ns_per_call\": %.2f}\n",
+         name, iterations, total_ns, total_ns / iterations);
+  fflush(stdout);
+}
+
+#define bench(name, iterations, body)                                          \
+  {                                                                            \
+    struct timespec start, end;                                                \
+    clock_gettime(CLOCK_MONOTONIC, &start);                                    \
+    for (long i = 0; i < iterations; ++i) {                                    \
+      body;                                                                    \
+    }                                                                          \
+    clock_gettime(CLOCK_MONOTONIC, &end);                                      \
+    report(name, iterations, &start, &end);                                    \
+  }
+
+void bench_tss(long iterations) {
+  uint64_t key = 3;
+  int value = 17;
+  void *volatile sink = NULL;
+
+  assert(wt_tss_create(key));
+  bench("wt_tss_set", iterations, wt_tss_set(key, &value));
+  bench("wt_tss_get", iterations, sink = wt_tss_get(key));
+  assert(sink == &value);
+  assert(wt_tss_delete(key));
+}
+
+void bench_locks(long iterations) {
+  WasiThreadLock *lock = wt_allocate_lock();
+  volatile bool sink = false;
+
+  bench("wt_acquire_lock+wt_release_lock", iterations, {
+    sink = wt_acquire_lock(lock);
+    wt_release_lock(lock);
+  });
+  assert(sink);
+
+  assert(wt_acquire_lock(lock));
+  bench("wt_acquire_lock (held)", iterations, sink = wt_acquire_lock(lock));
+  assert(!sink);
+  wt_release_lock(lock);
+  wt_free_lock(lock);
+
+  bench("wt_allocate_lock+wt_free_lock", iterations,
+        wt_free_lock(wt_allocate_lock()));
+
+  volatile uint64_t ident = 0;
+  bench("wt_get_thread_ident", iterations, ident = wt_get_thread_ident());
+  assert(ident != 0);
+}
+
+void bench_passwd(long iterations) {
+  passwd p, *pp = NULL;
+  char buff[512];
+
+  bench("getpwnam_r", iterations,
+        getpwnam_r("sune", &p, buff, sizeof(buff), &pp));
+  assert(pp == &p);
+
+  bench("getpwuid_r", iterations, getpwuid_r(1, &p, buff, sizeof(buff), &pp));
+  assert(pp == &p);
+
+  passwd *volatile sink = NULL;
+  bench("getpwnam", iterations, sink = getpwnam("sune"));
+  assert(sink != NULL);
+  bench("getpwuid", iterations, sink = getpwuid(1));
+  assert(sink != NULL);
+  bench("setpwent+getpwent+endpwent", iterations, {
+    setpwent();
+    sink = getpwent();
+    endpwent();
+  });
+  assert(sink != NULL);
+}
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+  assert(iterations > 0);
+
+  bench_tss(iterations);
+  bench_locks(iterations);
+  bench_passwd(iterations);
+
+  return 0;
+}
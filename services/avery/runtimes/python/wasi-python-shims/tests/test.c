@@ -10,13 +10,6 @@
   fn();                                                                        \
   printf("\033[32mok!\033[0m\n");
 
-void free_pw(passwd *pw) {
-  free(pw->pw_name);
-  free(pw->pw_dir);
-  free(pw->pw_shell);
-  free(pw);
-}
-
 void test_chmod() { assert(-1 == chmod("sunes sås.", 1)); }
 
 void test_dup() { assert(-1 == dup(1)); }
@@ -28,16 +21,28 @@ void test_umask() {
 }
 
 void test_getpwnam() {
-  const char *name = "sune";
+  char name[] = "sune";
   passwd *pw = getpwnam(name);
-  assert(strcmp(pw->pw_name, name) == 0);
-  free_pw(pw);
+  assert(pw != NULL);
+  assert(strcmp(pw->pw_name, "sune") == 0);
+
+  // the name is copied, not aliased
+  assert(pw->pw_name != name);
+  name[0] = 'r';
+  assert(strcmp(pw->pw_name, "sune") == 0);
+
+  // the entry is static and overwritten by the next call
+  assert(getpwnam("rune") == pw);
+  assert(strcmp(pw->pw_name, "rune") == 0);
 }
 
 void test_getpwuid() {
   passwd *pw = getpwuid(1);
   assert(pw != NULL);
-  free_pw(pw);
+  assert(strlen(pw->pw_name) > 0);
+  assert(strlen(pw->pw_dir) > 0);
+  assert(strlen(pw->pw_shell) > 0);
+  assert(getpwuid(1) == pw);
 }
 
 void test_getpwnam_r() {
@@ -80,9 +85,7 @@ void test_pwent() {
   assert(res1 != NULL);
   assert(res2 == NULL);
   assert(res3 != NULL);
-
-  free_pw(res1);
-  free_pw(res3);
+  assert(strlen(res3->pw_name) > 0);
 }
 
 void test_getegid() { assert(1 == getegid()); }
@@ -136,6 +139,11 @@ void test_thread_local_storage() {
   assert(*(uint32_t *)wt_tss_get(key) == 17);
   assert(wt_tss_delete(key));
   assert(wt_tss_get(key) == NULL);
+
+  // keys index a fixed size table
+  assert(!wt_tss_create(TSS_CAPACITY));
+  assert(!wt_tss_set(TSS_CAPACITY, &value));
+  assert(wt_tss_get(TSS_CAPACITY) == NULL);
 }
 
 int main() {
@@ -150,6 +150,17 @@ pub struct Config {
 
     #[serde(default)]
     pub auth: Auth,
+
+    #[serde(default)]
+    pub compilers: CompilerConfig,
+
+    /// Max number of warm function snapshots to keep in memory
+    #[serde(default = "default_max_warm_snapshots")]
+    pub max_warm_snapshots: usize,
+}
+
+fn default_max_warm_snapshots() -> usize {
+    crate::runtime::wasi::DEFAULT_MAX_WARM_SNAPSHOTS
 }
 
 fn default_version_suffix() -> String {
@@ -182,10 +193,61 @@ impl Default for ConflictResolutionMethod {
     }
 }
 
+/// Compiler used to compile WASM modules before executing them
+#[derive(Debug, Deserialize, Clone, Copy, PartialEq, Eq)]
+#[serde(rename_all = "kebab-case")]
+pub enum Compiler {
+    /// Cranelift without optimizations. Fast compilation, slower execution.
+    /// Good for one-off functions.
+    Fast,
+
+    /// Cranelift with optimizations. Slower compilation, faster execution.
+    /// Compiled modules are cached.
+    Optimized,
+
+    /// Start without optimizations and recompile with optimizations in the
+    /// background when a module has been executed a few times.
+    Tiered,
+}
+
+impl Default for Compiler {
+    fn default() -> Self {
+        Compiler::Optimized
+    }
+}
+
+#[derive(Debug, Deserialize, Clone, Default)]
+pub struct CompilerConfig {
+    /// Compiler to use for runtimes that are not listed in `runtimes`
+    #[serde(default)]
+    pub default: Compiler,
+
+    /// Compiler overrides per runtime name
+    #[serde(default)]
+    pub runtimes: HashMap<String, Compiler>,
+}
+
+impl CompilerConfig {
+    pub fn for_runtime(&self, runtime_name: &str) -> Compiler {
+        self.runtimes
+            .get(runtime_name)
+            .copied()
+            .unwrap_or(self.default)
+    }
+}
+
 #[derive(Debug, Deserialize, Eq, PartialEq)]
 pub struct Registry {
     pub name: String,
     pub url: String,
+
+    /// Seconds to wait for the registry before leaving it out of a response
+    #[serde(default = "default_registry_timeout")]
+    pub timeout: u64,
+}
+
+fn default_registry_timeout() -> u64 {
+    crate::proxy_registry::DEFAULT_REGISTRY_TIMEOUT.as_secs()
 }
 
 const DEFAULT_CFG_FILE_NAME: &str = "avery.toml";
@@ -275,6 +337,38 @@ mod tests {
         assert!(c.is_ok());
     }
 
+    #[test]
+    fn compilers() {
+        let c = Config::new_with_toml_string(
+            r#"
+[compilers]
+default="fast"
+[compilers.runtimes]
+python="optimized"
+"#,
+        );
+        assert!(c.is_ok());
+
+        let conf = c.unwrap();
+        assert_eq!(conf.compilers.for_runtime("python"), Compiler::Optimized);
+        assert_eq!(conf.compilers.for_runtime("wasi"), Compiler::Fast);
+
+        let conf = Config::new_with_toml_string("").unwrap();
+        assert_eq!(conf.compilers.for_runtime("wasi"), Compiler::Optimized);
+    }
+
+    #[test]
+    fn max_warm_snapshots() {
+        let conf = Config::new_with_toml_string("max_warm_snapshots = 4").unwrap();
+        assert_eq!(conf.max_warm_snapshots, 4);
+
+        let conf = Config::new_with_toml_string("").unwrap();
+        assert_eq!(
+            conf.max_warm_snapshots,
+            crate::runtime::wasi::DEFAULT_MAX_WARM_SNAPSHOTS
+        );
+    }
+
     #[test]
     fn oidc_providers() {
         let c = Config::new_with_toml_string(
@@ -382,6 +476,7 @@ hosted_domains=["💈.no", "🌡️.yes"]
         [[registries]]
         name="registry3"
         url="https://on-the-internet.com"
+        timeout=1
         "#,
         );
         assert!(c.is_ok());
@@ -391,10 +486,12 @@ hosted_domains=["💈.no", "🌡️.yes"]
                 Registry {
                     name: "registry1".to_owned(),
                     url: "https://over-here".to_owned(),
+                    timeout: 5,
                 },
                 Registry {
                     name: "registry3".to_owned(),
                     url: "https://on-the-internet.com".to_owned(),
+                    timeout: 1,
                 }
             ]
         );
@@ -32,7 +32,7 @@ use crate::{
     auth::AuthService,
     auth::AuthenticationSource,
     runtime::FunctionDirectory,
-    runtime::{Runtime, RuntimeParameters, RuntimeSource},
+    runtime::{CancellationToken, Runtime, RuntimeParameters, RuntimeSource},
 };
 
 #[derive(Debug, Clone)]
@@ -77,12 +77,44 @@ pub struct QueuedFunction {
     output_sender: Sender<Result<FunctionOutputChunk, tonic::Status>>,
 }
 
+/// Entry in the running executions that is removed again when dropped
+///
+/// Dropping it before the execution finished, which happens when the request is
+/// dropped, also cancels the execution since nobody is waiting for the result.
+struct RunningExecution {
+    running_executions: Arc<Mutex<HashMap<Uuid, CancellationToken>>>,
+    id: Uuid,
+    finished: bool,
+}
+
+impl RunningExecution {
+    fn finish(mut self) {
+        self.finished = true;
+    }
+}
+
+impl Drop for RunningExecution {
+    fn drop(&mut self) {
+        if let Some(cancellation) = self
+            .running_executions
+            .lock()
+            .ok()
+            .and_then(|mut running_executions| running_executions.remove(&self.id))
+        {
+            if !self.finished {
+                cancellation.cancel();
+            }
+        }
+    }
+}
+
 #[derive(Clone)]
 pub struct ExecutionService {
     logger: Logger,
     registry: Arc<dyn Registry>,
     runtime_sources: Arc<Vec<Box<dyn RuntimeSource>>>,
     execution_queue: Arc<Mutex<HashMap<Uuid, QueuedFunction>>>, // Death row hehurr
+    running_executions: Arc<Mutex<HashMap<Uuid, CancellationToken>>>,
     root_dir: PathBuf,
     auth_service: AuthService,
     thread_pool: Arc<ThreadPool>,
@@ -101,6 +133,7 @@ impl ExecutionService {
             registry: Arc::new(registry),
             runtime_sources: Arc::new(runtime_sources),
             execution_queue: Arc::new(Mutex::new(HashMap::new())),
+            running_executions: Arc::new(Mutex::new(HashMap::new())),
             root_dir: root_dir.to_owned(),
             auth_service,
             thread_pool: Arc::new(
@@ -154,6 +187,7 @@ impl ExecutionServiceTrait for ExecutionService {
                     limit: 1,
                 }),
                 publisher_email: String::new(),
+                continuation_token: String::new(),
             }))
             .await?
             .into_inner()
@@ -220,18 +254,35 @@ impl ExecutionServiceTrait for ExecutionService {
             tonic::Status::invalid_argument(format!("Failed to parse execution id as uuid: {}.", e))
         })?;
 
-        let queued_function = self
-            .execution_queue
-            .lock()
-            .map_err(|_| tonic::Status::internal("Failed to lock execution queue."))?
-            .remove(&uuid)
-            .ok_or_else(|| {
+        let cancellation = CancellationToken::new();
+        let (queued_function, running_execution) = {
+            let mut execution_queue = self
+                .execution_queue
+                .lock()
+                .map_err(|_| tonic::Status::internal("Failed to lock execution queue."))?;
+            let queued_function = execution_queue.remove(&uuid).ok_or_else(|| {
                 tonic::Status::not_found(format!(
                     "Failed to find queued execution with id \"{}\"",
                     uuid
                 ))
             })?;
 
+            // register as running before the queue is unlocked so that
+            // cancel_execution always finds the execution in one of them
+            self.running_executions
+                .lock()
+                .map_err(|_| tonic::Status::internal("Failed to lock running executions."))?
+                .insert(uuid, cancellation.clone());
+            (
+                queued_function,
+                RunningExecution {
+                    running_executions: Arc::clone(&self.running_executions),
+                    id: uuid,
+                    finished: false,
+                },
+            )
+        };
+
         info!(self.logger, "Executing function with id {}", &id.uuid);
 
         let runtime_spec = queued_function.function.runtime.clone().ok_or_else(|| {
@@ -268,7 +319,8 @@ impl ExecutionServiceTrait for ExecutionService {
         })?;
 
         let runtime_name = runtime_spec.name.clone();
-        self.lookup_runtime(&runtime_name)
+        let res = self
+            .lookup_runtime(&runtime_name)
             .map_err(|e| {
                 tonic::Status::new(
                     tonic::Code::Internal,
@@ -281,6 +333,7 @@ impl ExecutionServiceTrait for ExecutionService {
                 let function_name = queued_function.function.name.clone();
                 let function_name2 = function_name.clone();
                 let runtime_name = runtime_name.clone();
+                let runtime_cancellation = cancellation.clone();
 
                 // Use a oneshot channel to make sure to not block the tokio thread
                 // while waiting for the rayon task to finish
@@ -311,6 +364,7 @@ impl ExecutionServiceTrait for ExecutionService {
                                     function_dir: execution_dir,
                                     auth_service,
                                     async_runtime,
+                                    cancellation: runtime_cancellation,
                                 },
                                 queued_function.arguments,
                                 queued_function.function.attachments.clone(),
@@ -321,7 +375,19 @@ impl ExecutionServiceTrait for ExecutionService {
                     let _ = tx.send(res);
                 });
 
-                match rx.await {
+                // If the execution is cancelled we do not wait for the function to
+                // notice, the result will be thrown away when it eventually finishes
+                let res = tokio::select! {
+                    res = rx => res,
+                    _ = cancellation.cancelled() => {
+                        return Err(tonic::Status::cancelled(format!(
+                            r#"Execution of function "{}" was cancelled"#,
+                            &function_name
+                        )))
+                    }
+                };
+
+                match res {
                     Ok(Ok(Ok(r))) => r
                         .validate(&output_spec, None)
                         .map(|_| {
@@ -356,7 +422,49 @@ impl ExecutionServiceTrait for ExecutionService {
                     ))),
                 }
             })
-            .await
+            .await;
+
+        running_execution.finish();
+        res
+    }
+
+    async fn cancel_execution(
+        &self,
+        request: tonic::Request<ExecutionId>,
+    ) -> Result<tonic::Response<ExecutionId>, tonic::Status> {
+        let id = request.into_inner();
+        let uuid = Uuid::parse_str(&id.uuid).map_err(|e| {
+            tonic::Status::invalid_argument(format!("Failed to parse execution id as uuid: {}.", e))
+        })?;
+
+        // an execution that has not started yet only needs to be removed from the queue
+        // dropping it closes the output channel for anyone listening to it
+        if self
+            .execution_queue
+            .lock()
+            .map_err(|_| tonic::Status::internal("Failed to lock execution queue."))?
+            .remove(&uuid)
+            .is_some()
+        {
+            info!(self.logger, "Cancelled queued execution with id {}", uuid);
+            return Ok(tonic::Response::new(id));
+        }
+
+        self.running_executions
+            .lock()
+            .map_err(|_| tonic::Status::internal("Failed to lock running executions."))?
+            .get(&uuid)
+            .ok_or_else(|| {
+                tonic::Status::not_found(format!(
+                    "Failed to find queued or running execution with id \"{}\"",
+                    uuid
+                ))
+            })
+            .map(|cancellation| {
+                info!(self.logger, "Cancelling running execution with id {}", uuid);
+                cancellation.cancel();
+                tonic::Response::new(id)
+            })
     }
 
     async fn function_output(
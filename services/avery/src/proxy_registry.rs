@@ -1,4 +1,11 @@
-use std::collections::{hash_map::Entry, HashMap};
+mod cache;
+
+use std::{
+    collections::{hash_map::Entry, HashMap},
+    future::Future,
+    sync::Arc,
+    time::Duration,
+};
 
 use firm_types::{
     auth::authentication_server::Authentication,
@@ -8,15 +15,17 @@ use firm_types::{
         AttachmentHandle, AttachmentStreamUpload, Filters, Function, Functions, Nothing, Ordering,
         OrderingKey,
     },
+    pagination::ContinuationToken,
     tonic::{
         self,
         codegen::InterceptedService,
+        metadata::MetadataMap,
         service::Interceptor,
         transport::{ClientTlsConfig, Endpoint, Error as TonicTransportError},
         Code, Request, Response, Status, Streaming,
     },
 };
-use futures::{stream, StreamExt, TryStreamExt};
+use futures::{future, stream, FutureExt, StreamExt, TryStreamExt};
 use slog::{warn, Logger};
 use thiserror::Error;
 use tokio::runtime::Handle;
@@ -24,24 +33,34 @@ use tonic_middleware::HttpStatusInterceptor;
 use url::Url;
 
 use crate::{auth::AuthService, config::ConflictResolutionMethod, registry::RegistryService};
+use cache::{CachedListing, ListingKey, ResponseCache};
 
 type RegClient = RegistryClient<InterceptedService<HttpStatusInterceptor, AcquireAuthInterceptor>>;
 
+/// How long to wait for an external registry before leaving it out, unless configured
+pub const DEFAULT_REGISTRY_TIMEOUT: Duration = Duration::from_secs(5);
+
+/// Response metadata listing the external registries that were left out of a listing
+pub const DEGRADED_REGISTRIES_METADATA_KEY: &str = "firm-degraded-registries";
+
 #[derive(Debug, Clone)]
 struct RegistryConnection {
     name: String,
     client: RegClient,
+    timeout: Duration,
 }
 
 /// A forwarding proxy registry
 ///
 /// The registry supports forwarding `list` and `get` calls to a list of external registries and
-/// then combining it with the built-in internal registry
+/// then combining it with the built-in internal registry. Responses from external registries
+/// are cached in memory.
 #[derive(Debug, Clone)]
 pub struct ProxyRegistry {
     internal_registry: RegistryService,
     connections: Vec<RegistryConnection>,
     conflict_resolution: ConflictResolutionMethod,
+    cache: Arc<ResponseCache>,
     log: Logger,
 }
 
@@ -50,6 +69,7 @@ pub struct ProxyRegistry {
 pub struct ExternalRegistry {
     name: String,
     url: Url,
+    timeout: Duration,
 }
 
 #[derive(Error, Debug)]
@@ -76,6 +96,7 @@ struct AcquireAuthInterceptor {
     endpoint: Endpoint,
 }
 
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
 pub enum ListFunction {
     Functions,
     Versions,
@@ -152,6 +173,53 @@ async fn create_connection(
     ))
 }
 
+/// Name of the registry that `function` was listed from
+fn registry_name(function: &Function) -> String {
+    function
+        .metadata
+        .get("registry")
+        .cloned()
+        .unwrap_or_else(|| String::from("unknown"))
+}
+
+/// Wait for `request` to the registry `name`, giving up after `timeout`
+async fn within_timeout<T>(
+    name: &str,
+    timeout: Duration,
+    request: impl Future<Output = Result<T, tonic::Status>>,
+) -> Result<T, tonic::Status> {
+    tokio::time::timeout(timeout, request).await.map_err(|_| {
+        tonic::Status::deadline_exceeded(format!(
+            "Registry \"{}\" did not respond within {:?}",
+            name, timeout
+        ))
+    })?
+}
+
+/// List functions in the registry behind `connection` and cache the response as `key`
+async fn fetch_listing(
+    mut connection: RegistryConnection,
+    list_function: ListFunction,
+    filters: Filters,
+    cache: &ResponseCache,
+    key: ListingKey,
+) -> Result<Functions, tonic::Status> {
+    let request = match list_function {
+        ListFunction::Functions => connection.client.list(Request::new(filters)).left_future(),
+        ListFunction::Versions => connection
+            .client
+            .list_versions(Request::new(filters))
+            .right_future(),
+    };
+    within_timeout(&connection.name, connection.timeout, request)
+        .await
+        .map(|response| {
+            let functions = response.into_inner();
+            cache.insert_listing(key, &functions);
+            functions
+        })
+}
+
 impl ExternalRegistry {
     /// Create a new external registry descriptor
     ///
@@ -159,7 +227,17 @@ impl ExternalRegistry {
     /// `name`: A semantic name for the registry (used to identify this registry in list results)
     /// `url`: A url pointing to the external registry
     pub fn new(name: String, url: Url) -> Self {
-        Self { name, url }
+        Self {
+            name,
+            url,
+            timeout: DEFAULT_REGISTRY_TIMEOUT,
+        }
+    }
+
+    /// Leave the registry out of responses when it does not respond within `timeout`
+    pub fn with_timeout(mut self, timeout: Duration) -> Self {
+        self.timeout = timeout;
+        self
     }
 }
 
@@ -185,15 +263,18 @@ impl ProxyRegistry {
             connections: stream::iter(external_registries)
                 .then(|er| async {
                     let reg_name = er.name.clone();
+                    let timeout = er.timeout;
 
                     Ok::<RegistryConnection, ProxyRegistryError>(RegistryConnection {
                         name: reg_name.clone(),
                         client: create_connection(auth_service.clone(), er).await?,
+                        timeout,
                     })
                 })
                 .try_collect::<Vec<RegistryConnection>>()
                 .await?,
             conflict_resolution,
+            cache: Arc::new(ResponseCache::default()),
             log,
         })
     }
@@ -273,87 +354,241 @@ impl ProxyRegistry {
         }
     }
 
+    /// List functions in the registry behind `connection`, preferring cached responses
+    ///
+    /// Stale responses are returned right away and refreshed in the background.
+    async fn list_remote(
+        &self,
+        connection: &RegistryConnection,
+        list_function: ListFunction,
+        filters: &Filters,
+    ) -> Result<Functions, tonic::Status> {
+        let key = ListingKey::new(&connection.name, list_function, filters);
+        match self.cache.get_listing(&key) {
+            CachedListing::Fresh(functions) => Ok(functions),
+            CachedListing::Stale { functions, refresh } => {
+                if refresh {
+                    let connection = connection.clone();
+                    let filters = filters.clone();
+                    let cache = Arc::clone(&self.cache);
+                    let log = self.log.clone();
+                    tokio::spawn(async move {
+                        let registry = connection.name.clone();
+                        if let Err(e) =
+                            fetch_listing(connection, list_function, filters, &cache, key.clone())
+                                .await
+                        {
+                            warn!(
+                                log,
+                                "Failed to refresh cached listing from registry \"{}\": {}",
+                                registry,
+                                e
+                            );
+                            cache.refresh_failed(&key);
+                        }
+                    });
+                }
+                Ok(functions)
+            }
+            CachedListing::Missing => {
+                fetch_listing(
+                    connection.clone(),
+                    list_function,
+                    filters.clone(),
+                    &self.cache,
+                    key,
+                )
+                .await
+            }
+        }
+    }
+
+    /// Cached function for `filters` if they ask for exactly one version and nothing more
+    fn cached_exact_version(&self, filters: &Filters, order: &Ordering) -> Option<Function> {
+        if !filters.metadata.is_empty()
+            || !filters.publisher_email.is_empty()
+            || !filters.continuation_token.is_empty()
+            || order.offset != 0
+            || order.limit == 0
+        {
+            return None;
+        }
+
+        filters
+            .version_requirement
+            .as_ref()
+            .and_then(|requirement| requirement.expression.trim().strip_prefix('='))
+            .and_then(|version| semver::Version::parse(version.trim()).ok())
+            .and_then(|version| self.cache.get_function(&filters.name, &version))
+    }
+
+    /// Cache `function` if it comes from an external registry
+    ///
+    /// Published function versions never change so these are never looked up again.
+    fn cache_function(&self, function: &Function) {
+        if function
+            .metadata
+            .get("registry")
+            .map_or(false, |registry| registry != "internal")
+        {
+            self.cache.insert_function(function);
+        }
+    }
+
+    /// List the external registries that were left out of a response in `metadata`
+    fn set_degraded_registries(&self, metadata: &mut MetadataMap, degraded_registries: &[String]) {
+        if !degraded_registries.is_empty() {
+            match degraded_registries.join(",").parse() {
+                Ok(value) => {
+                    metadata.insert(DEGRADED_REGISTRIES_METADATA_KEY, value);
+                }
+                Err(e) => warn!(
+                    self.log,
+                    "Failed to set degraded registries in response metadata: {}", e
+                ),
+            }
+        }
+    }
+
+    /// List functions in all registries
+    ///
+    /// External registries that fail or do not respond in time are left out and
+    /// listed in the `DEGRADED_REGISTRIES_METADATA_KEY` response metadata.
     pub async fn list(
         &self,
         filters: Filters,
         list_function: &ListFunction,
-    ) -> Result<Functions, tonic::Status> {
+    ) -> Result<Response<Functions>, tonic::Status> {
         let insert_function = match list_function {
             ListFunction::Functions => ProxyRegistry::try_insert_function,
             ListFunction::Versions => ProxyRegistry::try_insert_version,
         };
-        let mut functions = stream::iter(
-            self.connections
-                .iter()
-                .map(|connection| (connection.clone(), filters.clone())),
-        )
-        .then(|(mut connection, filters)| async move {
-            match list_function {
-                ListFunction::Functions => connection
-                    .client
-                    .list(tonic::Request::new(filters))
-                    .await
-                    .map(|functions| (connection.name.clone(), functions)),
-                ListFunction::Versions => connection
-                    .client
-                    .list_versions(tonic::Request::new(filters))
-                    .await
-                    .map(|functions| (connection.name.clone(), functions)),
-            }
-        })
-        .chain(
-            stream::once(
-                self.internal_registry
-                    .list(tonic::Request::new(filters.clone())),
-            )
-            .map(|f| f.map(|functions| (String::from("internal"), functions))),
-        )
-        .try_collect::<Vec<(String, tonic::Response<Functions>)>>()
-        .await?
-        .into_iter()
-        .map(|(name, mut functions)| {
-            // insert registry into metadata
-            functions
-                .get_mut()
-                .functions
-                .iter_mut()
-                .for_each(|function| {
-                    function
-                        .metadata
-                        .insert("registry".to_owned(), name.clone());
-                });
-
-            functions
-        })
-        .flat_map(|functions| functions.into_inner().functions)
-        .try_fold(HashMap::new(), |map, func| insert_function(self, map, func))
-        .map_err(|e| tonic::Status::already_exists(e.to_string()))?
-        .into_values()
-        .map(|function| {
-            (
-                // The version is only used for sorting so if something is wrong with it,
-                // jus sort it last. This error is also very unlikely since the version is parsed
-                // and validated when the function is registered
-                semver::Version::parse(&function.version).unwrap_or_else(|_| {
-                    let mut v = semver::Version::new(0, 0, 1);
-                    v.pre
-                        .push(semver::Identifier::AlphaNumeric(String::from("invalid")));
-                    v
-                }),
-                function,
-            )
-        })
-        .collect::<Vec<(semver::Version, Function)>>();
-
-        // redo sorting, offset and limit since we do not know
-        // anything about the relational ordering between different
-        // registries
-        let order = filters.order.unwrap_or(Ordering {
+        let order = filters.order.clone().unwrap_or(Ordering {
             key: OrderingKey::NameVersion as i32,
             reverse: false,
             offset: 0,
             limit: 100,
         });
+
+        // a cached function only stands in for the external registries, the
+        // internal registry is always asked so that conflicts with it are found
+        let cached = match list_function {
+            ListFunction::Versions => self.cached_exact_version(&filters, &order),
+            ListFunction::Functions => None,
+        };
+
+        // The offset is applied to the merged functions so every registry needs to
+        // return enough functions to fill the page on its own. Continuation tokens
+        // are positions in the ordering and are passed on as is.
+        let forwarded_filters = Filters {
+            order: Some(Ordering {
+                offset: 0,
+                limit: order.offset.saturating_add(order.limit),
+                ..order.clone()
+            }),
+            ..filters
+        };
+        let after = ContinuationToken::decode(&forwarded_filters.continuation_token)
+            .map_err(|e| tonic::Status::invalid_argument(e.to_string()))?
+            .map(|token| {
+                semver::Version::parse(&token.version)
+                    .map(|version| (token.name, version))
+                    .map_err(|e| {
+                        tonic::Status::invalid_argument(format!(
+                            "Invalid version in continuation token: {}",
+                            e
+                        ))
+                    })
+            })
+            .transpose()?;
+
+        // all registries are asked at the same time so a listing takes as long as the
+        // slowest registry, which is bounded by the timeout
+        let (remote_results, internal_functions) = futures::join!(
+            async {
+                match cached {
+                    Some(function) => vec![Ok((
+                        registry_name(&function),
+                        Response::new(Functions {
+                            functions: vec![function],
+                            continuation_token: String::new(),
+                        }),
+                    ))],
+                    None => {
+                        future::join_all(self.connections.iter().map(|connection| {
+                            let filters = &forwarded_filters;
+                            async move {
+                                self.list_remote(connection, *list_function, filters)
+                                    .await
+                                    .map(|functions| {
+                                        (connection.name.clone(), Response::new(functions))
+                                    })
+                                    .map_err(|e| (connection.name.clone(), e))
+                            }
+                        }))
+                        .await
+                    }
+                }
+            },
+            self.internal_registry
+                .list(tonic::Request::new(forwarded_filters.clone()))
+        );
+
+        let mut degraded_registries = Vec::new();
+        let mut functions = remote_results
+            .into_iter()
+            .filter_map(|result| {
+                result
+                    .map_err(|(name, e)| {
+                        warn!(
+                            self.log,
+                            "Leaving registry \"{}\" out of listing: {}", name, e
+                        );
+                        degraded_registries.push(name);
+                    })
+                    .ok()
+            })
+            .chain(std::iter::once((
+                String::from("internal"),
+                internal_functions?,
+            )))
+            .map(|(name, mut functions)| {
+                // insert registry into metadata
+                functions
+                    .get_mut()
+                    .functions
+                    .iter_mut()
+                    .for_each(|function| {
+                        function
+                            .metadata
+                            .insert("registry".to_owned(), name.clone());
+                    });
+
+                functions
+            })
+            .flat_map(|functions| functions.into_inner().functions)
+            .try_fold(HashMap::new(), |map, func| insert_function(self, map, func))
+            .map_err(|e| tonic::Status::already_exists(e.to_string()))?
+            .into_values()
+            .map(|function| {
+                (
+                    // The version is only used for sorting so if something is wrong with it,
+                    // jus sort it last. This error is also very unlikely since the version is parsed
+                    // and validated when the function is registered
+                    semver::Version::parse(&function.version).unwrap_or_else(|_| {
+                        let mut v = semver::Version::new(0, 0, 1);
+                        v.pre
+                            .push(semver::Identifier::AlphaNumeric(String::from("invalid")));
+                        v
+                    }),
+                    function,
+                )
+            })
+            .collect::<Vec<(semver::Version, Function)>>();
+
+        // redo sorting, offset and limit since we do not know
+        // anything about the relational ordering between different
+        // registries
         let offset: usize = order.offset as usize;
         let limit: usize = order.limit as usize;
 
@@ -364,35 +599,75 @@ impl ProxyRegistry {
             );
         }
 
+        let compare =
+            |a: (&str, &semver::Version), b: (&str, &semver::Version)| match OrderingKey::from_i32(
+                order.key,
+            ) {
+                Some(OrderingKey::NameVersion) | None => match a.0.cmp(b.0) {
+                    std::cmp::Ordering::Equal => b.1.cmp(a.1),
+                    o => o,
+                },
+            };
         functions.sort_unstable_by(|(a_semver, a_function), (b_semver, b_function)| {
-            match OrderingKey::from_i32(order.key) {
-                Some(OrderingKey::NameVersion) | None => {
-                    match a_function.name.cmp(&b_function.name) {
-                        std::cmp::Ordering::Equal => b_semver.cmp(a_semver),
-                        o => o,
+            compare(
+                (a_function.name.as_str(), a_semver),
+                (b_function.name.as_str(), b_semver),
+            )
+        });
+
+        // registries are expected to only return functions after the continuation
+        // point but do not trust them to
+        let is_after = |(version, function): &(semver::Version, Function)| {
+            after.as_ref().map_or(true, |(name, after_version)| {
+                let position = match list_function {
+                    // listings grouped by name continue after the name, the version in
+                    // the token is only the latest version that one registry had of it
+                    ListFunction::Functions => function.name.as_str().cmp(name.as_str()),
+                    ListFunction::Versions => compare(
+                        (function.name.as_str(), version),
+                        (name.as_str(), after_version),
+                    ),
+                };
+
+                position
+                    == if order.reverse {
+                        std::cmp::Ordering::Less
+                    } else {
+                        std::cmp::Ordering::Greater
                     }
-                }
-            }
+            })
+        };
+
+        let functions = if order.reverse {
+            functions
+                .into_iter()
+                .rev()
+                .filter(is_after)
+                .map(|(_version, function)| function)
+                .skip(offset)
+                .take(limit)
+                .collect::<Vec<_>>()
+        } else {
+            functions
+                .into_iter()
+                .filter(is_after)
+                .map(|(_version, function)| function)
+                .skip(offset)
+                .take(limit)
+                .collect::<Vec<_>>()
+        };
+
+        functions
+            .iter()
+            .for_each(|function| self.cache_function(function));
+
+        let mut response = Response::new(Functions {
+            continuation_token: ContinuationToken::next_page(&functions, limit),
+            functions,
         });
+        self.set_degraded_registries(response.metadata_mut(), &degraded_registries);
 
-        Ok(Functions {
-            functions: if order.reverse {
-                functions
-                    .into_iter()
-                    .map(|(_version, function)| function)
-                    .rev()
-                    .skip(offset)
-                    .take(limit)
-                    .collect::<Vec<_>>()
-            } else {
-                functions
-                    .into_iter()
-                    .map(|(_version, function)| function)
-                    .skip(offset)
-                    .take(limit)
-                    .collect::<Vec<_>>()
-            },
-        })
+        Ok(response)
     }
 }
 
@@ -403,18 +678,14 @@ impl ProxyRegistry {
 #[tonic::async_trait]
 impl Registry for ProxyRegistry {
     async fn list(&self, request: Request<Filters>) -> Result<Response<Functions>, Status> {
-        ProxyRegistry::list(self, request.into_inner(), &ListFunction::Functions)
-            .await
-            .map(tonic::Response::new)
+        ProxyRegistry::list(self, request.into_inner(), &ListFunction::Functions).await
     }
 
     async fn list_versions(
         &self,
         request: Request<Filters>,
     ) -> Result<Response<Functions>, Status> {
-        ProxyRegistry::list(self, request.into_inner(), &ListFunction::Versions)
-            .await
-            .map(Response::new)
+        ProxyRegistry::list(self, request.into_inner(), &ListFunction::Versions).await
     }
 
     async fn get(
@@ -423,74 +694,110 @@ impl Registry for ProxyRegistry {
     ) -> Result<Response<Function>, Status> {
         let payload = request.into_inner();
 
-        let res = stream::iter(
-            self.connections
-                .iter()
-                .map(|client| (client.clone(), payload.clone())),
-        )
-        .then(|(mut connection, payload)| async move {
-            connection
-                .client
-                .get(Request::new(payload))
-                .await
-                .map(|functions| (connection.name.clone(), functions))
-        })
-        .chain(
-            stream::once(self.internal_registry.get(Request::new(payload.clone())))
-                .map(|f| f.map(|functions| (String::from("internal"), functions))),
-        )
-        .collect::<Vec<Result<(String, Response<Function>), Status>>>()
-        .await
-        .into_iter()
-        .filter(|v| !matches!(v, Err(e) if e.code() == Code::NotFound))
-        .collect::<Result<Vec<(String, Response<Function>)>, Status>>()?
-        .into_iter()
-        .map(|(registry_name, response)| {
-            let mut r = response.into_inner();
-            r.metadata.insert("registry".to_owned(), registry_name);
-            r
-        })
-        .try_fold(
-            HashMap::new(),
-            |mut hashmap: HashMap<String, Function>, function| match hashmap
-                .entry(format!("{}:{}", function.name, function.version))
-            {
-                Entry::Occupied(existing) => match self.conflict_resolution {
-                    ConflictResolutionMethod::Error => {
-                        Err(ProxyRegistryError::ConflictingFunctions(
-                            existing.key().clone(),
-                            function
-                                .metadata
-                                .get("registry")
-                                .unwrap_or(&String::from("unknown"))
-                                .to_owned(),
-                            existing
-                                .get()
-                                .metadata
-                                .get("registry")
-                                .unwrap_or(&String::from("unknown"))
-                                .to_owned(),
-                        ))
+        // a cached function only stands in for the external registries, the
+        // internal registry is always asked so that conflicts with it are found
+        let cached = semver::Version::parse(&payload.version)
+            .ok()
+            .and_then(|version| self.cache.get_function(&payload.name, &version));
+
+        // all registries are asked at the same time, external registries that
+        // fail or do not respond in time are left out
+        let (external_results, internal_result) = futures::join!(
+            async {
+                match cached {
+                    Some(function) => vec![Ok((registry_name(&function), Response::new(function)))],
+                    None => {
+                        future::join_all(self.connections.iter().map(|connection| {
+                            let mut client = connection.client.clone();
+                            let payload = payload.clone();
+                            async move {
+                                within_timeout(
+                                    &connection.name,
+                                    connection.timeout,
+                                    client.get(Request::new(payload)),
+                                )
+                                .await
+                                .map(|function| (connection.name.clone(), function))
+                                .map_err(|e| (connection.name.clone(), e))
+                            }
+                        }))
+                        .await
                     }
-                    ConflictResolutionMethod::UsePriority => Ok(hashmap),
-                },
-                Entry::Vacant(vacant) => {
-                    vacant.insert(function);
-                    Ok(hashmap)
                 }
             },
-        )
-        .map_err(|e| Status::already_exists(e.to_string()))?
-        .into_iter()
-        .map(|(_, v)| v)
-        .next()
-        .ok_or_else(|| {
-            tonic::Status::not_found(format!(
-                "Failed to find function with name: \"{}\" and version \"{}\"",
-                payload.name, payload.version
+            self.internal_registry.get(Request::new(payload.clone()))
+        );
+
+        let mut degraded_registries = Vec::new();
+        let res = external_results
+            .into_iter()
+            .filter_map(|result| match result {
+                Ok(found) => Some(Ok(found)),
+                Err((_, e)) if e.code() == Code::NotFound => None,
+                Err((name, e)) => {
+                    warn!(self.log, "Leaving registry \"{}\" out of get: {}", name, e);
+                    degraded_registries.push(name);
+                    None
+                }
+            })
+            .chain(std::iter::once(
+                internal_result.map(|function| (String::from("internal"), function)),
             ))
-        })?; // We've already handled the case where we find several. First should be safe to call.
-        Ok(tonic::Response::new(res))
+            .filter(|v| !matches!(v, Err(e) if e.code() == Code::NotFound))
+            .collect::<Result<Vec<(String, Response<Function>)>, Status>>()?
+            .into_iter()
+            .map(|(registry_name, response)| {
+                let mut r = response.into_inner();
+                r.metadata.insert("registry".to_owned(), registry_name);
+                r
+            })
+            .try_fold(
+                HashMap::new(),
+                |mut hashmap: HashMap<String, Function>, function| match hashmap
+                    .entry(format!("{}:{}", function.name, function.version))
+                {
+                    Entry::Occupied(existing) => match self.conflict_resolution {
+                        ConflictResolutionMethod::Error => {
+                            Err(ProxyRegistryError::ConflictingFunctions(
+                                existing.key().clone(),
+                                function
+                                    .metadata
+                                    .get("registry")
+                                    .unwrap_or(&String::from("unknown"))
+                                    .to_owned(),
+                                existing
+                                    .get()
+                                    .metadata
+                                    .get("registry")
+                                    .unwrap_or(&String::from("unknown"))
+                                    .to_owned(),
+                            ))
+                        }
+                        ConflictResolutionMethod::UsePriority => Ok(hashmap),
+                    },
+                    Entry::Vacant(vacant) => {
+                        vacant.insert(function);
+                        Ok(hashmap)
+                    }
+                },
+            )
+            .map_err(|e| Status::already_exists(e.to_string()))?
+            .into_iter()
+            .map(|(_, v)| v)
+            .next()
+            .ok_or_else(|| {
+                let mut status = tonic::Status::not_found(format!(
+                    "Failed to find function with name: \"{}\" and version \"{}\"",
+                    payload.name, payload.version
+                ));
+                self.set_degraded_registries(status.metadata_mut(), &degraded_registries);
+                status
+            })?; // We've already handled the case where we find several. First should be safe to call.
+        self.cache_function(&res);
+
+        let mut response = tonic::Response::new(res);
+        self.set_degraded_registries(response.metadata_mut(), &degraded_registries);
+        Ok(response)
     }
 
     async fn register(
@@ -500,6 +807,13 @@ impl Registry for ProxyRegistry {
         self.internal_registry.register(request).await
     }
 
+    async fn register_batch(
+        &self,
+        request: Request<firm_types::functions::FunctionDataBatch>,
+    ) -> Result<Response<Functions>, Status> {
+        self.internal_registry.register_batch(request).await
+    }
+
     async fn register_attachment(
         &self,
         request: Request<AttachmentData>,
@@ -516,3 +830,103 @@ impl Registry for ProxyRegistry {
             .await
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use std::time::Instant;
+
+    use firm_types::{filters, function_data, functions::FunctionId, runtime_spec};
+
+    use crate::config::InternalRegistryConfig;
+
+    macro_rules! null_logger {
+        () => {{
+            slog::Logger::root(slog::Discard, slog::o!())
+        }};
+    }
+
+    /// Registry that accepts connections but never responds
+    async fn silent_registry() -> ExternalRegistry {
+        let listener = tokio::net::TcpListener::bind("127.0.0.1:0").await.unwrap();
+        let url = Url::parse(&format!("http://{}", listener.local_addr().unwrap())).unwrap();
+        tokio::spawn(async move {
+            let mut connections = Vec::new();
+            while let Ok((connection, _)) = listener.accept().await {
+                connections.push(connection);
+            }
+        });
+
+        ExternalRegistry::new(String::from("silent"), url).with_timeout(Duration::from_millis(500))
+    }
+
+    #[tokio::test(flavor = "multi_thread")]
+    async fn silent_registries_are_left_out() {
+        let internal_registry =
+            RegistryService::new(InternalRegistryConfig::default(), null_logger!()).unwrap();
+        Registry::register(
+            &internal_registry,
+            Request::new(function_data!("sune", "1.0.0")),
+        )
+        .await
+        .unwrap();
+
+        let proxy = ProxyRegistry::new(
+            vec![silent_registry().await],
+            internal_registry,
+            ConflictResolutionMethod::Error,
+            AuthService::default(),
+            null_logger!(),
+        )
+        .await
+        .unwrap();
+
+        let degraded = |metadata: &MetadataMap| {
+            metadata
+                .get(DEGRADED_REGISTRIES_METADATA_KEY)
+                .and_then(|value| value.to_str().ok())
+                .map(String::from)
+        };
+
+        let started = Instant::now();
+        let response = Registry::list(&proxy, Request::new(filters!("sune")))
+            .await
+            .unwrap();
+        assert!(
+            started.elapsed() < Duration::from_secs(5),
+            "Silent registries must not hold up listings longer than their timeout"
+        );
+        assert_eq!(degraded(response.metadata()), Some(String::from("silent")));
+        assert_eq!(response.into_inner().functions.len(), 1);
+
+        let started = Instant::now();
+        let response = Registry::get(
+            &proxy,
+            Request::new(FunctionId {
+                name: String::from("sune"),
+                version: String::from("1.0.0"),
+            }),
+        )
+        .await
+        .unwrap();
+        assert!(
+            started.elapsed() < Duration::from_secs(5),
+            "Silent registries must not hold up getting a function longer than their timeout"
+        );
+        assert_eq!(degraded(response.metadata()), Some(String::from("silent")));
+        assert_eq!(response.into_inner().name, "sune");
+
+        let status = Registry::get(
+            &proxy,
+            Request::new(FunctionId {
+                name: String::from("rune"),
+                version: String::from("1.0.0"),
+            }),
+        )
+        .await
+        .unwrap_err();
+        assert_eq!(status.code(), Code::NotFound);
+        assert_eq!(degraded(status.metadata()), Some(String::from("silent")));
+    }
+}
@@ -0,0 +1,266 @@
+//! Cache of responses from external registries
+use std::time::{Duration, Instant};
+
+use firm_types::{
+    cache::{listing_query, BoundedCache},
+    functions::{Filters, Function, Functions},
+};
+
+use super::ListFunction;
+
+/// Max number of listings to keep in the cache
+const MAX_LISTINGS: usize = 1_000;
+
+/// Max number of function versions to keep in the cache
+const MAX_FUNCTIONS: usize = 10_000;
+
+/// How long a listing is used without asking the registry again
+const LISTING_TTL: Duration = Duration::from_secs(30);
+
+/// How long a listing that is older than `LISTING_TTL` is still
+/// used while it is refreshed in the background
+const LISTING_MAX_STALE: Duration = Duration::from_secs(10 * 60);
+
+/// A listing call to one registry
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+pub struct ListingKey {
+    registry: String,
+    list_function: ListFunction,
+    name: String,
+    query: String,
+}
+
+impl ListingKey {
+    pub fn new(registry: &str, list_function: ListFunction, filters: &Filters) -> Self {
+        Self {
+            registry: registry.to_owned(),
+            list_function,
+            name: filters.name.clone(),
+            query: listing_query(filters),
+        }
+    }
+}
+
+#[derive(Debug)]
+struct Listing {
+    fetched_at: Instant,
+    functions: Functions,
+    refreshing: bool,
+}
+
+/// Result of looking up a listing in the cache
+#[derive(Debug, PartialEq)]
+pub enum CachedListing {
+    Fresh(Functions),
+
+    /// The listing is out of date but still usable, `refresh` is set
+    /// for exactly one caller until the listing has been refreshed
+    Stale {
+        functions: Functions,
+        refresh: bool,
+    },
+
+    Missing,
+}
+
+/// TTL and size bounded cache of external registry responses
+///
+/// Listings are kept per registry and filters. Function versions never change once
+/// they have been published so these are kept until evicted to make room for others.
+#[derive(Debug)]
+pub struct ResponseCache {
+    listings: BoundedCache<ListingKey, Listing>,
+    functions: BoundedCache<(String, semver::Version), Function>,
+    listing_ttl: Duration,
+    listing_max_stale: Duration,
+}
+
+impl Default for ResponseCache {
+    fn default() -> Self {
+        Self::new(MAX_LISTINGS, MAX_FUNCTIONS, LISTING_TTL, LISTING_MAX_STALE)
+    }
+}
+
+impl ResponseCache {
+    fn new(
+        max_listings: usize,
+        max_functions: usize,
+        listing_ttl: Duration,
+        listing_max_stale: Duration,
+    ) -> Self {
+        Self {
+            listings: BoundedCache::new(max_listings),
+            functions: BoundedCache::new(max_functions),
+            listing_ttl,
+            listing_max_stale,
+        }
+    }
+
+    pub fn get_listing(&self, key: &ListingKey) -> CachedListing {
+        self.listings
+            .modify(key, |listing| {
+                let age = listing.fetched_at.elapsed();
+                if age < self.listing_ttl {
+                    Some(CachedListing::Fresh(listing.functions.clone()))
+                } else if age < self.listing_ttl + self.listing_max_stale {
+                    let refresh = !listing.refreshing;
+                    listing.refreshing = true;
+                    Some(CachedListing::Stale {
+                        functions: listing.functions.clone(),
+                        refresh,
+                    })
+                } else {
+                    None
+                }
+            })
+            .flatten()
+            .unwrap_or(CachedListing::Missing)
+    }
+
+    pub fn insert_listing(&self, key: ListingKey, functions: &Functions) {
+        self.listings.insert(
+            key,
+            Listing {
+                fetched_at: Instant::now(),
+                functions: functions.clone(),
+                refreshing: false,
+            },
+        );
+    }
+
+    /// Let the next caller that gets the stale listing for `key` try to refresh it
+    pub fn refresh_failed(&self, key: &ListingKey) {
+        self.listings
+            .modify(key, |listing| listing.refreshing = false);
+    }
+
+    pub fn get_function(&self, name: &str, version: &semver::Version) -> Option<Function> {
+        self.functions.get(&(name.to_owned(), version.clone()))
+    }
+
+    pub fn insert_function(&self, function: &Function) {
+        if let Ok(version) = semver::Version::parse(&function.version) {
+            self.functions
+                .insert((function.name.clone(), version), function.clone());
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use firm_types::filters;
+
+    fn listing(name: &str, version: &str) -> Functions {
+        Functions {
+            functions: vec![Function {
+                name: name.to_owned(),
+                version: version.to_owned(),
+                ..Default::default()
+            }],
+            ..Default::default()
+        }
+    }
+
+    #[test]
+    fn listings() {
+        let cache = ResponseCache::default();
+        let key = ListingKey::new("registry", ListFunction::Versions, &filters!("sune"));
+        assert_eq!(cache.get_listing(&key), CachedListing::Missing);
+
+        cache.insert_listing(key.clone(), &listing("sune", "1.0.0"));
+        assert_eq!(
+            cache.get_listing(&key),
+            CachedListing::Fresh(listing("sune", "1.0.0"))
+        );
+
+        // same filters are different listings in other registries and for other calls
+        assert_eq!(
+            cache.get_listing(&ListingKey::new(
+                "other-registry",
+                ListFunction::Versions,
+                &filters!("sune")
+            )),
+            CachedListing::Missing
+        );
+        assert_eq!(
+            cache.get_listing(&ListingKey::new(
+                "registry",
+                ListFunction::Functions,
+                &filters!("sune")
+            )),
+            CachedListing::Missing
+        );
+        assert_eq!(
+            cache.get_listing(&ListingKey::new(
+                "registry",
+                ListFunction::Versions,
+                &filters!("sune", {"a" => "b"})
+            )),
+            CachedListing::Missing
+        );
+    }
+
+    #[test]
+    fn stale_listings() {
+        let cache = ResponseCache::new(
+            10,
+            10,
+            Duration::from_millis(10),
+            Duration::from_millis(100),
+        );
+        let key = ListingKey::new("registry", ListFunction::Versions, &filters!("sune"));
+        cache.insert_listing(key.clone(), &listing("sune", "1.0.0"));
+        std::thread::sleep(Duration::from_millis(20));
+
+        assert_eq!(
+            cache.get_listing(&key),
+            CachedListing::Stale {
+                functions: listing("sune", "1.0.0"),
+                refresh: true
+            }
+        );
+        assert_eq!(
+            cache.get_listing(&key),
+            CachedListing::Stale {
+                functions: listing("sune", "1.0.0"),
+                refresh: false
+            },
+            "Only one caller must refresh a stale listing"
+        );
+
+        cache.refresh_failed(&key);
+        assert!(matches!(
+            cache.get_listing(&key),
+            CachedListing::Stale { refresh: true, .. }
+        ));
+
+        cache.insert_listing(key.clone(), &listing("sune", "1.1.0"));
+        assert_eq!(
+            cache.get_listing(&key),
+            CachedListing::Fresh(listing("sune", "1.1.0"))
+        );
+
+        std::thread::sleep(Duration::from_millis(120));
+        assert_eq!(
+            cache.get_listing(&key),
+            CachedListing::Missing,
+            "Listings that are too old must not be used at all"
+        );
+    }
+
+    #[test]
+    fn function_versions() {
+        let cache = ResponseCache::default();
+        let version = semver::Version::parse("1.0.0").unwrap();
+        assert!(cache.get_function("sune", &version).is_none());
+
+        let sune = listing("sune", "1.0.0").functions.remove(0);
+        cache.insert_function(&sune);
+        assert_eq!(cache.get_function("sune", &version), Some(sune));
+        assert!(cache
+            .get_function("sune", &semver::Version::parse("1.0.1").unwrap())
+            .is_none());
+    }
+}
@@ -1,7 +1,8 @@
 use std::{
-    collections::{hash_map::Entry, HashMap},
+    collections::{BTreeMap, HashMap, HashSet},
     fs,
     io::Write,
+    ops::Bound,
     path::PathBuf,
     sync::{Arc, RwLock},
 };
@@ -20,15 +21,23 @@ use firm_types::{
     functions::{
         registry_server::Registry, Attachment, AttachmentData, AttachmentHandle, AttachmentId,
         AttachmentStreamUpload, AttachmentUrl, AuthMethod, ChannelSpec, Filters,
-        Function as ProtoFunction, FunctionData, FunctionId, Functions, Ordering, OrderingKey,
-        Publisher as ProtoPublisher, RuntimeSpec, Signature,
+        Function as ProtoFunction, FunctionData, FunctionDataBatch, FunctionId, Functions,
+        Ordering, OrderingKey, Publisher as ProtoPublisher, RuntimeSpec, Signature,
     },
+    pagination::ContinuationToken,
     tonic,
 };
 
+/// Registered functions by name and then version
+///
+/// Both levels are ordered so listings can be produced in order without sorting,
+/// and looking up a name, its latest version or where a continuation token
+/// points does not require looking at every registered function.
+type FunctionIndex = BTreeMap<String, BTreeMap<Version, Function>>;
+
 #[derive(Debug, Clone)]
 pub struct RegistryService {
-    functions: Arc<RwLock<Vec<Function>>>,
+    functions: Arc<RwLock<FunctionIndex>>,
     function_attachments: Arc<RwLock<HashMap<Uuid, Attachment>>>,
     config: InternalRegistryConfig,
     logger: Logger,
@@ -60,7 +69,7 @@ struct Function {
 impl RegistryService {
     pub fn new(config: InternalRegistryConfig, logger: Logger) -> Result<Self, std::io::Error> {
         Ok(Self {
-            functions: Arc::new(RwLock::new(Vec::new())),
+            functions: Arc::new(RwLock::new(BTreeMap::new())),
             function_attachments: Arc::new(RwLock::new(HashMap::new())),
             config,
             logger,
@@ -261,6 +270,135 @@ impl RegistryService {
         })
     }
 
+    /// Validate `payload` and turn it into a function to register
+    fn function_from_data(&self, mut payload: FunctionData) -> Result<Function, tonic::Status> {
+        validate_name(&payload.name).map_err(|e| {
+            tonic::Status::new(
+                tonic::Code::InvalidArgument,
+                format!("Invalid function name \"{}\": {}", payload.name, e),
+            )
+        })?;
+
+        let mut version = validate_version(&payload.version).map_err(|e| {
+            tonic::Status::new(
+                tonic::Code::InvalidArgument,
+                format!("Invalid function version \"{}\": {}", payload.version, e),
+            )
+        })?;
+
+        // this is the local case, always add dev to any function version
+        if !self.config.version_suffix.is_empty() {
+            version.pre.push(semver::Identifier::AlphaNumeric(
+                self.config.version_suffix.clone(),
+            ));
+        }
+
+        let runtime = payload.runtime.ok_or_else(|| {
+            tonic::Status::new(
+                tonic::Code::InvalidArgument,
+                String::from("Runtime is required when registering function"),
+            )
+        })?;
+
+        // validate attachments
+        let combined_checksum = payload
+            .attachment_ids
+            .iter()
+            .chain(payload.code_attachment_id.iter())
+            .fold(Ok(Sha256::new()), |r, id| {
+                match (r, self.get_attachment(id)) {
+                    (Ok(mut cs), Ok(a)) => {
+                        cs.update(a.checksums.unwrap_or_default().sha256);
+                        Ok(cs)
+                    }
+                    (Ok(_), Err(e)) => Err(format!("{} ({})", id.uuid, e.message())),
+                    (Err(e), Ok(_)) => Err(e),
+                    (Err(e1), Err(e2)) => Err(format!("{}, {} ({})", e1, id.uuid, e2.message())),
+                }
+            })
+            .map_err(|msg| {
+                tonic::Status::new(
+                    tonic::Code::InvalidArgument,
+                    format!("Failed to get attachment for ids: [{}]", msg),
+                )
+            })?;
+
+        payload.metadata.insert(
+            String::from("_dev-checksum"),
+            format!("{:x}", combined_checksum.finalize()),
+        );
+
+        let publisher = payload
+            .publisher
+            .ok_or_else(|| {
+                tonic::Status::invalid_argument("Publisher is required when registering function")
+            })
+            .and_then(|publisher| match publisher {
+                ProtoPublisher { ref name, .. } if name.is_empty() => {
+                    Err(tonic::Status::invalid_argument(
+                        "Publisher name is required when registering a function",
+                    ))
+                }
+                ProtoPublisher { ref email, .. } if email.is_empty() => {
+                    Err(tonic::Status::invalid_argument(
+                        "Publisher email is required when registering a function",
+                    ))
+                }
+                p => Ok(Publisher {
+                    name: p.name,
+                    email: p.email,
+                }),
+            })?;
+
+        Ok(Function {
+            name: payload.name,
+            version,
+            runtime,
+            metadata: payload.metadata,
+            required_inputs: payload.required_inputs,
+            optional_inputs: payload.optional_inputs,
+            outputs: payload.outputs,
+            code: payload.code_attachment_id,
+            attachments: payload.attachment_ids,
+            created_at: std::time::SystemTime::now()
+                .duration_since(std::time::UNIX_EPOCH)
+                .map(|d| d.as_secs())
+                .unwrap_or_default(),
+            publisher,
+            signature: payload.signature.map(|sig| sig.signature),
+        })
+    }
+
+    /// Register all of `functions`, replacing any functions with the same name and version
+    fn insert_functions(
+        &self,
+        functions: Vec<Function>,
+    ) -> Result<Vec<ProtoFunction>, tonic::Status> {
+        // resolve before inserting anything so that all or none of them are registered
+        let proto_functions = functions
+            .iter()
+            .map(|function| self.get_function(function))
+            .collect::<Result<Vec<_>, _>>()?;
+
+        let mut index = self.functions.write().map_err(|e| {
+            tonic::Status::new(
+                tonic::Code::Internal,
+                format!("Failed to get write lock for functions: {}", e),
+            )
+        })?;
+
+        // replaces any function with the same name and version (after the suffix has been appended)
+        // TODO: Remove corresponding attachments
+        functions.into_iter().for_each(|function| {
+            index
+                .entry(function.name.clone())
+                .or_default()
+                .insert(function.version.clone(), function);
+        });
+
+        Ok(proto_functions)
+    }
+
     fn list(&self, filters: Filters, group_by_version: bool) -> Result<Functions, tonic::Status> {
         let reader = self.functions.read().map_err(|e| {
             tonic::Status::new(
@@ -286,6 +424,19 @@ impl RegistryService {
 
         let offset: usize = order.offset as usize;
         let limit: usize = order.limit as usize;
+        let after = ContinuationToken::decode(&filters.continuation_token)
+            .map_err(|e| tonic::Status::invalid_argument(e.to_string()))?
+            .map(|token| {
+                Version::parse(&token.version)
+                    .map(|version| (token.name, version))
+                    .map_err(|e| {
+                        tonic::Status::invalid_argument(format!(
+                            "Invalid version in continuation token: {}",
+                            e
+                        ))
+                    })
+            })
+            .transpose()?;
         let version_req = filters
             .version_requirement
             .map(|vr| {
@@ -297,11 +448,8 @@ impl RegistryService {
                 })
             })
             .map_or(Ok(None), |v| v.map(Some))?;
-        let filtered_functions = reader.iter().filter(|func| {
-            (match group_by_version {
-                false => func.name == name_filter,
-                true => func.name.contains(&name_filter),
-            }) && version_req.as_ref().map_or(true, |ver_req| {
+        let matches_version = |func: &&Function| {
+            version_req.as_ref().map_or(true, |ver_req| {
                 let res = ver_req.matches(&func.version);
                 debug!(
                     self.logger,
@@ -309,31 +457,76 @@ impl RegistryService {
                 );
                 res
             })
-        });
-        let mut filtered_functions = (if group_by_version {
+        };
+
+        if OrderingKey::from_i32(order.key).is_none() {
+            warn!(
+                self.logger,
+                "Ordering key was out of range ({}). Out of date protobuf definitions?", order.key
+            );
+        }
+
+        // the index is ordered like this so iterating it gives the functions in order
+        let compare =
+            |a: (&str, &Version), b: (&str, &Version)| match OrderingKey::from_i32(order.key) {
+                Some(OrderingKey::NameVersion) | None => match a.0.cmp(b.0) {
+                    std::cmp::Ordering::Equal => b.1.cmp(a.1),
+                    o => o,
+                },
+            };
+
+        // skip everything up to and including the function to continue after
+        let is_after = |f: &&Function| {
+            after.as_ref().map_or(true, |(name, version)| {
+                let position = if group_by_version {
+                    // a newer version might have been registered since the last page
+                    // so only the name says where a grouped listing continues
+                    f.name.as_str().cmp(name.as_str())
+                } else {
+                    compare((f.name.as_str(), &f.version), (name.as_str(), version))
+                };
+
+                position
+                    == if order.reverse {
+                        std::cmp::Ordering::Less
+                    } else {
+                        std::cmp::Ordering::Greater
+                    }
+            })
+        };
+
+        let names = if group_by_version {
+            // no need to look at names before the one to continue after
+            let name_range = match (&after, order.reverse) {
+                (Some((name, _)), false) => (Bound::Included(name.as_str()), Bound::Unbounded),
+                (Some((name, _)), true) => (Bound::Unbounded, Bound::Included(name.as_str())),
+                (None, _) => (Bound::Unbounded, Bound::Unbounded),
+            };
             Either::Left(
-                filtered_functions
-                    .fold(
-                        HashMap::new(),
-                        |mut map: HashMap<String, &Function>, function| match map
-                            .entry(function.name.clone())
-                        {
-                            Entry::Occupied(mut entry) => {
-                                if entry.get().version < function.version {
-                                    entry.insert(function);
-                                }
-                                map
-                            }
-                            Entry::Vacant(entry) => {
-                                entry.insert(function);
-                                map
-                            }
-                        },
-                    )
-                    .into_values(),
+                reader
+                    .range::<str, _>(name_range)
+                    .filter(|(name, _)| name.contains(&name_filter)),
             )
         } else {
-            Either::Right(filtered_functions)
+            Either::Right(reader.get_key_value(name_filter.as_str()).into_iter())
+        };
+
+        let functions = (if order.reverse {
+            Either::Left(names.rev())
+        } else {
+            Either::Right(names)
+        })
+        .flat_map(|(_, versions)| {
+            if group_by_version {
+                // latest matching version only
+                Either::Left(versions.values().rev().find(matches_version).into_iter())
+            } else if order.reverse {
+                Either::Right(Either::Left(versions.values().filter(matches_version)))
+            } else {
+                Either::Right(Either::Right(
+                    versions.values().rev().filter(matches_version),
+                ))
+            }
         })
         .filter(|func| {
             required_metadata.as_ref().map_or(true, |filters| {
@@ -344,39 +537,15 @@ impl RegistryService {
                 })
             }) && func.publisher.email.contains(&filters.publisher_email)
         })
-        .collect::<Vec<&Function>>();
-
-        if OrderingKey::from_i32(order.key).is_none() {
-            warn!(
-                self.logger,
-                "Ordering key was out of range ({}). Out of date protobuf definitions?", order.key
-            );
-        }
-
-        filtered_functions.sort_unstable_by(|a, b| match OrderingKey::from_i32(order.key) {
-            Some(OrderingKey::NameVersion) | None => match a.name.cmp(&b.name) {
-                std::cmp::Ordering::Equal => b.version.cmp(&a.version),
-                o => o,
-            },
-        });
+        .filter(is_after)
+        .skip(offset)
+        .take(limit)
+        .filter_map(|f| self.get_function(f).ok())
+        .collect::<Vec<_>>();
 
         Ok(Functions {
-            functions: if order.reverse {
-                filtered_functions
-                    .iter()
-                    .rev()
-                    .skip(offset)
-                    .take(limit)
-                    .filter_map(|f| self.get_function(*f).ok())
-                    .collect::<Vec<_>>()
-            } else {
-                filtered_functions
-                    .iter()
-                    .skip(offset)
-                    .take(limit)
-                    .filter_map(|f| self.get_function(*f).ok())
-                    .collect::<Vec<_>>()
-            },
+            continuation_token: ContinuationToken::next_page(&functions, limit),
+            functions,
         })
     }
 }
@@ -413,9 +582,9 @@ impl Registry for RegistryService {
             })
             .and_then(|reader| {
                 reader
-                    .iter()
-                    .rev()
-                    .find(|f| f.name == fn_id.name && f.version.to_string() == fn_id.version)
+                    .get(&fn_id.name)
+                    .zip(Version::parse(&fn_id.version).ok())
+                    .and_then(|(versions, version)| versions.get(&version))
                     .ok_or_else(|| {
                         tonic::Status::new(
                             tonic::Code::NotFound,
@@ -434,118 +603,41 @@ impl Registry for RegistryService {
         &self,
         register_request: tonic::Request<FunctionData>,
     ) -> Result<tonic::Response<ProtoFunction>, tonic::Status> {
-        let mut payload = register_request.into_inner();
-
-        validate_name(&payload.name).map_err(|e| {
-            tonic::Status::new(
-                tonic::Code::InvalidArgument,
-                format!("Invalid function name \"{}\": {}", payload.name, e),
-            )
-        })?;
-
-        let mut version = validate_version(&payload.version).map_err(|e| {
-            tonic::Status::new(
-                tonic::Code::InvalidArgument,
-                format!("Invalid function version \"{}\": {}", payload.version, e),
-            )
-        })?;
-
-        // this is the local case, always add dev to any function version
-        if !self.config.version_suffix.is_empty() {
-            version.pre.push(semver::Identifier::AlphaNumeric(
-                self.config.version_suffix.clone(),
-            ));
-        }
-
-        let mut functions = self.functions.write().map_err(|e| {
-            tonic::Status::new(
-                tonic::Code::Internal,
-                format!("Failed to get write lock for functions: {}", e),
-            )
-        })?;
-
-        // remove function if name and version matches (after the suffix has been appended)
-        // TODO: Remove corresponding attachments
-        functions.retain(|v| v.name != payload.name || v.version != version);
+        let function = self.function_from_data(register_request.into_inner())?;
+        self.insert_functions(vec![function])
+            .map(|mut functions| tonic::Response::new(functions.remove(0)))
+    }
 
-        let runtime = payload.runtime.ok_or_else(|| {
-            tonic::Status::new(
-                tonic::Code::InvalidArgument,
-                String::from("Runtime is required when registering function"),
-            )
-        })?;
+    async fn register_batch(
+        &self,
+        register_request: tonic::Request<FunctionDataBatch>,
+    ) -> Result<tonic::Response<Functions>, tonic::Status> {
+        let functions = register_request
+            .into_inner()
+            .functions
+            .into_iter()
+            .map(|payload| self.function_from_data(payload))
+            .collect::<Result<Vec<_>, _>>()?;
 
-        // validate attachments
-        let combined_checksum = payload
-            .attachment_ids
+        // registering replaces existing versions, but within a
+        // batch it is not clear which one was meant to be kept
+        let mut seen = HashSet::new();
+        if let Some(duplicate) = functions
             .iter()
-            .chain(payload.code_attachment_id.iter())
-            .fold(Ok(Sha256::new()), |r, id| {
-                match (r, self.get_attachment(id)) {
-                    (Ok(mut cs), Ok(a)) => {
-                        cs.update(a.checksums.unwrap_or_default().sha256);
-                        Ok(cs)
-                    }
-                    (Ok(_), Err(e)) => Err(format!("{} ({})", id.uuid, e.message())),
-                    (Err(e), Ok(_)) => Err(e),
-                    (Err(e1), Err(e2)) => Err(format!("{}, {} ({})", e1, id.uuid, e2.message())),
-                }
-            })
-            .map_err(|msg| {
-                tonic::Status::new(
-                    tonic::Code::InvalidArgument,
-                    format!("Failed to get attachment for ids: [{}]", msg),
-                )
-            })?;
-
-        payload.metadata.insert(
-            String::from("_dev-checksum"),
-            format!("{:x}", combined_checksum.finalize()),
-        );
+            .find(|function| !seen.insert((&function.name, &function.version)))
+        {
+            return Err(tonic::Status::invalid_argument(format!(
+                "Function \"{}\" with version \"{}\" is in the batch more than once",
+                duplicate.name, duplicate.version
+            )));
+        }
 
-        let publisher = payload
-            .publisher
-            .ok_or_else(|| {
-                tonic::Status::invalid_argument("Publisher is required when registering function")
+        self.insert_functions(functions).map(|functions| {
+            tonic::Response::new(Functions {
+                functions,
+                continuation_token: String::new(),
             })
-            .and_then(|publisher| match publisher {
-                ProtoPublisher { ref name, .. } if name.is_empty() => {
-                    Err(tonic::Status::invalid_argument(
-                        "Publisher name is required when registering a function",
-                    ))
-                }
-                ProtoPublisher { ref email, .. } if email.is_empty() => {
-                    Err(tonic::Status::invalid_argument(
-                        "Publisher email is required when registering a function",
-                    ))
-                }
-                p => Ok(Publisher {
-                    name: p.name,
-                    email: p.email,
-                }),
-            })?;
-
-        let function = Function {
-            name: payload.name,
-            version,
-            runtime,
-            metadata: payload.metadata,
-            required_inputs: payload.required_inputs,
-            optional_inputs: payload.optional_inputs,
-            outputs: payload.outputs,
-            code: payload.code_attachment_id,
-            attachments: payload.attachment_ids,
-            created_at: std::time::SystemTime::now()
-                .duration_since(std::time::UNIX_EPOCH)
-                .map(|d| d.as_secs())
-                .unwrap_or_default(),
-            publisher,
-            signature: payload.signature.map(|sig| sig.signature),
-        };
-
-        functions.push(function.clone());
-
-        Ok(tonic::Response::new(self.get_function(&function)?))
+        })
     }
 
     async fn register_attachment(
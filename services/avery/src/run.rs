@@ -1,4 +1,4 @@
-use std::path::PathBuf;
+use std::{path::PathBuf, time::Duration};
 
 use firm_types::{
     auth::authentication_server::AuthenticationServer,
@@ -68,7 +68,10 @@ where
                         reg.name, e
                     )
                 })
-                .map(|url| ExternalRegistry::new(reg.name, url))
+                .map(|url| {
+                    ExternalRegistry::new(reg.name, url)
+                        .with_timeout(Duration::from_secs(reg.timeout))
+                })
         })
         .collect::<Result<Vec<ExternalRegistry>, String>>()?;
 
@@ -99,6 +102,8 @@ where
     )
     .await?;
 
+    runtime::wasi::set_max_warm_snapshots(config.max_warm_snapshots)?;
+
     let mut runtime_directories = config.runtime_directories.clone();
     runtime_directories.push(system::default_runtime_dir());
     let directory_sources = runtime_directories
@@ -108,6 +113,7 @@ where
                 Some(
                     runtime::filesystem_source::FileSystemSource::new(
                         &d,
+                        &config.compilers,
                         log.new(o!("source" => "fs")),
                     )
                     .map(|fss| Box::new(fss) as Box<dyn runtime::RuntimeSource>),
@@ -119,7 +125,8 @@ where
         .collect::<Result<Vec<_>, _>>()?;
 
     let mut runtime_sources: Vec<Box<dyn runtime::RuntimeSource>> = vec![Box::new(
-        runtime::InternalRuntimeSource::new(log.new(o!("source" => "internal"))),
+        runtime::InternalRuntimeSource::new(log.new(o!("source" => "internal")))
+            .with_compilers(config.compilers.clone()),
     )];
     runtime_sources.extend(directory_sources.into_iter());
 
@@ -5,6 +5,12 @@ use std::{
     collections::HashMap,
     fmt::Debug,
     path::{Path, PathBuf},
+    process::{Child, ExitStatus},
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc, Mutex,
+    },
+    time::Duration,
 };
 
 use firm_types::{
@@ -12,10 +18,11 @@ use firm_types::{
     stream::StreamExt,
 };
 use slog::{o, Logger};
-use tokio::runtime::Runtime as TokioRuntime;
+use tokio::{runtime::Runtime as TokioRuntime, sync::Notify};
 
 use crate::{
     auth::AuthService,
+    config::CompilerConfig,
     executor::{FunctionOutputSink, RuntimeError},
 };
 
@@ -29,10 +36,165 @@ pub struct RuntimeParameters {
     pub output_sink: FunctionOutputSink,
     pub auth_service: AuthService,
     pub async_runtime: TokioRuntime,
+    pub cancellation: CancellationToken,
+}
+
+/// Handle used to cancel a function execution
+///
+/// Cancelling sets a flag that runtimes check whenever the function calls
+/// into the host, interrupts the running function, kills all host processes
+/// started by the function and wakes up the task waiting for the execution
+/// to finish.
+#[derive(Debug, Clone, Default)]
+pub struct CancellationToken {
+    cancelled: Arc<AtomicBool>,
+    processes: Arc<Mutex<HashMap<u32, Child>>>,
+    interrupts: Arc<Mutex<Interrupts>>,
+    notify: Arc<Notify>,
+}
+
+/// Callbacks interrupting the running function on cancellation
+#[derive(Default)]
+struct Interrupts(Vec<Box<dyn Fn() + Send>>);
+
+impl Debug for Interrupts {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(f, "{} interrupts", self.0.len())
+    }
+}
+
+impl CancellationToken {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Cancel the execution, this is a no-op if it is already cancelled
+    pub fn cancel(&self) {
+        if !self.cancelled.swap(true, Ordering::SeqCst) {
+            if let Ok(interrupts) = self.interrupts.lock() {
+                interrupts.0.iter().for_each(|interrupt| interrupt());
+            }
+
+            if let Ok(mut processes) = self.processes.lock() {
+                processes.values_mut().for_each(|child| {
+                    let _ = child.kill();
+                });
+            }
+            self.notify.notify_one();
+        }
+    }
+
+    pub fn is_cancelled(&self) -> bool {
+        self.cancelled.load(Ordering::SeqCst)
+    }
+
+    /// Wait until the execution gets cancelled
+    pub async fn cancelled(&self) {
+        if !self.is_cancelled() {
+            self.notify.notified().await
+        }
+    }
+
+    /// Call `interrupt` on cancellation to stop the running function
+    ///
+    /// This is for runtimes that can stop a function wherever it is
+    /// executing. If the execution is already cancelled, `interrupt` is
+    /// called right away.
+    pub fn on_cancel<F: Fn() + Send + 'static>(&self, interrupt: F) {
+        if let Ok(mut interrupts) = self.interrupts.lock() {
+            interrupts.0.push(Box::new(interrupt));
+        }
+
+        // cancel sets the flag before calling the interrupts so either
+        // it sees the interrupt added above or we see the flag here
+        if self.is_cancelled() {
+            if let Ok(interrupts) = self.interrupts.lock() {
+                if let Some(interrupt) = interrupts.0.last() {
+                    interrupt();
+                }
+            }
+        }
+    }
+
+    /// Keep track of a host process so that it can be killed on cancellation
+    ///
+    /// Returns the id of the process.
+    pub fn track_process(&self, mut child: Child) -> u32 {
+        let id = child.id();
+        if self.is_cancelled() {
+            let _ = child.kill();
+        }
+
+        if let Ok(mut processes) = self.processes.lock() {
+            processes.insert(id, child);
+        }
+
+        id
+    }
+
+    /// Check if a tracked host process has exited, without waiting for it
+    ///
+    /// Exited processes are kept track of so this can be called any number of times.
+    pub fn process_exited(&self, id: u32) -> std::io::Result<bool> {
+        self.processes
+            .lock()
+            .map_err(|_| {
+                std::io::Error::new(
+                    std::io::ErrorKind::Other,
+                    "Failed to lock tracked processes",
+                )
+            })?
+            .get_mut(&id)
+            .ok_or_else(|| {
+                std::io::Error::new(
+                    std::io::ErrorKind::NotFound,
+                    format!("Process {} is not tracked", id),
+                )
+            })?
+            .try_wait()
+            .map(|status| status.is_some())
+    }
+
+    /// Wait for a tracked host process to exit
+    ///
+    /// The process is polled rather than waited on so that the lock on the
+    /// tracked processes is never held while blocking, which would prevent
+    /// `cancel` from killing it.
+    pub fn wait_for_process(&self, id: u32) -> std::io::Result<ExitStatus> {
+        loop {
+            let status = self
+                .processes
+                .lock()
+                .map_err(|_| {
+                    std::io::Error::new(
+                        std::io::ErrorKind::Other,
+                        "Failed to lock tracked processes",
+                    )
+                })?
+                .get_mut(&id)
+                .ok_or_else(|| {
+                    std::io::Error::new(
+                        std::io::ErrorKind::NotFound,
+                        format!("Process {} is not tracked", id),
+                    )
+                })?
+                .try_wait()?;
+
+            if let Some(status) = status {
+                if let Ok(mut processes) = self.processes.lock() {
+                    processes.remove(&id);
+                }
+                return Ok(status);
+            }
+
+            std::thread::sleep(Duration::from_millis(10));
+        }
+    }
 }
 
 #[derive(Debug, Clone)]
 pub struct FunctionDirectory {
+    function_key: String,
     attachments_path: PathBuf,
     cache_path: PathBuf,
     execution_path: PathBuf,
@@ -46,12 +208,13 @@ impl FunctionDirectory {
         checksum: &str,
         execution_id: &str,
     ) -> std::io::Result<Self> {
-        let root_path = root.join(format!(
+        let function_key = format!(
             "{name}-{version}-{checksum}",
             name = function_name,
             version = function_version,
             checksum = checksum
-        ));
+        );
+        let root_path = root.join(&function_key);
         let attachments_path = root_path.join("attachments");
         let cache_path = root_path.join("cache");
         let execution_path = root_path.join(execution_id);
@@ -61,12 +224,19 @@ impl FunctionDirectory {
         std::fs::create_dir_all(&execution_path)?;
 
         Ok(Self {
+            function_key,
             attachments_path,
             cache_path,
             execution_path,
         })
     }
 
+    /// Key identifying the function (name, version and checksum)
+    /// that this directory belongs to, shared by all of its executions
+    pub fn function_key(&self) -> &str {
+        &self.function_key
+    }
+
     pub fn attachments_path(&self) -> &Path {
         &self.attachments_path
     }
@@ -93,6 +263,7 @@ impl RuntimeParameters {
             async_runtime: tokio::runtime::Builder::new_current_thread()
                 .build()
                 .map_err(|e| e.to_string())?,
+            cancellation: CancellationToken::new(),
         })
     }
 
@@ -120,6 +291,11 @@ impl RuntimeParameters {
         self.auth_service = auth_service;
         self
     }
+
+    pub fn cancellation(mut self, cancellation: CancellationToken) -> Self {
+        self.cancellation = cancellation;
+        self
+    }
 }
 
 pub trait Runtime: Debug + Send {
@@ -140,20 +316,30 @@ pub trait RuntimeSource: Send + Sync {
 #[derive(Debug)]
 pub struct InternalRuntimeSource {
     logger: Logger,
+    compilers: CompilerConfig,
 }
 
 impl InternalRuntimeSource {
     pub fn new(logger: Logger) -> Self {
-        Self { logger }
+        Self {
+            logger,
+            compilers: CompilerConfig::default(),
+        }
+    }
+
+    pub fn with_compilers(mut self, compilers: CompilerConfig) -> Self {
+        self.compilers = compilers;
+        self
     }
 }
 
 impl RuntimeSource for InternalRuntimeSource {
     fn get(&self, name: &str) -> Option<Box<dyn Runtime>> {
         match name {
-            "wasi" => Some(Box::new(wasi::WasiRuntime::new(
-                self.logger.new(o!("runtime" => "wasi")),
-            ))),
+            "wasi" => Some(Box::new(
+                wasi::WasiRuntime::new(self.logger.new(o!("runtime" => "wasi")))
+                    .with_compiler(self.compilers.for_runtime(name)),
+            )),
             _ => None,
         }
     }
@@ -21,6 +21,7 @@ use tar::Archive;
 use thiserror::Error;
 
 use super::{wasi, Runtime, RuntimeError, RuntimeParameters, RuntimeSource};
+use crate::config::{Compiler, CompilerConfig};
 
 type RuntimeWrapper = Box<dyn Fn(&Path) -> Option<Box<dyn Runtime>> + Send + Sync>;
 pub struct FileSystemSource {
@@ -43,10 +44,15 @@ impl NestedWasiRuntime {
         executable: &Path,
         runtime_context_folder: &Path,
         checksums: Checksums,
+        compiler: Compiler,
         logger: Logger,
     ) -> Self {
         Self {
-            wasi_runtime: wasi::WasiRuntime::new(logger.new(o!())),
+            // runtimes are snapshotted after initialization so that
+            // only the first execution pays for initializing the runtime
+            wasi_runtime: wasi::WasiRuntime::new(logger.new(o!()))
+                .with_compiler(compiler)
+                .with_snapshot(&checksums.sha256),
             runtime_executable: executable.to_owned(),
             runtime_name: name.to_owned(),
             runtime_checksums: checksums,
@@ -78,6 +84,7 @@ impl Runtime for NestedWasiRuntime {
             entrypoint: runtime_parameters.entrypoint.unwrap_or_default(),
             arguments: runtime_parameters.arguments,
             name: runtime_parameters.function_name.clone(),
+            attachments: function_attachments.clone(),
         };
 
         std::fs::create_dir_all(&self.runtime_context_folder).map_err(|e| {
@@ -152,6 +159,7 @@ impl Runtime for NestedWasiRuntime {
                 function_dir: runtime_parameters.function_dir,
                 auth_service: runtime_parameters.auth_service,
                 async_runtime: runtime_parameters.async_runtime,
+                cancellation: runtime_parameters.cancellation,
             },
             function_arguments,
             function_attachments,
@@ -196,6 +204,7 @@ fn create_nested_wasi_runtime(
     ext: &str,
     path: PathBuf,
     directory_checksums: &HashMap<String, TOMLChecksums>,
+    compiler: Compiler,
     logger: &Logger,
 ) -> Option<(String, RuntimeWrapper)> {
     let log = logger.new(o!(
@@ -226,6 +235,7 @@ fn create_nested_wasi_runtime(
                         &path,
                         &context_path,
                         checksums.clone(),
+                        compiler,
                         log.clone(),
                     )
                 } else {
@@ -251,6 +261,7 @@ fn create_nested_wasi_runtime(
                         &function_dir.join(format!("{}.wasm", &name)),
                         &context_path,
                         checksums.clone(),
+                        compiler,
                         log.clone(),
                     );
 
@@ -268,7 +279,11 @@ fn create_nested_wasi_runtime(
 }
 
 impl FileSystemSource {
-    pub fn new(root: &Path, logger: Logger) -> Result<Self, FileSystemSourceError> {
+    pub fn new(
+        root: &Path,
+        compilers: &CompilerConfig,
+        logger: Logger,
+    ) -> Result<Self, FileSystemSourceError> {
         info!(logger, "Scanning runtimes in directory {}", root.display());
         let fs_source_logger = logger.new(o!("runtime-dir" => root.display().to_string()));
         let checksum_file = root.join(".checksums.toml");
@@ -319,6 +334,7 @@ impl FileSystemSource {
                                             e,
                                             path.clone(),
                                             &directory_checksums,
+                                            compilers.for_runtime(stem),
                                             &logger,
                                         )
                                     }
@@ -510,7 +526,7 @@ mod tests {
             )
             .unwrap();
 
-            let fss = FileSystemSource::new(td.path(), null_logger!());
+            let fss = FileSystemSource::new(td.path(), &CompilerConfig::default(), null_logger!());
             assert!(fss.is_ok(), "creating in a valid dir should give Ok");
             let $fss = fss.unwrap();
 
@@ -521,13 +537,18 @@ mod tests {
     #[test]
     fn test_empty_dir() {
         assert!(
-            FileSystemSource::new(&PathBuf::from("asdasd"), null_logger!()).is_err(),
+            FileSystemSource::new(
+                &PathBuf::from("asdasd"),
+                &CompilerConfig::default(),
+                null_logger!()
+            )
+            .is_err(),
             "non-existent dir should give an error"
         );
 
         let td = TempDir::new().unwrap();
         assert!(
-            FileSystemSource::new(td.path(), null_logger!()).is_err(),
+            FileSystemSource::new(td.path(), &CompilerConfig::default(), null_logger!()).is_err(),
             "an empty directory should give an error since a checksum file is required"
         );
     }
@@ -1,13 +1,17 @@
 mod api;
+pub mod compiler;
 mod error;
 mod function;
+mod interrupt;
 mod net;
 mod output;
+mod poll;
 mod process;
 mod sandbox;
+mod snapshot;
 
 use std::{
-    collections::HashMap, fs::OpenOptions, io::LineWriter, path::Path, path::PathBuf, sync::Arc,
+    collections::BTreeMap, fs::OpenOptions, io::LineWriter, path::Path, path::PathBuf, sync::Arc,
     sync::Mutex,
 };
 
@@ -19,26 +23,52 @@ use wasmer::{imports, ChainableNamedResolver, Function, ImportObject, Instance,
 use wasmer_wasi::WasiState;
 
 use super::{Runtime, RuntimeParameters, StreamExt};
-use crate::executor::{AttachmentDownload, RuntimeError};
+use crate::{
+    config::Compiler,
+    executor::{AttachmentDownload, RuntimeError},
+};
 use api::ApiState;
 use error::WasiError;
 use firm_types::functions::{Attachment, Stream};
 use sandbox::Sandbox;
+pub use snapshot::{set_max_warm_snapshots, DEFAULT_MAX_WARM_SNAPSHOTS};
 
 #[derive(Debug, Clone)]
 pub struct WasiRuntime {
     logger: Logger,
-    host_dirs: HashMap<String, PathBuf>,
+    // ordered so that every instance gets the same preopened file
+    // descriptors, which a restored snapshot depends on
+    host_dirs: BTreeMap<String, PathBuf>,
+    compiler: Compiler,
+    snapshot_key: Option<String>,
 }
 
 impl WasiRuntime {
     pub fn new(logger: Logger) -> Self {
         Self {
             logger,
-            host_dirs: HashMap::new(),
+            host_dirs: BTreeMap::new(),
+            compiler: Compiler::default(),
+            snapshot_key: None,
         }
     }
 
+    /// Snapshot the module state after initialization and restore it for
+    /// later executions. All executions using the same `key` share a
+    /// snapshot so the key must identify the module (like a checksum).
+    ///
+    /// Modules that also export a warm function get an additional snapshot
+    /// per function they run, taken after the function has been prepared.
+    pub fn with_snapshot(mut self, key: &str) -> Self {
+        self.snapshot_key = Some(key.to_owned());
+        self
+    }
+
+    pub fn with_compiler(mut self, compiler: Compiler) -> Self {
+        self.compiler = compiler;
+        self
+    }
+
     pub fn with_host_dir<P>(mut self, wasi_name: &str, host_path: P) -> Self
     where
         P: AsRef<Path>,
@@ -67,6 +97,7 @@ fn setup_api_imports(store: &Store, api_state: ApiState) -> ImportObject {
             "start_host_process" => Function::new_native_with_env(store, api_state.clone(), api::host::start_process),
             "run_host_process" => Function::new_native_with_env(store, api_state.clone(), api::host::run_process),
             "connect" => Function::new_native_with_env(store, api_state.clone(), api::host::socket_connect),
+            "poll" => Function::new_native_with_env(store, api_state.clone(), api::host::poll),
 
             // Attachments
             "get_attachment_path_len" => Function::new_native_with_env(store, api_state.clone(), api::attachments::get_path_len),
@@ -77,15 +108,24 @@ fn setup_api_imports(store: &Store, api_state: ApiState) -> ImportObject {
             // Connections
             "get_input_len" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input_len),
             "get_input" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input),
+            "get_input_batch_len" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input_batch_len),
+            "get_input_batch" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input_batch),
+            "get_input_buffer_len" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input_buffer_len),
+            "get_input_buffer" => Function::new_native_with_env(store, api_state.clone(), api::connections::get_input_buffer),
             "set_output" => Function::new_native_with_env(store, api_state.clone(), api::connections::set_output),
             "set_error" => Function::new_native_with_env(store, api_state, api::connections::set_error),
         }
     }
 }
 
-impl Runtime for WasiRuntime {
-    fn execute(
+impl WasiRuntime {
+    /// Execute `module`, which is already compiled
+    ///
+    /// This is `execute` without downloading and compiling the code, so
+    /// the code in `runtime_parameters` is not used.
+    pub fn execute_module(
         &self,
+        module: &Module,
         runtime_parameters: RuntimeParameters,
         arguments: Stream,
         attachments: Vec<Attachment>,
@@ -199,42 +239,15 @@ impl Runtime for WasiRuntime {
         let results = Arc::new(Mutex::new(Stream::new()));
         let errors = Arc::new(Mutex::new(Vec::new()));
 
-        let store = Store::default();
-        let module = Module::new(
-            &store,
-            std::fs::read(runtime_parameters.async_runtime.block_on({
-                runtime_parameters
-                    .code
-                    .map(|code| {
-                        info!(
-                            function_logger,
-                            "Downloading code from \"{}\"",
-                            code.url
-                                .as_ref()
-                                .map(|url| url.url.as_str())
-                                .unwrap_or("No Url")
-                        );
-                        code
-                    })
-                    .ok_or_else(|| RuntimeError::MissingCode("wasi".to_owned()))?
-                    .download_cached(
-                        runtime_parameters.function_dir.attachments_path(),
-                        &runtime_parameters.auth_service,
-                    )
-                    .map_ok(|content| {
-                        info!(function_logger, "Done downloading code");
-                        content
-                    })
-            })?)
-            .map_err(|e| {
-                RuntimeError::AttachmentReadError(
-                    "code".to_owned(),
-                    format!("Failed to read downloaded code: {}", e),
-                )
-            })?,
-        )
-        .map_err(|e| format!("failed to compile wasm: {}", e))?;
+        let warm_key = self.snapshot_key.as_ref().map(|snapshot_key| {
+            format!(
+                "{}-{}",
+                snapshot_key,
+                runtime_parameters.function_dir.function_key()
+            )
+        });
 
+        let cancellation = runtime_parameters.cancellation.clone();
         let api_state = ApiState {
             arguments: Arc::new(arguments),
             attachments: Arc::new(attachments),
@@ -250,29 +263,52 @@ impl Runtime for WasiRuntime {
             auth_service: runtime_parameters.auth_service.clone(),
             async_runtime: Arc::new(runtime_parameters.async_runtime),
             function_dir: runtime_parameters.function_dir.clone(),
+            cancellation: cancellation.clone(),
         };
 
-        let entrypoint = runtime_parameters
-            .entrypoint
-            .unwrap_or_else(|| String::from("_start"));
-
-        Instance::new(
-            &module,
+        let instance = Instance::new(
+            module,
             &wasi_env
-                .import_object(&module)
+                .import_object(module)
                 .map_err(|e| format!("Failed to generate import object: {}", e))?
-                .chain_back(setup_api_imports(&store, api_state)),
+                .chain_back(setup_api_imports(module.store(), api_state)),
         )
-        .map_err(|e| format!("failed to instantiate WASI module: {}", e))?
-        .exports
-        .get_function(&entrypoint)
-        .map(|a| {
-            info!(function_logger, "Calling entrypoint {}", &entrypoint);
-            a
-        })
-        .map_err(|e| format!("Failed to resolve entrypoint {}: {}", &entrypoint, e))?
-        .call(&[])
-        .map_err(|e| format!("Failed to call entrypoint function {}: {}", &entrypoint, e))?;
+        .map_err(|e| format!("failed to instantiate WASI module: {}", e))?;
+        interrupt::interrupt_on_cancel(&instance, &cancellation);
+
+        let initialized = match (&self.snapshot_key, &warm_key) {
+            (Some(snapshot_key), Some(warm_key)) => {
+                if snapshot::restore_warm(&instance, warm_key, &function_logger)? {
+                    true
+                } else if snapshot::initialize(&instance, snapshot_key, &function_logger)? {
+                    snapshot::warm(&instance, warm_key, &function_logger)?;
+                    true
+                } else {
+                    false
+                }
+            }
+            _ => false,
+        };
+
+        // initialized instances must not run their constructors again
+        let entrypoint = runtime_parameters.entrypoint.unwrap_or_else(|| {
+            if initialized {
+                String::from(snapshot::MAIN_EXPORT)
+            } else {
+                String::from("_start")
+            }
+        });
+
+        instance
+            .exports
+            .get_function(&entrypoint)
+            .map(|a| {
+                info!(function_logger, "Calling entrypoint {}", &entrypoint);
+                a
+            })
+            .map_err(|e| format!("Failed to resolve entrypoint {}: {}", &entrypoint, e))?
+            .call(&[])
+            .map_err(|e| format!("Failed to call entrypoint function {}: {}", &entrypoint, e))?;
 
         let results = Arc::try_unwrap(results)
             .map_err(|e| {
@@ -302,9 +338,55 @@ impl Runtime for WasiRuntime {
     }
 }
 
+impl Runtime for WasiRuntime {
+    fn execute(
+        &self,
+        runtime_parameters: RuntimeParameters,
+        arguments: Stream,
+        attachments: Vec<Attachment>,
+    ) -> Result<Result<Stream, String>, RuntimeError> {
+        let function_logger = self
+            .logger
+            .new(o!("function" => runtime_parameters.function_name.to_owned()));
+
+        let code_path = runtime_parameters.async_runtime.block_on({
+            runtime_parameters
+                .code
+                .as_ref()
+                .map(|code| {
+                    info!(
+                        function_logger,
+                        "Downloading code from \"{}\"",
+                        code.url
+                            .as_ref()
+                            .map(|url| url.url.as_str())
+                            .unwrap_or("No Url")
+                    );
+                    code
+                })
+                .ok_or_else(|| RuntimeError::MissingCode("wasi".to_owned()))?
+                .download_cached(
+                    runtime_parameters.function_dir.attachments_path(),
+                    &runtime_parameters.auth_service,
+                )
+                .map_ok(|content| {
+                    info!(function_logger, "Done downloading code");
+                    content
+                })
+        })?;
+
+        let (_, module) = compiler::compile(self.compiler, &code_path, &function_logger)?;
+        self.execute_module(&module, runtime_parameters, arguments, attachments)
+    }
+}
+
 #[cfg(test)]
 mod tests {
-    use crate::{auth::AuthService, executor::FunctionOutputSink, runtime::FunctionDirectory};
+    use crate::{
+        auth::AuthService,
+        executor::FunctionOutputSink,
+        runtime::{CancellationToken, FunctionDirectory},
+    };
 
     use super::*;
     use firm_types::{code_file, stream};
@@ -338,6 +420,7 @@ mod tests {
                 async_runtime: tokio::runtime::Builder::new_current_thread()
                     .build()
                     .unwrap(),
+                cancellation: CancellationToken::new(),
             },
             stream!(),
             vec![],
@@ -346,4 +429,122 @@ mod tests {
         assert!(res.is_ok());
         assert!(res.unwrap().is_ok());
     }
+
+    /// Module reading "value" in the preopened directory "data" on initialization
+    ///
+    /// `firm.main` prints the value read during initialization followed by the
+    /// current value, read through the preopened directory found during
+    /// initialization. `_start` traps since initialized instances must not use it.
+    const SNAPSHOT_WAT: &str = r#"
+(module
+  (import "wasi_snapshot_preview1" "fd_prestat_get" (func $fd_prestat_get (param i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_prestat_dir_name" (func $fd_prestat_dir_name (param i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "path_open" (func $path_open (param i32 i32 i32 i32 i32 i64 i64 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_read" (func $fd_read (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_write" (func $fd_write (param i32 i32 i32 i32) (result i32)))
+  (import "wasi_snapshot_preview1" "fd_close" (func $fd_close (param i32) (result i32)))
+  (memory (export "memory") 1)
+  (data (i32.const 64) "value")
+
+  (func $find_data (result i32)
+    (local $fd i32)
+    (local $len i32)
+    (local.set $fd (i32.const 3))
+    (loop $next
+      (if (i32.gt_u (local.get $fd) (i32.const 32)) (then unreachable))
+      (if (i32.eqz (call $fd_prestat_get (local.get $fd) (i32.const 16)))
+        (then
+          (local.set $len (i32.load (i32.const 20)))
+          (if (i32.and (i32.ge_u (local.get $len) (i32.const 4)) (i32.le_u (local.get $len) (i32.const 64)))
+            (then
+              (if (i32.eqz (call $fd_prestat_dir_name (local.get $fd) (i32.const 128) (local.get $len)))
+                (then
+                  ;; "data" as a little endian i32
+                  (if (i32.eq (i32.load (i32.add (i32.const 124) (local.get $len))) (i32.const 0x61746164))
+                    (then (return (local.get $fd))))))))))
+      (local.set $fd (i32.add (local.get $fd) (i32.const 1)))
+      (br $next))
+    unreachable)
+
+  (func $read_value (param $dir i32) (param $buffer i32) (result i32)
+    (if (call $path_open (local.get $dir) (i32.const 0) (i32.const 64) (i32.const 5)
+                         (i32.const 0) (i64.const 2) (i64.const 0) (i32.const 0) (i32.const 32))
+      (then unreachable))
+    (i32.store (i32.const 0) (local.get $buffer))
+    (i32.store (i32.const 4) (i32.const 64))
+    (if (call $fd_read (i32.load (i32.const 32)) (i32.const 0) (i32.const 1) (i32.const 8))
+      (then unreachable))
+    (drop (call $fd_close (i32.load (i32.const 32))))
+    (i32.load (i32.const 8)))
+
+  (func $print (param $buffer i32) (param $len i32)
+    (i32.store (i32.const 0) (local.get $buffer))
+    (i32.store (i32.const 4) (local.get $len))
+    (if (call $fd_write (i32.const 1) (i32.const 0) (i32.const 1) (i32.const 8))
+      (then unreachable)))
+
+  (func (export "wizer.initialize")
+    (i32.store (i32.const 1016) (call $find_data))
+    (i32.store (i32.const 1020) (call $read_value (i32.load (i32.const 1016)) (i32.const 1024))))
+
+  (func (export "firm.main")
+    (call $print (i32.const 1024) (i32.load (i32.const 1020)))
+    (call $print (i32.const 2048) (call $read_value (i32.load (i32.const 1016)) (i32.const 2048))))
+
+  (func (export "_start") unreachable))
+"#;
+
+    #[test]
+    fn restored_snapshot() {
+        let tmp_fold = tempfile::tempdir().unwrap();
+        let data_dir = tempfile::tempdir().unwrap();
+        let executor = WasiRuntime::new(null_logger!())
+            .with_snapshot("restored-snapshot-test")
+            .with_host_dir("data", data_dir.path());
+
+        let execute = |execution_id: &str| {
+            let function_dir = FunctionDirectory::new(
+                tmp_fold.path(),
+                "snapshot",
+                "0.1.0",
+                "checksumma",
+                execution_id,
+            )
+            .unwrap();
+            let res = executor.execute(
+                RuntimeParameters {
+                    function_dir: function_dir.clone(),
+                    function_name: "snapshot".to_owned(),
+                    entrypoint: None,
+                    code: Some(code_file!(SNAPSHOT_WAT.as_bytes())),
+                    arguments: std::collections::HashMap::new(),
+                    output_sink: FunctionOutputSink::null(),
+                    auth_service: AuthService::default(),
+                    async_runtime: tokio::runtime::Builder::new_current_thread()
+                        .build()
+                        .unwrap(),
+                    cancellation: CancellationToken::new(),
+                },
+                stream!(),
+                vec![],
+            );
+            assert!(
+                matches!(res, Ok(Ok(_))),
+                "Execution {} failed: {:?}",
+                execution_id,
+                res
+            );
+
+            std::fs::read_to_string(function_dir.execution_path().join("sandbox/stdout")).unwrap()
+        };
+
+        std::fs::write(data_dir.path().join("value"), "first").unwrap();
+        assert_eq!(execute("initialize"), "firstfirst");
+
+        // the second execution starts from the snapshot and still has the
+        // value from initialization, but reads the file through the same
+        // preopened directory as the first one
+        std::fs::write(data_dir.path().join("value"), "second").unwrap();
+        assert_eq!(execute("restore"), "firstsecond");
+    }
 }
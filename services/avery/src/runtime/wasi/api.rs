@@ -1,18 +1,25 @@
 use std::{convert::TryFrom, io, io::Read, io::Write, str::Utf8Error, sync::Arc, sync::Mutex};
 
-use crate::{auth::AuthService, runtime::FunctionDirectory};
+use crate::{
+    auth::AuthService,
+    runtime::{CancellationToken, FunctionDirectory},
+};
 
-use super::{output::Output, sandbox::Sandbox, WasiError};
+use super::{error::ExecutionCancelled, output::Output, sandbox::Sandbox, WasiError};
 use firm_types::functions::{Attachment, Stream};
 use slog::Logger;
-use wasmer::{Array, HostEnvInitError, Instance, Item, Memory, ValueType, WasmPtr, WasmerEnv};
+use wasmer::{
+    Array, HostEnvInitError, Instance, Item, Memory, RuntimeError, ValueType, WasmPtr, WasmerEnv,
+};
 use wasmer_wasi::WasiEnv;
 
 pub mod host {
     use super::{ApiState, WasmBuffer, WasmItemPtr, WasmString};
     use crate::runtime::wasi::{
         error::{ToErrorCode, WasiError},
-        net, process,
+        net,
+        poll::{self, PollEntry},
+        process,
     };
     use std::{convert::TryFrom, io::Write, path::Path};
     use wasmer::{Array, Item, WasmPtr};
@@ -23,6 +30,7 @@ pub mod host {
         path_len: u32,
         exists: WasmPtr<u8, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         String::try_from(WasmString::new(WasmBuffer::new(
             api_state.wasi_env.memory(),
             path,
@@ -41,6 +49,7 @@ pub mod host {
         os_name: WasmPtr<u8, Array>,
         len_written: WasmPtr<u32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         let len = std::env::consts::OS.len();
         WasmItemPtr::new(api_state.wasi_env.memory(), len_written)
             .set(len as u32)
@@ -61,6 +70,7 @@ pub mod host {
         len: u32,
         pid_out: WasmPtr<u64, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         process::start_process(
             &api_state.logger,
             &[
@@ -72,6 +82,7 @@ pub mod host {
             &api_state.stderr,
             WasmBuffer::new(api_state.wasi_env.memory(), s, len),
             WasmItemPtr::new(api_state.wasi_env.memory(), pid_out),
+            &api_state.cancellation,
         )
         .to_error_code()
     }
@@ -82,6 +93,7 @@ pub mod host {
         len: u32,
         exit_code_out: WasmPtr<i32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         process::run_process(
             &api_state.logger,
             &[
@@ -93,16 +105,41 @@ pub mod host {
             &api_state.stderr,
             WasmBuffer::new(api_state.wasi_env.memory(), s, len),
             WasmItemPtr::new(api_state.wasi_env.memory(), exit_code_out),
+            &api_state.cancellation,
         )
         .to_error_code()
     }
 
+    pub fn poll(
+        api_state: &ApiState,
+        entries: WasmPtr<PollEntry, Array>,
+        entries_len: u32,
+        timeout_ms: i64,
+        ready_out: WasmPtr<u32, Item>,
+    ) -> u32 {
+        api_state.check_cancelled();
+        entries
+            .deref(api_state.wasi_env.memory(), 0, entries_len)
+            .ok_or_else(WasiError::FailedToDerefPointer)
+            .and_then(|entries| {
+                poll::poll(
+                    &api_state.wasi_env,
+                    entries,
+                    timeout_ms,
+                    WasmItemPtr::new(api_state.wasi_env.memory(), ready_out),
+                    &api_state.cancellation,
+                )
+            })
+            .to_error_code()
+    }
+
     pub fn socket_connect(
         api_state: &ApiState,
         addr: WasmPtr<u8, Array>,
         addr_len: u32,
         fd_out: WasmPtr<i32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         net::connect(
             &mut api_state.wasi_env.state().fs,
             WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), addr, addr_len)),
@@ -127,6 +164,7 @@ pub mod connections {
         keylen: u32,
         value: WasmPtr<u32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         function::get_input_len(
             WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
             WasmItemPtr::new(api_state.wasi_env.memory(), value),
@@ -142,6 +180,7 @@ pub mod connections {
         value: WasmPtr<u8, Array>,
         valuelen: u32,
     ) -> u32 {
+        api_state.check_cancelled();
         function::get_input(
             WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
             &mut WasmBuffer::new(api_state.wasi_env.memory(), value, valuelen),
@@ -150,6 +189,78 @@ pub mod connections {
         .to_error_code()
     }
 
+    pub fn get_input_batch_len(
+        api_state: &ApiState,
+        key: WasmPtr<u8, Array>,
+        keylen: u32,
+        offset: u64,
+        count: u64,
+        value: WasmPtr<u32, Item>,
+    ) -> u32 {
+        api_state.check_cancelled();
+        function::get_input_batch_len(
+            WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
+            offset,
+            count,
+            WasmItemPtr::new(api_state.wasi_env.memory(), value),
+            &api_state.arguments,
+        )
+        .to_error_code()
+    }
+
+    pub fn get_input_batch(
+        api_state: &ApiState,
+        key: WasmPtr<u8, Array>,
+        keylen: u32,
+        offset: u64,
+        count: u64,
+        value: WasmPtr<u8, Array>,
+        valuelen: u32,
+    ) -> u32 {
+        api_state.check_cancelled();
+        function::get_input_batch(
+            WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
+            offset,
+            count,
+            &mut WasmBuffer::new(api_state.wasi_env.memory(), value, valuelen),
+            &api_state.arguments,
+        )
+        .to_error_code()
+    }
+
+    pub fn get_input_buffer_len(
+        api_state: &ApiState,
+        key: WasmPtr<u8, Array>,
+        keylen: u32,
+        len: WasmPtr<u64, Item>,
+        channel_type: WasmPtr<i32, Item>,
+    ) -> u32 {
+        api_state.check_cancelled();
+        function::get_input_buffer_len(
+            WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
+            WasmItemPtr::new(api_state.wasi_env.memory(), len),
+            WasmItemPtr::new(api_state.wasi_env.memory(), channel_type),
+            &api_state.arguments,
+        )
+        .to_error_code()
+    }
+
+    pub fn get_input_buffer(
+        api_state: &ApiState,
+        key: WasmPtr<u8, Array>,
+        keylen: u32,
+        buffer: WasmPtr<u8, Array>,
+        bufferlen: u32,
+    ) -> u32 {
+        api_state.check_cancelled();
+        function::get_input_buffer(
+            WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
+            &mut WasmBuffer::new(api_state.wasi_env.memory(), buffer, bufferlen),
+            &api_state.arguments,
+        )
+        .to_error_code()
+    }
+
     pub fn set_output(
         api_state: &ApiState,
         key: WasmPtr<u8, Array>,
@@ -157,6 +268,7 @@ pub mod connections {
         val: WasmPtr<u8, Array>,
         vallen: u32,
     ) -> u32 {
+        api_state.check_cancelled();
         function::set_output(
             WasmString::new(WasmBuffer::new(api_state.wasi_env.memory(), key, keylen)),
             WasmBuffer::new(api_state.wasi_env.memory(), val, vallen),
@@ -174,6 +286,7 @@ pub mod connections {
     }
 
     pub fn set_error(api_state: &ApiState, msg: WasmPtr<u8, Array>, msglen: u32) -> u32 {
+        api_state.check_cancelled();
         function::set_error(WasmString::new(WasmBuffer::new(
             api_state.wasi_env.memory(),
             msg,
@@ -203,6 +316,7 @@ pub mod attachments {
         attachment_name_len: u32,
         path_len: WasmPtr<u32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         function::get_attachment_path_len(
             &api_state.attachments,
             WasmString::new(WasmBuffer::new(
@@ -223,6 +337,7 @@ pub mod attachments {
         path_ptr: WasmPtr<u8, Array>,
         path_buffer_len: u32,
     ) -> u32 {
+        api_state.check_cancelled();
         api_state.async_runtime.block_on(async {
             function::map_attachment(
                 &api_state.attachments,
@@ -251,6 +366,7 @@ pub mod attachments {
         attachment_descriptor_len: u32,
         path_len: WasmPtr<u32, Item>,
     ) -> u32 {
+        api_state.check_cancelled();
         function::get_attachment_path_len_from_descriptor(
             WasmBuffer::new(
                 api_state.wasi_env.memory(),
@@ -270,6 +386,7 @@ pub mod attachments {
         path_ptr: WasmPtr<u8, Array>,
         path_buffer_len: u32,
     ) -> u32 {
+        api_state.check_cancelled();
         api_state.async_runtime.block_on(async {
             function::map_attachment_from_descriptor(
                 &api_state.attachment_sandbox,
@@ -307,6 +424,7 @@ pub struct ApiState {
     pub wasi_env: WasiEnv,
     pub auth_service: AuthService,
     pub function_dir: FunctionDirectory,
+    pub cancellation: CancellationToken,
 
     // TODO: this assumes that all clones of this Arc
     // actually ends up on the same thread, otherwise
@@ -314,6 +432,18 @@ pub struct ApiState {
     pub async_runtime: Arc<tokio::runtime::Runtime>,
 }
 
+impl ApiState {
+    /// Abort the running function if its execution has been cancelled
+    ///
+    /// This is called on entry to every host function and traps
+    /// the WASI instance, unwinding back to the entrypoint call.
+    pub fn check_cancelled(&self) {
+        if self.cancellation.is_cancelled() {
+            RuntimeError::raise(Box::new(ExecutionCancelled))
+        }
+    }
+}
+
 impl WasmerEnv for ApiState {
     fn init_with_instance(&mut self, instance: &Instance) -> Result<(), HostEnvInitError> {
         self.wasi_env.init_with_instance(instance)
@@ -0,0 +1,289 @@
+use std::{
+    collections::HashMap,
+    io::Write,
+    path::{Path, PathBuf},
+    sync::{Arc, Mutex},
+};
+
+use lazy_static::lazy_static;
+use slog::{info, warn, Logger};
+use wasmer::{CompilerConfig, Cranelift, CraneliftOptLevel, Module, Store, JIT};
+
+use super::interrupt::Interrupt;
+use crate::config::Compiler;
+
+/// Number of executions of a module compiled with the fast compiler
+/// before it is considered hot and recompiled with the optimizing one
+const TIER_UP_THRESHOLD: u32 = 2;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum TierState {
+    Cold(u32),
+    Compiling,
+    /// Recompiling failed, keep using the fast compiler instead of trying again
+    Failed,
+}
+
+lazy_static! {
+    static ref TIER_UP_STATES: Mutex<HashMap<PathBuf, TierState>> = Mutex::new(HashMap::new());
+}
+
+fn fast_store() -> Store {
+    let mut compiler = Cranelift::new();
+    compiler.opt_level(CraneliftOptLevel::None);
+    compiler.push_middleware(Arc::new(Interrupt::default()));
+    Store::new(&JIT::new(compiler).engine())
+}
+
+fn optimized_store() -> Store {
+    let mut compiler = Cranelift::new();
+    compiler.push_middleware(Arc::new(Interrupt::default()));
+    Store::new(&JIT::new(compiler).engine())
+}
+
+/// Path where the optimized, compiled version of the module at `code_path` is cached
+fn cached_module_path(code_path: &Path) -> PathBuf {
+    let mut file_name = code_path
+        .file_name()
+        .map(|n| n.to_os_string())
+        .unwrap_or_default();
+    // modules cached before they could be interrupted have another extension
+    file_name.push(".optimized.module");
+    code_path.with_file_name(file_name)
+}
+
+fn load_cached_module(code_path: &Path, logger: &Logger) -> Option<(Store, Module)> {
+    let cache_path = cached_module_path(code_path);
+    if !cache_path.exists() {
+        return None;
+    }
+
+    let store = optimized_store();
+    // Safety: The cached module is only ever written by `compile_to_cache`
+    // below, using the same engine and compiler as we use to load it
+    match unsafe { Module::deserialize_from_file(&store, &cache_path) } {
+        Ok(module) => {
+            info!(
+                logger,
+                "Using cached compiled module \"{}\"",
+                cache_path.display()
+            );
+            Some((store, module))
+        }
+        Err(e) => {
+            warn!(
+                logger,
+                "Failed to load cached compiled module \"{}\", removing it: {}",
+                cache_path.display(),
+                e
+            );
+            let _ = std::fs::remove_file(&cache_path);
+            None
+        }
+    }
+}
+
+fn compile_to_cache(code_path: &Path, code: &[u8]) -> Result<(Store, Module), String> {
+    let store = optimized_store();
+    let module = Module::new(&store, code).map_err(|e| format!("failed to compile wasm: {}", e))?;
+
+    // write to a temporary file of our own first so that nobody can observe
+    // a partially written module, even when compiling the same module twice
+    let cache_path = cached_module_path(code_path);
+    let serialized = module
+        .serialize()
+        .map_err(|e| format!("Failed to serialize compiled module: {}", e))?;
+    tempfile::NamedTempFile::new_in(cache_path.parent().unwrap_or_else(|| Path::new(".")))
+        .and_then(|mut temp_file| {
+            temp_file.write_all(&serialized)?;
+            temp_file.persist(&cache_path).map_err(|e| e.error)
+        })
+        .map_err(|e| format!("Failed to write compiled module to cache: {}", e))?;
+
+    Ok((store, module))
+}
+
+/// Recompile the module with Cranelift on a background thread if it is hot
+fn tier_up(code_path: &Path, code: &[u8], logger: &Logger) {
+    let should_compile = TIER_UP_STATES
+        .lock()
+        .map(|mut states| {
+            let state = states
+                .entry(code_path.to_owned())
+                .or_insert(TierState::Cold(0));
+            match *state {
+                TierState::Cold(count) if count + 1 >= TIER_UP_THRESHOLD => {
+                    *state = TierState::Compiling;
+                    true
+                }
+                TierState::Cold(count) => {
+                    *state = TierState::Cold(count + 1);
+                    false
+                }
+                TierState::Compiling | TierState::Failed => false,
+            }
+        })
+        .unwrap_or(false);
+
+    if should_compile {
+        let code_path = code_path.to_owned();
+        let code = code.to_vec();
+        let logger = logger.clone();
+        std::thread::spawn(move || {
+            info!(
+                logger,
+                "Module \"{}\" is hot, recompiling it with Cranelift",
+                code_path.display()
+            );
+            let result = compile_to_cache(&code_path, &code);
+            if let Ok(mut states) = TIER_UP_STATES.lock() {
+                match result {
+                    // the cached module is used from now on
+                    Ok(_) => {
+                        states.remove(&code_path);
+                    }
+                    Err(e) => {
+                        warn!(
+                            logger,
+                            "Failed to recompile module \"{}\", not trying again: {}",
+                            code_path.display(),
+                            e
+                        );
+                        states.insert(code_path, TierState::Failed);
+                    }
+                }
+            }
+        });
+    }
+}
+
+/// Compile the WASM module at `code_path` with the given `compiler`
+///
+/// Optimized modules are cached next to the code. With the tiered compiler,
+/// modules are compiled without optimizations until they have been executed
+/// enough times, at which point they are recompiled with optimizations in the
+/// background and the cached module is used from then on.
+pub fn compile(
+    compiler: Compiler,
+    code_path: &Path,
+    logger: &Logger,
+) -> Result<(Store, Module), String> {
+    if compiler != Compiler::Fast {
+        if let Some(cached) = load_cached_module(code_path, logger) {
+            return Ok(cached);
+        }
+    }
+
+    let code = std::fs::read(code_path).map_err(|e| {
+        format!(
+            "Failed to read code at \"{}\" for compilation: {}",
+            code_path.display(),
+            e
+        )
+    })?;
+
+    match compiler {
+        Compiler::Fast => {
+            let store = fast_store();
+            Module::new(&store, &code)
+                .map(|module| (store, module))
+                .map_err(|e| format!("failed to compile wasm: {}", e))
+        }
+        Compiler::Optimized => compile_to_cache(code_path, &code).or_else(|e| {
+            warn!(logger, "Failed to cache compiled module: {}", e);
+            let store = optimized_store();
+            Module::new(&store, &code)
+                .map(|module| (store, module))
+                .map_err(|e| format!("failed to compile wasm: {}", e))
+        }),
+        Compiler::Tiered => {
+            let store = fast_store();
+            let module =
+                Module::new(&store, &code).map_err(|e| format!("failed to compile wasm: {}", e))?;
+            tier_up(code_path, &code, logger);
+            Ok((store, module))
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    macro_rules! null_logger {
+        () => {{
+            slog::Logger::root(slog::Discard, slog::o!())
+        }};
+    }
+
+    #[test]
+    fn optimized_caches_module() {
+        let tmp_fold = tempfile::tempdir().unwrap();
+        let code_path = tmp_fold.path().join("code");
+        std::fs::write(&code_path, include_bytes!("../hello.wasm")).unwrap();
+
+        assert!(compile(Compiler::Optimized, &code_path, &null_logger!()).is_ok());
+        assert!(
+            cached_module_path(&code_path).exists(),
+            "Optimized modules must be cached"
+        );
+        assert_eq!(
+            std::fs::read_dir(tmp_fold.path()).unwrap().count(),
+            2,
+            "No temporary files are expected to be left behind"
+        );
+
+        // loading from the cache must work
+        assert!(load_cached_module(&code_path, &null_logger!()).is_some());
+    }
+
+    #[test]
+    fn fast_does_not_cache() {
+        let tmp_fold = tempfile::tempdir().unwrap();
+        let code_path = tmp_fold.path().join("code");
+        std::fs::write(&code_path, include_bytes!("../hello.wasm")).unwrap();
+
+        assert!(compile(Compiler::Fast, &code_path, &null_logger!()).is_ok());
+        assert!(!cached_module_path(&code_path).exists());
+    }
+
+    #[test]
+    fn broken_cache_is_removed() {
+        let tmp_fold = tempfile::tempdir().unwrap();
+        let code_path = tmp_fold.path().join("code");
+        std::fs::write(&code_path, include_bytes!("../hello.wasm")).unwrap();
+        std::fs::write(cached_module_path(&code_path), b"not a module").unwrap();
+
+        assert!(compile(Compiler::Tiered, &code_path, &null_logger!()).is_ok());
+        assert!(
+            !cached_module_path(&code_path).exists(),
+            "Broken cached modules must be removed"
+        );
+    }
+
+    #[test]
+    fn failed_tier_up_is_not_retried() {
+        let tmp_fold = tempfile::tempdir().unwrap();
+        let code_path = tmp_fold.path().join("code");
+
+        // not a module, recompiling it fails
+        for _ in 0..TIER_UP_THRESHOLD {
+            tier_up(&code_path, b"not a module", &null_logger!());
+        }
+
+        let state = || TIER_UP_STATES.lock().unwrap().get(&code_path).copied();
+        let started = std::time::Instant::now();
+        while state() == Some(TierState::Compiling) {
+            assert!(started.elapsed() < std::time::Duration::from_secs(10));
+            std::thread::sleep(std::time::Duration::from_millis(10));
+        }
+        assert_eq!(state(), Some(TierState::Failed));
+
+        tier_up(&code_path, b"not a module", &null_logger!());
+        assert_eq!(
+            state(),
+            Some(TierState::Failed),
+            "A failed recompilation must not be retried"
+        );
+    }
+}
@@ -51,8 +51,19 @@ pub enum WasiError {
 
     #[error("Failed to read WASI buffer: {0}")]
     FailedToReadBuffer(std::io::Error),
+
+    #[error("Failed to poll for readiness: {0}")]
+    FailedToPoll(std::io::Error),
+
+    #[error("Input \"{0}\" can not be accessed as a buffer")]
+    InputNotBuffer(String),
 }
 
+/// Error used to trap a WASI instance when its execution has been cancelled
+#[derive(Error, Debug)]
+#[error("Function execution was cancelled")]
+pub struct ExecutionCancelled;
+
 pub type WasiResult<T> = std::result::Result<T, WasiError>;
 
 pub trait ToErrorCode<T> {
@@ -87,6 +98,8 @@ impl From<&WasiError> for u32 {
             WasiError::FailedToUnpackAttachment(..) => 15,
             WasiError::FailedToWriteBuffer(..) => 16,
             WasiError::FailedToReadBuffer(..) => 17,
+            WasiError::FailedToPoll(..) => 18,
+            WasiError::InputNotBuffer(_) => 19,
         }
     }
 }
@@ -17,7 +17,7 @@ use crate::{auth::AuthenticationSource, executor::AttachmentDownload, runtime::F
 use firm_types::{
     functions::{Attachment, Channel, Stream},
     prost::Message,
-    stream::StreamExt,
+    stream::{ChannelExt, StreamExt},
 };
 
 use slog::{info, Logger};
@@ -213,6 +213,89 @@ pub fn get_input(key: WasmString, value: &mut WasmBuffer, arguments: &Stream) ->
         })
 }
 
+fn get_input_batch_channel(
+    key: WasmString,
+    offset: u64,
+    count: u64,
+    arguments: &Stream,
+) -> WasiResult<Channel> {
+    let key: String = key
+        .try_into()
+        .map_err(|e| WasiError::FailedToReadStringPointer("input key".to_owned(), e))?;
+
+    arguments
+        .get_channel(&key)
+        .ok_or(WasiError::FailedToFindKey(key))
+        .map(|a| a.slice(offset as usize, count as usize))
+}
+
+pub fn get_input_batch_len(
+    key: WasmString,
+    offset: u64,
+    count: u64,
+    len: WasmItemPtr<u32>,
+    arguments: &Stream,
+) -> WasiResult<()> {
+    get_input_batch_channel(key, offset, count, arguments)
+        .and_then(|a| len.set(a.encoded_len() as u32))
+}
+
+pub fn get_input_batch(
+    key: WasmString,
+    offset: u64,
+    count: u64,
+    value: &mut WasmBuffer,
+    arguments: &Stream,
+) -> WasiResult<()> {
+    get_input_batch_channel(key, offset, count, arguments).and_then(|a| {
+        a.encode(&mut value.buffer_mut())
+            .map_err(WasiError::FailedToEncodeProtobuf)
+    })
+}
+
+fn get_input_channel(key: WasmString, arguments: &Stream) -> WasiResult<(String, &Channel)> {
+    let key: String = key
+        .try_into()
+        .map_err(|e| WasiError::FailedToReadStringPointer("input key".to_owned(), e))?;
+
+    arguments
+        .get_channel(&key)
+        .ok_or_else(|| WasiError::FailedToFindKey(key.clone()))
+        .map(|channel| (key, channel))
+}
+
+/// Get the size of an input as a buffer and the type of its values
+///
+/// The type is -1 for inputs without values. Strings have no buffer
+/// representation and get a size of 0.
+pub fn get_input_buffer_len(
+    key: WasmString,
+    len: WasmItemPtr<u64>,
+    channel_type: WasmItemPtr<i32>,
+    arguments: &Stream,
+) -> WasiResult<()> {
+    get_input_channel(key, arguments).and_then(|(_, channel)| {
+        len.set(channel.buffer_len().unwrap_or_default() as u64)?;
+        channel_type.set(channel.channel_type().map_or(-1, |t| t as i32))
+    })
+}
+
+/// Write the values of an input straight into `buffer`
+///
+/// See `ChannelExt::write_buffer` for the layout.
+pub fn get_input_buffer(
+    key: WasmString,
+    buffer: &mut WasmBuffer,
+    arguments: &Stream,
+) -> WasiResult<()> {
+    get_input_channel(key, arguments).and_then(|(key, channel)| {
+        channel
+            .write_buffer(buffer.buffer_mut())
+            .map(|_| ())
+            .ok_or(WasiError::InputNotBuffer(key))
+    })
+}
+
 pub fn set_output(key: WasmString, value: WasmBuffer) -> WasiResult<Stream> {
     let key: String = key
         .try_into()
@@ -243,7 +326,7 @@ mod tests {
 
     use std::convert::TryFrom;
 
-    use firm_types::{attachment, stream, stream::ToChannel};
+    use firm_types::{attachment, functions::ChannelType, stream, stream::ToChannel};
     use tempfile::Builder;
     use wasmer::{Memory, MemoryType, Store, WasmPtr};
 
@@ -412,6 +495,89 @@ mod tests {
         assert_eq!(reference_value, out_ptr.buffer());
     }
 
+    #[test]
+    fn test_get_input_batch() {
+        // testing failed to find key
+        let mem = create_mem!();
+        let key = wasm_string!(&mem, 0, "input1");
+        let res = get_input_batch_len(
+            key.clone(),
+            0,
+            2,
+            WasmItemPtr::new(&mem, WasmPtr::new(key.buffer_len())),
+            &stream!(),
+        );
+
+        assert!(res.is_err());
+        assert!(matches!(res.unwrap_err(), WasiError::FailedToFindKey(..)));
+
+        // testing getting a batch
+        let mem = create_mem!();
+        let stream = stream!({"input1" => vec![1i64, 2i64, 3i64, 4i64, 5i64]});
+        let key = wasm_string!(&mem, 0, "input1");
+
+        let reference_channel = vec![3i64, 4i64].to_channel();
+        let encoded_len = reference_channel.encoded_len();
+        let mut reference_value = Vec::with_capacity(encoded_len);
+        reference_channel.encode(&mut reference_value).unwrap();
+
+        let out_len = WasmItemPtr::new(&mem, WasmPtr::new(key.buffer_len()));
+        let res = get_input_batch_len(key.clone(), 2, 2, out_len.clone(), &stream);
+        assert!(res.is_ok());
+        assert_eq!(encoded_len, out_len.get().unwrap() as usize);
+
+        let out_ptr = out_buffer!(&mem, key.buffer_len() + 4, encoded_len as u32);
+        let res = get_input_batch(key.clone(), 2, 2, &mut out_ptr.clone(), &stream);
+        assert!(res.is_ok());
+        assert_eq!(reference_value, out_ptr.buffer());
+
+        // testing getting a batch past the end, which must be empty but keep the type
+        let mem = create_mem!();
+        let key = wasm_string!(&mem, 0, "input1");
+        let empty_channel = Vec::<i64>::new().to_channel();
+        let encoded_len = empty_channel.encoded_len();
+
+        let out_ptr = out_buffer!(&mem, key.buffer_len(), encoded_len as u32);
+        let res = get_input_batch(key, 5, 2, &mut out_ptr.clone(), &stream);
+        assert!(res.is_ok());
+        assert_eq!(
+            empty_channel,
+            Channel::decode(out_ptr.buffer()).unwrap(),
+            "Batches past the end must be empty"
+        );
+    }
+
+    #[test]
+    fn test_get_input_buffer() {
+        let mem = create_mem!();
+        let stream = stream!({"input1" => vec![1i64, 2i64, 3i64], "input2" => "string"});
+        let key = wasm_string!(&mem, 0, "input1");
+
+        let out_len = WasmItemPtr::new(&mem, WasmPtr::new(16));
+        let out_type = WasmItemPtr::new(&mem, WasmPtr::new(24));
+        let res = get_input_buffer_len(key.clone(), out_len.clone(), out_type.clone(), &stream);
+        assert!(res.is_ok());
+        assert_eq!(Some(24), out_len.get());
+        assert_eq!(Some(ChannelType::Int as i32), out_type.get());
+
+        let out_ptr = out_buffer!(&mem, 32, 24);
+        let res = get_input_buffer(key, &mut out_ptr.clone(), &stream);
+        assert!(res.is_ok());
+        assert_eq!(
+            [1i64.to_le_bytes(), 2i64.to_le_bytes(), 3i64.to_le_bytes()].concat(),
+            out_ptr.buffer()
+        );
+
+        // strings can not be accessed as a buffer
+        let key = wasm_string!(&mem, 0, "input2");
+        let res = get_input_buffer(key, &mut out_buffer!(&mem, 32, 0), &stream);
+        assert!(matches!(res.unwrap_err(), WasiError::InputNotBuffer(..)));
+
+        let key = wasm_string!(&mem, 0, "input3");
+        let res = get_input_buffer_len(key, out_len, out_type, &stream);
+        assert!(matches!(res.unwrap_err(), WasiError::FailedToFindKey(..)));
+    }
+
     #[test]
     fn test_set_output() {
         let mem = create_mem!();
@@ -0,0 +1,150 @@
+use std::sync::Mutex;
+
+use wasmer::{
+    wasmparser::{
+        Operator, Result as WpResult, Type as WpType, TypeOrFuncType as WpTypeOrFuncType,
+    },
+    ExportIndex, FunctionMiddleware, GlobalInit, GlobalType, Instance, LocalFunctionIndex,
+    MiddlewareReaderState, ModuleMiddleware, Mutability, Type, Val,
+};
+use wasmer_types::GlobalIndex;
+use wasmer_vm::ModuleInfo;
+
+use crate::runtime::CancellationToken;
+
+/// Name of the exported global that traps the instance when set to anything but 0
+pub const INTERRUPT_EXPORT: &str = "firm.interrupt";
+
+/// Middleware making compiled modules check for interruption
+///
+/// The check is done on entry to every function and at the start of every
+/// loop iteration so that functions busy computing, without ever calling
+/// into the host, can be stopped as well.
+///
+/// A middleware keeps track of the global it added to the module so every
+/// module needs its own.
+#[derive(Debug, Default)]
+pub struct Interrupt {
+    global_index: Mutex<Option<GlobalIndex>>,
+}
+
+impl ModuleMiddleware for Interrupt {
+    fn generate_function_middleware(&self, _: LocalFunctionIndex) -> Box<dyn FunctionMiddleware> {
+        Box::new(FunctionInterrupt {
+            global_index: self
+                .global_index
+                .lock()
+                .unwrap()
+                .expect("Interrupt::generate_function_middleware: module info not transformed"),
+            entered: false,
+        })
+    }
+
+    fn transform_module_info(&self, module_info: &mut ModuleInfo) {
+        let global_index = module_info
+            .globals
+            .push(GlobalType::new(Type::I32, Mutability::Var));
+        module_info
+            .global_initializers
+            .push(GlobalInit::I32Const(0));
+        module_info.exports.insert(
+            INTERRUPT_EXPORT.to_owned(),
+            ExportIndex::Global(global_index),
+        );
+
+        *self.global_index.lock().unwrap() = Some(global_index);
+    }
+}
+
+#[derive(Debug)]
+struct FunctionInterrupt {
+    global_index: GlobalIndex,
+    entered: bool,
+}
+
+impl FunctionInterrupt {
+    fn check<'a>(&self, state: &mut MiddlewareReaderState<'a>) {
+        state.push_operator(Operator::GlobalGet {
+            global_index: self.global_index.as_u32(),
+        });
+        state.push_operator(Operator::If {
+            ty: WpTypeOrFuncType::Type(WpType::EmptyBlockType),
+        });
+        state.push_operator(Operator::Unreachable);
+        state.push_operator(Operator::End);
+    }
+}
+
+impl FunctionMiddleware for FunctionInterrupt {
+    fn feed<'a>(
+        &mut self,
+        operator: Operator<'a>,
+        state: &mut MiddlewareReaderState<'a>,
+    ) -> WpResult<()> {
+        if !self.entered {
+            self.entered = true;
+            self.check(state);
+        }
+
+        let is_loop = matches!(operator, Operator::Loop { .. });
+        state.push_operator(operator);
+        if is_loop {
+            self.check(state);
+        }
+
+        Ok(())
+    }
+}
+
+/// Trap `instance` wherever it is executing when `cancellation` is cancelled
+///
+/// Modules compiled without the [`Interrupt`] middleware only notice the
+/// cancellation on their next call into the host.
+pub fn interrupt_on_cancel(instance: &Instance, cancellation: &CancellationToken) {
+    if let Ok(global) = instance.exports.get_global(INTERRUPT_EXPORT) {
+        let global = global.clone();
+        cancellation.on_cancel(move || {
+            let _ = global.set(Val::I32(1));
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use std::{sync::Arc, time::Duration};
+
+    use wasmer::{imports, CompilerConfig, Cranelift, Module, Store, JIT};
+
+    #[test]
+    fn interrupt_loop() {
+        let mut compiler = Cranelift::new();
+        compiler.push_middleware(Arc::new(Interrupt::default()));
+        let store = Store::new(&JIT::new(compiler).engine());
+        let module = Module::new(
+            &store,
+            r#"(module (func (export "spin") (loop $spin (br $spin))))"#,
+        )
+        .unwrap();
+        let instance = Instance::new(&module, &imports! {}).unwrap();
+
+        let cancellation = CancellationToken::new();
+        interrupt_on_cancel(&instance, &cancellation);
+        let canceller = cancellation.clone();
+        std::thread::spawn(move || {
+            std::thread::sleep(Duration::from_millis(50));
+            canceller.cancel();
+        });
+
+        assert!(
+            instance
+                .exports
+                .get_function("spin")
+                .unwrap()
+                .call(&[])
+                .is_err(),
+            "A cancelled instance must trap"
+        );
+    }
+}
@@ -0,0 +1,352 @@
+use std::{
+    cell::Cell,
+    time::{Duration, Instant},
+};
+
+use wasmer::ValueType;
+use wasmer_wasi::{state::Kind, WasiEnv, WasiFs};
+
+use super::{
+    api::WasmItemPtr,
+    error::{WasiError, WasiResult},
+};
+use crate::runtime::CancellationToken;
+
+/// The entry refers to a socket, `id` is the guest file descriptor
+pub const POLL_KIND_SOCKET: u16 = 0;
+
+/// The entry refers to a host process, `id` is the process id
+pub const POLL_KIND_PROCESS: u16 = 1;
+
+pub const POLL_READABLE: u16 = 1;
+pub const POLL_WRITABLE: u16 = 2;
+pub const POLL_HANGUP: u16 = 4;
+pub const POLL_ERROR: u16 = 8;
+
+/// Longest time to block in the OS before checking for
+/// exited processes and cancellation again
+const POLL_INTERVAL: Duration = Duration::from_millis(10);
+
+/// An entry to poll for readiness, shared with the guest
+///
+/// `events` is what the guest is interested in and `revents`
+/// is set by the host to what the target is ready for. Host
+/// processes are reported as readable once they have exited.
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+#[repr(C)]
+pub struct PollEntry {
+    pub id: u64,
+    pub kind: u16,
+    pub events: u16,
+    pub revents: u16,
+    pub reserved: u16,
+}
+
+// Safety: PollEntry is repr(C), has no padding and is valid for any bit pattern
+unsafe impl ValueType for PollEntry {}
+
+/// Target of a poll entry, resolved on the host
+#[derive(Debug, Clone, Copy, PartialEq)]
+enum PollTarget {
+    Socket(i32),
+    Process(u32),
+    Invalid,
+}
+
+fn resolve_target(fs: &WasiFs, entry: &PollEntry) -> PollTarget {
+    match entry.kind {
+        POLL_KIND_SOCKET => fs
+            .fd_map
+            .get(&(entry.id as u32))
+            .and_then(|fd| match &fs.inodes[fd.inode].kind {
+                Kind::File {
+                    handle: Some(handle),
+                    ..
+                } => handle.get_raw_fd(),
+                _ => None,
+            })
+            .map(PollTarget::Socket)
+            .unwrap_or(PollTarget::Invalid),
+        POLL_KIND_PROCESS => PollTarget::Process(entry.id as u32),
+        _ => PollTarget::Invalid,
+    }
+}
+
+#[cfg(unix)]
+fn poll_sockets(
+    targets: &[PollTarget],
+    entries: &mut [PollEntry],
+    timeout: Duration,
+) -> WasiResult<()> {
+    let (indices, mut fds): (Vec<usize>, Vec<libc::pollfd>) = targets
+        .iter()
+        .enumerate()
+        .filter_map(|(i, target)| match target {
+            PollTarget::Socket(fd) => Some((
+                i,
+                libc::pollfd {
+                    fd: *fd,
+                    events: (if entries[i].events & POLL_READABLE != 0 {
+                        libc::POLLIN
+                    } else {
+                        0
+                    }) | (if entries[i].events & POLL_WRITABLE != 0 {
+                        libc::POLLOUT
+                    } else {
+                        0
+                    }),
+                    revents: 0,
+                },
+            )),
+            _ => None,
+        })
+        .unzip();
+
+    if fds.is_empty() {
+        std::thread::sleep(timeout);
+        return Ok(());
+    }
+
+    // Safety: fds is a valid array of pollfd structs with the given length
+    if unsafe {
+        libc::poll(
+            fds.as_mut_ptr(),
+            fds.len() as libc::nfds_t,
+            timeout.as_millis() as libc::c_int,
+        )
+    } < 0
+    {
+        let error = std::io::Error::last_os_error();
+        return if error.kind() == std::io::ErrorKind::Interrupted {
+            Ok(())
+        } else {
+            Err(WasiError::FailedToPoll(error))
+        };
+    }
+
+    indices.into_iter().zip(fds).for_each(|(i, fd)| {
+        entries[i].revents |= [
+            (libc::POLLIN, POLL_READABLE),
+            (libc::POLLOUT, POLL_WRITABLE),
+            (libc::POLLHUP, POLL_HANGUP),
+            (libc::POLLERR | libc::POLLNVAL, POLL_ERROR),
+        ]
+        .iter()
+        .filter(|(flag, _)| fd.revents & flag != 0)
+        .fold(0, |revents, (_, event)| revents | event);
+    });
+
+    Ok(())
+}
+
+#[cfg(not(unix))]
+fn poll_sockets(
+    targets: &[PollTarget],
+    _entries: &mut [PollEntry],
+    timeout: Duration,
+) -> WasiResult<()> {
+    if targets.iter().any(|t| matches!(t, PollTarget::Socket(_))) {
+        Err(WasiError::FailedToPoll(std::io::Error::new(
+            std::io::ErrorKind::Other,
+            "Polling sockets is only supported on unix hosts",
+        )))
+    } else {
+        std::thread::sleep(timeout);
+        Ok(())
+    }
+}
+
+fn poll_processes(
+    targets: &[PollTarget],
+    entries: &mut [PollEntry],
+    cancellation: &CancellationToken,
+) {
+    targets
+        .iter()
+        .zip(entries.iter_mut())
+        .for_each(|(target, entry)| match target {
+            PollTarget::Process(id) => match cancellation.process_exited(*id) {
+                Ok(true) => entry.revents |= POLL_READABLE,
+                Ok(false) => {}
+                Err(_) => entry.revents |= POLL_ERROR,
+            },
+            PollTarget::Invalid => entry.revents |= POLL_ERROR,
+            PollTarget::Socket(_) => {}
+        });
+}
+
+/// Wait for any of `entries` to become ready, or for `timeout` to pass
+///
+/// A `timeout` of `None` waits until something is ready. The host blocks in
+/// short intervals so that exited processes and cancellation are noticed.
+/// Returns the number of ready entries.
+fn wait_for_ready(
+    targets: &[PollTarget],
+    entries: &mut [PollEntry],
+    timeout: Option<Duration>,
+    cancellation: &CancellationToken,
+) -> WasiResult<u32> {
+    let deadline = timeout.map(|timeout| Instant::now() + timeout);
+    entries.iter_mut().for_each(|entry| entry.revents = 0);
+
+    loop {
+        poll_processes(targets, entries, cancellation);
+
+        let now = Instant::now();
+        let remaining = deadline.map(|deadline| deadline.saturating_duration_since(now));
+        let already_ready = entries.iter().any(|entry| entry.revents != 0);
+        poll_sockets(
+            targets,
+            entries,
+            if already_ready {
+                Duration::from_millis(0)
+            } else {
+                remaining.map_or(POLL_INTERVAL, |r| r.min(POLL_INTERVAL))
+            },
+        )?;
+
+        let ready = entries.iter().filter(|entry| entry.revents != 0).count() as u32;
+        if ready > 0
+            || cancellation.is_cancelled()
+            || deadline.map_or(false, |deadline| Instant::now() >= deadline)
+        {
+            return Ok(ready);
+        }
+    }
+}
+
+/// Poll the sockets and host processes in `entries` for readiness
+///
+/// A negative `timeout_ms` waits until at least one entry is ready.
+pub fn poll(
+    wasi_env: &WasiEnv,
+    entries: &[Cell<PollEntry>],
+    timeout_ms: i64,
+    ready_out: WasmItemPtr<u32>,
+    cancellation: &CancellationToken,
+) -> WasiResult<()> {
+    let mut polled: Vec<PollEntry> = entries.iter().map(Cell::get).collect();
+
+    // do not hold on to the WASI state while waiting
+    let targets: Vec<PollTarget> = {
+        let state = wasi_env.state();
+        polled
+            .iter()
+            .map(|entry| resolve_target(&state.fs, entry))
+            .collect()
+    };
+
+    let ready = wait_for_ready(
+        &targets,
+        &mut polled,
+        u64::try_from(timeout_ms).ok().map(Duration::from_millis),
+        cancellation,
+    )?;
+
+    entries
+        .iter()
+        .zip(polled)
+        .for_each(|(entry, polled)| entry.set(polled));
+    ready_out.set(ready)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use std::{
+        io::Write,
+        net::{TcpListener, TcpStream},
+        process::Command,
+    };
+
+    #[cfg(unix)]
+    #[test]
+    fn socket_readiness() {
+        use std::os::unix::io::AsRawFd;
+
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let mut client = TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+        let (server, _) = listener.accept().unwrap();
+
+        let targets = [PollTarget::Socket(server.as_raw_fd())];
+        let mut entries = [PollEntry {
+            events: POLL_READABLE,
+            ..Default::default()
+        }];
+
+        // nothing to read yet
+        let ready = wait_for_ready(
+            &targets,
+            &mut entries,
+            Some(Duration::from_millis(20)),
+            &CancellationToken::new(),
+        )
+        .unwrap();
+        assert_eq!(ready, 0);
+        assert_eq!(entries[0].revents, 0);
+
+        client.write_all(b"sune").unwrap();
+        let ready =
+            wait_for_ready(&targets, &mut entries, None, &CancellationToken::new()).unwrap();
+        assert_eq!(ready, 1);
+        assert_eq!(entries[0].revents & POLL_READABLE, POLL_READABLE);
+
+        // a connected socket is writable right away
+        let targets = [PollTarget::Socket(client.as_raw_fd())];
+        let mut entries = [PollEntry {
+            events: POLL_WRITABLE,
+            ..Default::default()
+        }];
+        let ready =
+            wait_for_ready(&targets, &mut entries, None, &CancellationToken::new()).unwrap();
+        assert_eq!(ready, 1);
+        assert_eq!(entries[0].revents, POLL_WRITABLE);
+    }
+
+    #[cfg(unix)]
+    #[test]
+    fn process_readiness() {
+        let cancellation = CancellationToken::new();
+        let id = cancellation.track_process(Command::new("true").spawn().unwrap());
+
+        let targets = [PollTarget::Process(id)];
+        let mut entries = [PollEntry {
+            kind: POLL_KIND_PROCESS,
+            id: id as u64,
+            events: POLL_READABLE,
+            ..Default::default()
+        }];
+
+        let ready = wait_for_ready(&targets, &mut entries, None, &cancellation).unwrap();
+        assert_eq!(ready, 1);
+        assert_eq!(entries[0].revents, POLL_READABLE);
+
+        // processes that are not tracked are errors
+        let targets = [PollTarget::Process(id + 1)];
+        let ready = wait_for_ready(&targets, &mut entries, None, &cancellation).unwrap();
+        assert_eq!(ready, 1);
+        assert_eq!(entries[0].revents, POLL_ERROR);
+    }
+
+    #[test]
+    fn timeout_and_cancellation() {
+        let mut entries = [PollEntry::default()];
+        let cancellation = CancellationToken::new();
+        let started = Instant::now();
+
+        // invalid entries are ready with an error
+        let ready = wait_for_ready(&[PollTarget::Invalid], &mut entries, None, &cancellation);
+        assert_eq!(ready.unwrap(), 1);
+        assert_eq!(entries[0].revents, POLL_ERROR);
+
+        let ready = wait_for_ready(&[], &mut [], Some(Duration::from_millis(30)), &cancellation);
+        assert_eq!(ready.unwrap(), 0);
+        assert!(started.elapsed() >= Duration::from_millis(30));
+
+        // waiting without a timeout returns when cancelled
+        cancellation.cancel();
+        let ready = wait_for_ready(&[], &mut [], None, &cancellation);
+        assert_eq!(ready.unwrap(), 0);
+    }
+}
@@ -15,6 +15,7 @@ use super::{
     output::Output,
     sandbox::Sandbox,
 };
+use crate::runtime::CancellationToken;
 use firm_types::{prost::Message, wasi::StartProcessRequest};
 
 pub fn get_args_and_envs(
@@ -79,6 +80,7 @@ pub fn start_process(
     stderr: &Output,
     request: WasmBuffer,
     pid_out: WasmItemPtr<u64>,
+    cancellation: &CancellationToken,
 ) -> WasiResult<()> {
     let request: StartProcessRequest =
         StartProcessRequest::decode(request.buffer()).map_err(WasiError::FailedToDecodeProtobuf)?;
@@ -106,7 +108,7 @@ pub fn start_process(
                 stderr.clone(),
                 &logger.new(o!("start_process" => request.command)),
             );
-            pid_out.set(c.id() as u64)
+            pid_out.set(cancellation.track_process(c) as u64)
         })
 }
 
@@ -117,6 +119,7 @@ pub fn run_process(
     stderr: &Output,
     request: WasmBuffer,
     exit_code_out: WasmItemPtr<i32>,
+    cancellation: &CancellationToken,
 ) -> WasiResult<()> {
     let request: StartProcessRequest =
         StartProcessRequest::decode(request.buffer()).map_err(WasiError::FailedToDecodeProtobuf)?;
@@ -139,13 +142,15 @@ pub fn run_process(
         })
         .and_then(|mut c| {
             setup_readers(&mut c, stdout.clone(), stderr.clone(), logger);
-            c.wait().map_err(|e| {
-                warn!(
-                    logger,
-                    "Failed to run host process (Failed to wait for it to exit): {}", e
-                );
-                WasiError::FailedToStartProcess(e)
-            })
+            cancellation
+                .wait_for_process(cancellation.track_process(c))
+                .map_err(|e| {
+                    warn!(
+                        logger,
+                        "Failed to run host process (Failed to wait for it to exit): {}", e
+                    );
+                    WasiError::FailedToStartProcess(e)
+                })
         })
         .and_then(|c| exit_code_out.set(c.code().unwrap_or(-1)))
 }
@@ -0,0 +1,429 @@
+use std::{
+    collections::{HashMap, VecDeque},
+    sync::{Arc, Mutex},
+};
+
+use lazy_static::lazy_static;
+use slog::{info, warn, Logger};
+use wasmer::{Extern, Instance, Mutability, Pages, Val};
+
+use super::interrupt::INTERRUPT_EXPORT;
+
+/// Name of the export used to initialize a module before snapshotting it
+///
+/// This is the same name that wizer uses so that modules prepared for
+/// wizer can be snapshotted without changes. Like with wizer, the export
+/// has to run the constructors of the module (`__wasm_call_ctors`) itself
+/// since they are otherwise only run by `_start`.
+pub const INITIALIZE_EXPORT: &str = "wizer.initialize";
+
+/// Name of the export called instead of `_start` on initialized instances
+///
+/// `_start` runs the constructors of the module again, overwriting state
+/// that was set up during initialization (wasi-libc for example populates
+/// its table of preopened directories in a constructor). Modules exporting
+/// [`INITIALIZE_EXPORT`] also need to export their main function under this
+/// name to be initialized.
+pub const MAIN_EXPORT: &str = "firm.main";
+
+/// Name of the export used to prepare a module for running a specific function
+///
+/// The export returns 0 if the module was prepared and should be snapshotted
+/// and any other value if the function does not want to be kept warm.
+pub const WARM_EXPORT: &str = "firm.warm";
+
+/// Default max number of warm function snapshots to keep in memory
+///
+/// There is one warm snapshot per function (as opposed to one per
+/// runtime) and each of them contain all memory of the instance.
+pub const DEFAULT_MAX_WARM_SNAPSHOTS: usize = 16;
+
+lazy_static! {
+    static ref SNAPSHOTS: Mutex<HashMap<String, Arc<Snapshot>>> = Mutex::new(HashMap::new());
+    static ref WARM_SNAPSHOTS: Mutex<WarmSnapshots> = Mutex::new(WarmSnapshots::default());
+}
+
+/// Snapshots of warm functions, evicting the least recently used when full
+#[derive(Debug)]
+struct WarmSnapshots {
+    snapshots: HashMap<String, Arc<Snapshot>>,
+    // least recently used first
+    order: VecDeque<String>,
+    limit: usize,
+}
+
+impl Default for WarmSnapshots {
+    fn default() -> Self {
+        Self {
+            snapshots: HashMap::new(),
+            order: VecDeque::new(),
+            limit: DEFAULT_MAX_WARM_SNAPSHOTS,
+        }
+    }
+}
+
+impl WarmSnapshots {
+    fn get(&mut self, key: &str) -> Option<Arc<Snapshot>> {
+        let snapshot = self.snapshots.get(key).cloned()?;
+        self.touch(key);
+        Some(snapshot)
+    }
+
+    fn insert(&mut self, key: &str, snapshot: Snapshot) {
+        if self
+            .snapshots
+            .insert(key.to_owned(), Arc::new(snapshot))
+            .is_none()
+        {
+            self.order.push_back(key.to_owned());
+        } else {
+            self.touch(key);
+        }
+
+        self.evict();
+    }
+
+    fn set_limit(&mut self, limit: usize) {
+        self.limit = limit;
+        self.evict();
+    }
+
+    /// Mark `key` as the most recently used snapshot
+    fn touch(&mut self, key: &str) {
+        if let Some(key) = self
+            .order
+            .iter()
+            .position(|k| k == key)
+            .and_then(|position| self.order.remove(position))
+        {
+            self.order.push_back(key);
+        }
+    }
+
+    fn evict(&mut self) {
+        while self.order.len() > self.limit {
+            if let Some(oldest) = self.order.pop_front() {
+                self.snapshots.remove(&oldest);
+            }
+        }
+    }
+}
+
+/// Set the max number of warm function snapshots to keep in memory
+///
+/// The snapshots are shared by all runtimes in the process. Lowering
+/// the limit evicts the least recently used snapshots right away and a
+/// limit of 0 turns warm snapshots off.
+pub fn set_max_warm_snapshots(limit: usize) -> Result<(), String> {
+    WARM_SNAPSHOTS
+        .lock()
+        .map_err(|e| format!("Failed to lock warm snapshots: {}", e))
+        .map(|mut warm_snapshots| warm_snapshots.set_limit(limit))
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+enum GlobalValue {
+    I32(i32),
+    I64(i64),
+    F32(f32),
+    F64(f64),
+}
+
+impl GlobalValue {
+    fn from_val(val: &Val) -> Option<Self> {
+        match val {
+            Val::I32(v) => Some(Self::I32(*v)),
+            Val::I64(v) => Some(Self::I64(*v)),
+            Val::F32(v) => Some(Self::F32(*v)),
+            Val::F64(v) => Some(Self::F64(*v)),
+            _ => None,
+        }
+    }
+}
+
+impl From<GlobalValue> for Val {
+    fn from(value: GlobalValue) -> Self {
+        match value {
+            GlobalValue::I32(v) => Val::I32(v),
+            GlobalValue::I64(v) => Val::I64(v),
+            GlobalValue::F32(v) => Val::F32(v),
+            GlobalValue::F64(v) => Val::F64(v),
+        }
+    }
+}
+
+/// Snapshot of the state of an initialized WASM instance
+///
+/// Contains the linear memory and all exported mutable globals, except for
+/// the interrupt flag which belongs to the execution and not to the module.
+/// Globals that are not exported can not be captured, so modules that
+/// want to be snapshotted need to export them (like wizer does).
+#[derive(Debug)]
+pub struct Snapshot {
+    memory: Vec<u8>,
+    globals: Vec<(String, GlobalValue)>,
+}
+
+impl Snapshot {
+    pub fn capture(instance: &Instance) -> Result<Self, String> {
+        let memory = instance
+            .exports
+            .get_memory("memory")
+            .map_err(|e| format!("Failed to get memory to snapshot: {}", e))?;
+
+        Ok(Self {
+            // Safety: nothing is executing in the instance while we copy the memory
+            memory: unsafe { memory.data_unchecked() }.to_vec(),
+            globals: instance
+                .exports
+                .iter()
+                .filter_map(|(name, export)| match export {
+                    Extern::Global(global)
+                        if global.ty().mutability == Mutability::Var
+                            && name != INTERRUPT_EXPORT =>
+                    {
+                        GlobalValue::from_val(&global.get()).map(|v| (name.clone(), v))
+                    }
+                    _ => None,
+                })
+                .collect(),
+        })
+    }
+
+    pub fn restore(&self, instance: &Instance) -> Result<(), String> {
+        let memory = instance
+            .exports
+            .get_memory("memory")
+            .map_err(|e| format!("Failed to get memory to restore snapshot into: {}", e))?;
+
+        let current_size = memory.data_size() as usize;
+        if current_size < self.memory.len() {
+            let page_size = wasmer::WASM_PAGE_SIZE;
+            memory
+                .grow(Pages(
+                    ((self.memory.len() - current_size + page_size - 1) / page_size) as u32,
+                ))
+                .map_err(|e| format!("Failed to grow memory to snapshot size: {}", e))?;
+        }
+
+        // Safety: nothing is executing in the instance while we write the memory
+        let memory_data = unsafe { memory.data_unchecked_mut() };
+        memory_data[..self.memory.len()].copy_from_slice(&self.memory);
+
+        self.globals.iter().try_for_each(|(name, value)| {
+            instance
+                .exports
+                .get_global(name)
+                .map_err(|e| format!("Failed to get global \"{}\": {}", name, e))
+                .and_then(|global| {
+                    global
+                        .set((*value).into())
+                        .map_err(|e| format!("Failed to restore global \"{}\": {}", name, e))
+                })
+        })
+    }
+}
+
+/// Initialize `instance`, either from an existing snapshot for `key`
+/// or by calling the initialize export and then capturing a snapshot
+///
+/// Returns whether the instance was initialized, in which case it has to be
+/// started through [`MAIN_EXPORT`]. Modules that do not export both an
+/// initialize and a main function are left untouched. If initialization
+/// fails no snapshot is captured.
+pub fn initialize(instance: &Instance, key: &str, logger: &Logger) -> Result<bool, String> {
+    let initialize = match instance.exports.get_function(INITIALIZE_EXPORT) {
+        Ok(f) => f,
+        Err(_) => return Ok(false),
+    };
+
+    if instance.exports.get_function(MAIN_EXPORT).is_err() {
+        warn!(
+            logger,
+            "Module exports {} but not {}, not initializing it", INITIALIZE_EXPORT, MAIN_EXPORT
+        );
+        return Ok(false);
+    }
+
+    let snapshot = SNAPSHOTS
+        .lock()
+        .map_err(|e| format!("Failed to lock snapshots: {}", e))?
+        .get(key)
+        .cloned();
+
+    match snapshot {
+        Some(snapshot) => {
+            info!(logger, "Restoring instance from snapshot {}", key);
+            snapshot.restore(instance).map(|_| true)
+        }
+        None => {
+            info!(
+                logger,
+                "No snapshot found for {}, initializing instance", key
+            );
+            initialize
+                .call(&[])
+                .map_err(|e| format!("Failed to call {}: {}", INITIALIZE_EXPORT, e))?;
+
+            let snapshot = Snapshot::capture(instance)?;
+            info!(
+                logger,
+                "Captured snapshot {} ({} bytes of memory, {} globals)",
+                key,
+                snapshot.memory.len(),
+                snapshot.globals.len()
+            );
+
+            SNAPSHOTS
+                .lock()
+                .map_err(|e| format!("Failed to lock snapshots: {}", e))?
+                .insert(key.to_owned(), Arc::new(snapshot));
+            Ok(true)
+        }
+    }
+}
+
+/// Restore `instance` from the warm snapshot for `key` if there is one
+///
+/// Returns whether a snapshot was restored. A warm snapshot includes the
+/// initialized state so there is no need to call `initialize` after this.
+pub fn restore_warm(instance: &Instance, key: &str, logger: &Logger) -> Result<bool, String> {
+    let snapshot = WARM_SNAPSHOTS
+        .lock()
+        .map_err(|e| format!("Failed to lock warm snapshots: {}", e))?
+        .get(key);
+
+    snapshot
+        .map(|snapshot| {
+            info!(logger, "Restoring instance from warm snapshot {}", key);
+            snapshot.restore(instance).map(|_| true)
+        })
+        .unwrap_or(Ok(false))
+}
+
+/// Prepare `instance` for running a specific function by calling the
+/// warm export and then capture a snapshot of it under `key`
+///
+/// Only initialized instances are to be kept warm. Modules that do not
+/// export a warm function or that decline to be kept warm for this
+/// function are not snapshotted.
+pub fn warm(instance: &Instance, key: &str, logger: &Logger) -> Result<(), String> {
+    let warm = match instance.exports.get_function(WARM_EXPORT) {
+        Ok(f) => f,
+        Err(_) => return Ok(()),
+    };
+
+    match warm
+        .call(&[])
+        .map_err(|e| format!("Failed to call {}: {}", WARM_EXPORT, e))?
+        .first()
+    {
+        Some(Val::I32(0)) => {
+            let snapshot = Snapshot::capture(instance)?;
+            info!(
+                logger,
+                "Captured warm snapshot {} ({} bytes of memory, {} globals)",
+                key,
+                snapshot.memory.len(),
+                snapshot.globals.len()
+            );
+
+            WARM_SNAPSHOTS
+                .lock()
+                .map_err(|e| format!("Failed to lock warm snapshots: {}", e))?
+                .insert(key, snapshot);
+            Ok(())
+        }
+        _ => {
+            info!(logger, "Module declined to be kept warm for {}", key);
+            Ok(())
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn snapshot(size: usize) -> Snapshot {
+        Snapshot {
+            memory: vec![0u8; size],
+            globals: vec![],
+        }
+    }
+
+    #[test]
+    fn failed_initialization_is_not_captured() {
+        let store = wasmer::Store::default();
+        let module = wasmer::Module::new(
+            &store,
+            r#"(module
+                 (memory (export "memory") 1)
+                 (func (export "wizer.initialize") unreachable)
+                 (func (export "firm.main")))"#,
+        )
+        .unwrap();
+        let instance = Instance::new(&module, &wasmer::imports! {}).unwrap();
+        let logger = Logger::root(slog::Discard, slog::o!());
+
+        assert!(initialize(&instance, "failed-initialization", &logger).is_err());
+        assert!(SNAPSHOTS
+            .lock()
+            .unwrap()
+            .get("failed-initialization")
+            .is_none());
+    }
+
+    #[test]
+    fn warm_snapshots_are_bounded() {
+        let mut warm_snapshots = WarmSnapshots::default();
+        (0..DEFAULT_MAX_WARM_SNAPSHOTS + 2)
+            .for_each(|i| warm_snapshots.insert(&format!("function-{}", i), snapshot(i)));
+
+        assert_eq!(warm_snapshots.snapshots.len(), DEFAULT_MAX_WARM_SNAPSHOTS);
+        assert!(
+            warm_snapshots.get("function-0").is_none(),
+            "The oldest snapshot must be evicted first"
+        );
+        assert!(warm_snapshots.get("function-1").is_none());
+        assert!(warm_snapshots
+            .get(&format!("function-{}", DEFAULT_MAX_WARM_SNAPSHOTS + 1))
+            .is_some());
+
+        // replacing a snapshot does not evict anything
+        warm_snapshots.insert("function-2", snapshot(1337));
+        assert_eq!(warm_snapshots.snapshots.len(), DEFAULT_MAX_WARM_SNAPSHOTS);
+        assert_eq!(warm_snapshots.get("function-2").unwrap().memory.len(), 1337);
+    }
+
+    #[test]
+    fn warm_snapshots_evict_least_recently_used() {
+        let mut warm_snapshots = WarmSnapshots::default();
+        warm_snapshots.set_limit(2);
+        warm_snapshots.insert("first", snapshot(1));
+        warm_snapshots.insert("second", snapshot(2));
+
+        // using the first snapshot makes the second one the least recently used
+        assert!(warm_snapshots.get("first").is_some());
+        warm_snapshots.insert("third", snapshot(3));
+        assert!(warm_snapshots.get("first").is_some());
+        assert!(warm_snapshots.get("second").is_none());
+        assert!(warm_snapshots.get("third").is_some());
+
+        // replacing a snapshot also counts as using it
+        warm_snapshots.insert("first", snapshot(4));
+        warm_snapshots.insert("fourth", snapshot(5));
+        assert!(warm_snapshots.get("third").is_none());
+        assert_eq!(warm_snapshots.get("first").unwrap().memory.len(), 4);
+
+        // lowering the limit evicts right away
+        warm_snapshots.set_limit(1);
+        assert_eq!(warm_snapshots.snapshots.len(), 1);
+        assert!(warm_snapshots.get("first").is_some());
+
+        warm_snapshots.set_limit(0);
+        warm_snapshots.insert("fifth", snapshot(6));
+        assert!(warm_snapshots.snapshots.is_empty());
+        assert!(warm_snapshots.order.is_empty());
+    }
+}
@@ -1,18 +1,31 @@
-use std::{ops::Deref, thread};
+use std::{
+    collections::HashMap,
+    io::{BufRead, BufReader, Read, Write},
+    net::TcpListener,
+    ops::Deref,
+    path::PathBuf,
+    thread,
+    time::Duration,
+};
 
 use futures::StreamExt;
+use sha2::{Digest, Sha256};
 use slog::o;
 
 use avery::{
-    auth::AuthService, config::InternalRegistryConfig, executor::ExecutionService,
+    auth::AuthService,
+    config::{CompilerConfig, InternalRegistryConfig},
+    executor::ExecutionService,
     registry::RegistryService,
+    runtime::{filesystem_source::FileSystemSource, RuntimeSource},
 };
 
 use firm_types::{
     functions::FunctionOutputChunk,
     functions::{
-        execution_server::Execution, registry_server::Registry, AttachmentStreamUpload,
-        ChannelSpec, ChannelType, ExecutionParameters,
+        execution_result::Result as ProtoResult, execution_server::Execution,
+        registry_server::Registry, AttachmentStreamUpload, ChannelSpec, ChannelType,
+        ExecutionParameters, RuntimeSpec, Stream,
     },
     stream::ToChannel,
     tonic,
@@ -76,6 +89,13 @@ impl Deref for ExecutionServiceWrapper {
 
 macro_rules! register_functions {
     ($service:expr, $fns:expr) => {{
+        register_functions!(
+            $service,
+            $fns,
+            Box::new(avery::runtime::InternalRuntimeSource::new(null_logger!()))
+        )
+    }};
+    ($service:expr, $fns:expr, $runtime_source:expr) => {{
         $fns.into_iter().for_each(|f| {
             futures::executor::block_on($service.register(tonic::Request::new(f.clone())))
                 .map_or_else(
@@ -88,9 +108,7 @@ macro_rules! register_functions {
             ExecutionService::new(
                 null_logger!(),
                 $service.clone(),
-                vec![Box::new(avery::runtime::InternalRuntimeSource::new(
-                    null_logger!(),
-                ))],
+                vec![$runtime_source],
                 AuthService::default(),
                 temp_root_directory.path(),
             )
@@ -118,6 +136,111 @@ macro_rules! registry_service {
     }};
 }
 
+/// Runtime source for the runtime directory in `AVERY_TEST_RUNTIMES_DIR`
+///
+/// The Python runtime is built with nix so tests using it are
+/// skipped when the variable is not set.
+fn python_runtime_source() -> Option<Box<dyn RuntimeSource>> {
+    match std::env::var_os("AVERY_TEST_RUNTIMES_DIR") {
+        Some(runtimes_dir) => Some(Box::new(
+            FileSystemSource::new(
+                &PathBuf::from(runtimes_dir),
+                &CompilerConfig::default(),
+                null_logger!(),
+            )
+            .unwrap(),
+        )),
+        None => {
+            eprintln!(
+                "Skipping Python runtime test, set AVERY_TEST_RUNTIMES_DIR to a \
+                 runtime directory containing the Python runtime to run it"
+            );
+            None
+        }
+    }
+}
+
+/// Package `source` as the module `module` in the code attachment format of the Python runtime
+fn python_code(module: &str, source: &str) -> Vec<u8> {
+    let mut header = tar::Header::new_gnu();
+    header.set_size(source.len() as u64);
+    header.set_mode(0o644);
+    header.set_cksum();
+
+    let mut archive = tar::Builder::new(flate2::write::GzEncoder::new(
+        Vec::new(),
+        flate2::Compression::default(),
+    ));
+    archive
+        .append_data(
+            &mut header,
+            format!("function/{}.py", module),
+            source.as_bytes(),
+        )
+        .unwrap();
+    archive.into_inner().unwrap().finish().unwrap()
+}
+
+/// Register a Python function running `source` and execute it with `arguments`
+///
+/// Returns the outputs of the function, or `None` if there is no Python runtime to run it
+async fn run_python(
+    source: &str,
+    inputs: HashMap<String, ChannelSpec>,
+    outputs: HashMap<String, ChannelSpec>,
+    arguments: Stream,
+) -> Option<Stream> {
+    let runtime_source = python_runtime_source()?;
+    let code = python_code("function", source);
+    let code_sha256 = format!("{:x}", Sha256::digest(&code));
+
+    let registry_service = registry_service!();
+    let execution_service = register_functions!(
+        registry_service,
+        vec![function_data!(
+            "python-function",
+            "0.1.0",
+            RuntimeSpec {
+                name: "python".to_owned(),
+                entrypoint: "function:main".to_owned(),
+                arguments: HashMap::new(),
+            },
+            register_code_attachment!(registry_service, code, &code_sha256).id,
+            inputs,
+            HashMap::new(),
+            outputs,
+            "Publisher",
+            "publisher@company.com",
+            [], // attachments
+            {}  // metadata
+        )],
+        runtime_source
+    );
+
+    let function = first_function!(registry_service);
+    let eid = execution_service
+        .queue_function(tonic::Request::new(ExecutionParameters {
+            name: function.name,
+            version_requirement: function.version,
+            arguments: Some(arguments),
+        }))
+        .await
+        .unwrap()
+        .into_inner();
+
+    match execution_service
+        .run_function(tonic::Request::new(eid))
+        .await
+        .unwrap()
+        .into_inner()
+        .result
+    {
+        Some(ProtoResult::Ok(outputs)) => Some(outputs),
+        Some(ProtoResult::Error(error)) => panic!("Python function failed: {}", error.msg),
+        None => panic!("Python function did not return a result"),
+    }
+}
+
 #[tokio::test]
 async fn execute() {
     let registry_service = registry_service!();
@@ -223,3 +346,393 @@ async fn execute() {
     )));
     assert!(r.is_err());
 }
+
+#[tokio::test]
+async fn cancel_execution() {
+    let registry_service = registry_service!();
+    let execution_service = register_functions!(
+        registry_service,
+        vec![function_data!(
+            "say-hello-yourself",
+            "0.1.0",
+            runtime_spec!("wasi"),
+            register_code_attachment!(
+                registry_service,
+                include_bytes!("../src/runtime/hello.wasm").to_vec(),
+                "c455c4bc68c1afcdafa7c2f74a499810b0aa5d12f7a009d493789d595847af72"
+            )
+            .id,
+            channel_specs!({}).0,
+            std::collections::HashMap::new(),
+            channel_specs!({}).0,
+            "Publisher",
+            "publisher@company.com",
+            [], // attachments
+            {}  // metadata
+        )]
+    );
+
+    let ff = first_function!(registry_service);
+
+    // Cancelling a queued execution removes it from the queue
+    let eid = futures::executor::block_on(execution_service.queue_function(tonic::Request::new(
+        ExecutionParameters {
+            name: ff.name.clone(),
+            version_requirement: ff.version.clone(),
+            arguments: Some(stream!()),
+        },
+    )))
+    .unwrap()
+    .into_inner();
+
+    let r = futures::executor::block_on(
+        execution_service.cancel_execution(tonic::Request::new(eid.clone())),
+    );
+    assert!(r.is_ok());
+    assert_eq!(r.unwrap().into_inner(), eid);
+
+    let r = futures::executor::block_on(
+        execution_service.run_function(tonic::Request::new(eid.clone())),
+    );
+    assert!(matches!(r, Err(e) if e.code() == tonic::Code::NotFound));
+
+    // Cancelling it again fails since it is not queued or running anymore
+    let r =
+        futures::executor::block_on(execution_service.cancel_execution(tonic::Request::new(eid)));
+    assert!(matches!(r, Err(e) if e.code() == tonic::Code::NotFound));
+
+    // Invalid execution ids are rejected
+    let r = futures::executor::block_on(execution_service.cancel_execution(tonic::Request::new(
+        firm_types::functions::ExecutionId {
+            uuid: String::from("not-a-uuid"),
+        },
+    )));
+    assert!(matches!(r, Err(e) if e.code() == tonic::Code::InvalidArgument));
+}
+
+#[tokio::test]
+async fn cancel_running_execution() {
+    let spin = br#"(module
+        (import "wasi_snapshot_preview1" "proc_exit" (func (param i32)))
+        (memory (export "memory") 1)
+        (func (export "_start") (loop $spin (br $spin))))"#
+        .to_vec();
+    let spin_sha256 = format!("{:x}", Sha256::digest(&spin));
+
+    let registry_service = registry_service!();
+    let function = |name: &str, code: firm_types::functions::AttachmentHandle| {
+        function_data!(
+            name,
+            "0.1.0",
+            runtime_spec!("wasi"),
+            code.id,
+            channel_specs!({}).0,
+            std::collections::HashMap::new(),
+            channel_specs!({}).0,
+            "Publisher",
+            "publisher@company.com",
+            [], // attachments
+            {}  // metadata
+        )
+    };
+    let execution_service = register_functions!(
+        registry_service,
+        vec![
+            function(
+                "spin",
+                register_code_attachment!(registry_service, spin, &spin_sha256)
+            ),
+            function(
+                "say-hello-yourself",
+                register_code_attachment!(
+                    registry_service,
+                    include_bytes!("../src/runtime/hello.wasm").to_vec(),
+                    "c455c4bc68c1afcdafa7c2f74a499810b0aa5d12f7a009d493789d595847af72"
+                )
+            )
+        ]
+    );
+
+    let queue = |name: &str| {
+        let function =
+            futures::executor::block_on(registry_service.list(tonic::Request::new(filters!(name))))
+                .unwrap()
+                .into_inner()
+                .functions
+                .remove(0);
+        futures::executor::block_on(execution_service.queue_function(tonic::Request::new(
+            ExecutionParameters {
+                name: function.name,
+                version_requirement: function.version,
+                arguments: Some(stream!()),
+            },
+        )))
+        .unwrap()
+        .into_inner()
+    };
+
+    // occupy every execution thread with a function that never calls into the host
+    let spinning = (0..num_cpus::get())
+        .map(|_| queue("spin"))
+        .collect::<Vec<_>>();
+    let (results, _) = tokio::join!(
+        futures::future::join_all(
+            spinning
+                .iter()
+                .map(|eid| execution_service.run_function(tonic::Request::new(eid.clone())))
+        ),
+        async {
+            tokio::time::sleep(Duration::from_millis(500)).await;
+            for eid in &spinning {
+                execution_service
+                    .cancel_execution(tonic::Request::new(eid.clone()))
+                    .await
+                    .unwrap();
+            }
+        }
+    );
+    assert!(results
+        .iter()
+        .all(|r| matches!(r, Err(e) if e.code() == tonic::Code::Cancelled)));
+
+    // the cancelled functions must have stopped running for this to get a thread
+    let eid = queue("say-hello-yourself");
+    let r = tokio::time::timeout(
+        Duration::from_secs(60),
+        execution_service.run_function(tonic::Request::new(eid)),
+    )
+    .await;
+    assert!(
+        matches!(r, Ok(Ok(_))),
+        "Cancelled functions must not keep running"
+    );
+
+    // dropping the requests cancels the executions and removes them
+    let spinning = (0..num_cpus::get())
+        .map(|_| queue("spin"))
+        .collect::<Vec<_>>();
+    assert!(tokio::time::timeout(
+        Duration::from_millis(500),
+        futures::future::join_all(
+            spinning
+                .iter()
+                .map(|eid| execution_service.run_function(tonic::Request::new(eid.clone())))
+        )
+    )
+    .await
+    .is_err());
+    for eid in spinning {
+        let r = execution_service
+            .cancel_execution(tonic::Request::new(eid))
+            .await;
+        assert!(matches!(r, Err(e) if e.code() == tonic::Code::NotFound));
+    }
+
+    let eid = queue("say-hello-yourself");
+    let r = tokio::time::timeout(
+        Duration::from_secs(60),
+        execution_service.run_function(tonic::Request::new(eid)),
+    )
+    .await;
+    assert!(
+        matches!(r, Ok(Ok(_))),
+        "Functions must not keep running when their request is dropped"
+    );
+}
+
+#[tokio::test]
+async fn python_socket_timeouts() {
+    let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+    let port = listener.local_addr().unwrap().port();
+    let server = thread::spawn(move || {
+        let (mut stream, _) = listener.accept().unwrap();
+        let mut reader = BufReader::new(stream.try_clone().unwrap());
+
+        let mut line = Vec::new();
+        reader.read_until(b'\n', &mut line).unwrap();
+        stream.write_all(&line).unwrap();
+
+        let mut ping = [0u8; 4];
+        reader.read_exact(&mut ping).unwrap();
+        stream.write_all(b"pong").unwrap();
+
+        // stay silent until the function has timed out and hung up
+        let mut rest = Vec::new();
+        reader.read_to_end(&mut rest).unwrap();
+        (line.len(), ping, rest)
+    });
+
+    if run_python(
+        r#"
+import socket
+
+import firm
+
+
+def main():
+    with socket.create_connection(("127.0.0.1", firm.get_input("port")), 10.0) as sock:
+        line = bytearray(b"x" * 100000 + b"\n")
+        sock.sendall(line)
+        if sock.makefile("rb").readline() != line:
+            raise AssertionError("sendall and readline must round-trip")
+
+        sock.sendall(memoryview(b"ping"))
+        pong = bytearray(4)
+        if sock.recv_into(pong) != 4 or pong != b"pong":
+            raise AssertionError(f"expected pong, got {pong}")
+
+        sock.settimeout(0.2)
+        try:
+            sock.recv(1)
+        except socket.timeout:
+            pass
+        else:
+            raise AssertionError("recv must time out on a silent socket")
+"#,
+        channel_specs!(
+            {
+                "port" => ChannelSpec {
+                    description: "port to connect to".to_owned(),
+                    r#type: ChannelType::Int as i32,
+                }
+            }
+        )
+        .0,
+        HashMap::new(),
+        stream!({ "port" => port as i64 }),
+    )
+    .await
+    .is_none()
+    {
+        return;
+    }
+
+    let (line_len, ping, rest) = server.join().unwrap();
+    assert_eq!(line_len, 100001);
+    assert_eq!(&ping, b"ping");
+    assert!(rest.is_empty());
+}
+
+#[tokio::test]
+async fn python_buffer_outputs() {
+    let output = |r#type: ChannelType| ChannelSpec {
+        description: "buffer output".to_owned(),
+        r#type: r#type as i32,
+    };
+    let outputs = match run_python(
+        r#"
+import array
+
+import firm
+
+
+def main():
+    firm.set_output("bytes", b"\x01\x02\xff")
+    firm.set_output("bytearray", bytearray(b"\x01\x02\xff"))
+    firm.set_output("memoryview", memoryview(b"\x01\x02\xff"))
+    firm.set_output("int64", memoryview(array.array("q", [1, -2])))
+    firm.set_output("float64", array.array("d", [0.5, -1.5]))
+    firm.set_output("bool", memoryview(b"\x01\x00").cast("?"))
+"#,
+        HashMap::new(),
+        channel_specs!(
+            {
+                "bytes" => output(ChannelType::Bytes),
+                "bytearray" => output(ChannelType::Int),
+                "memoryview" => output(ChannelType::Int),
+                "int64" => output(ChannelType::Int),
+                "float64" => output(ChannelType::Float),
+                "bool" => output(ChannelType::Bool)
+            }
+        )
+        .0,
+        stream!(),
+    )
+    .await
+    {
+        Some(outputs) => outputs.channels,
+        None => return,
+    };
+
+    assert_eq!(outputs["bytes"], vec![1u8, 2, 255].to_channel());
+    // sequences of bytes are ints, like when each value is converted
+    assert_eq!(outputs["bytearray"], vec![1i64, 2, 255].to_channel());
+    assert_eq!(outputs["memoryview"], vec![1i64, 2, 255].to_channel());
+    assert_eq!(outputs["int64"], vec![1i64, -2].to_channel());
+    assert_eq!(outputs["float64"], vec![0.5f64, -1.5].to_channel());
+    assert_eq!(outputs["bool"], vec![true, false].to_channel());
+}
+
+#[cfg(unix)]
+#[tokio::test]
+async fn python_asyncio() {
+    let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+    let port = listener.local_addr().unwrap().port();
+    let server = thread::spawn(move || {
+        // both connections have to be open before any of them gets a reply,
+        // which only works if the function runs them concurrently
+        let mut connections = (0..2)
+            .map(|_| {
+                let (stream, _) = listener.accept().unwrap();
+                let mut line = Vec::new();
+                BufReader::new(stream.try_clone().unwrap())
+                    .read_until(b'\n', &mut line)
+                    .unwrap();
+                (stream, line)
+            })
+            .collect::<Vec<_>>();
+        for (stream, line) in connections.iter_mut().rev() {
+            stream.write_all(line).unwrap();
+        }
+        connections.len()
+    });
+
+    if run_python(
+        r#"
+import asyncio
+
+import firm
+import wasi_asyncio
+
+
+async def echo(port, message):
+    reader, writer = await asyncio.open_connection("127.0.0.1", port)
+    writer.write(message + b"\n")
+    await writer.drain()
+    line = await reader.readline()
+    writer.close()
+    return line
+
+
+async def run(port):
+    pid = firm.start_host_process("sleep", ["0.2"])
+    return await asyncio.gather(
+        echo(port, b"first"), echo(port, b"second"), wasi_asyncio.wait_host_process(pid)
+    )
+
+
+def main():
+    first, second, _ = wasi_asyncio.run(run(firm.get_input("port")))
+    if (first, second) != (b"first\n", b"second\n"):
+        raise AssertionError(f"unexpected replies {first} and {second}")
+"#,
+        channel_specs!(
+            {
+                "port" => ChannelSpec {
+                    description: "port to connect to".to_owned(),
+                    r#type: ChannelType::Int as i32,
+                }
+            }
+        )
+        .0,
+        HashMap::new(),
+        stream!({ "port" => port as i64 }),
+    )
+    .await
+    .is_none()
+    {
+        return;
+    }
+
+    assert_eq!(server.join().unwrap(), 2);
+}
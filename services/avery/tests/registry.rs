@@ -6,8 +6,8 @@ use url::Url;
 
 use firm_types::{
     functions::{
-        registry_server::Registry, AttachmentId, AttachmentStreamUpload, Filters, FunctionId,
-        Ordering, OrderingKey,
+        registry_server::Registry, AttachmentId, AttachmentStreamUpload, Filters,
+        FunctionDataBatch, FunctionId, Ordering, OrderingKey,
     },
     tonic,
 };
@@ -278,6 +278,93 @@ fn test_offset_and_limit() {
     assert_eq!(1, list_request.unwrap().into_inner().functions.len());
 }
 
+#[test]
+fn test_continuation_token() {
+    let fr = registry!();
+    for i in 0..5 {
+        for version in &["1.0.0", "2.0.0"] {
+            futures::executor::block_on(fr.register(tonic::Request::new(function_data!(
+                &format!("fn-{}", i),
+                *version
+            ))))
+            .unwrap();
+        }
+    }
+
+    let mut filters = filters!("", 2, {});
+    let mut names = Vec::new();
+    loop {
+        let functions = futures::executor::block_on(fr.list(tonic::Request::new(filters.clone())))
+            .unwrap()
+            .into_inner();
+        assert!(functions.functions.len() <= 2);
+        names.extend(functions.functions.into_iter().map(|f| f.name));
+        if functions.continuation_token.is_empty() {
+            break;
+        }
+        filters.continuation_token = functions.continuation_token;
+    }
+    assert_eq!(names, vec!["fn-0", "fn-1", "fn-2", "fn-3", "fn-4"]);
+
+    // a newer version registered between pages does not repeat the name
+    let mut filters = filters!("", 2, {});
+    filters.order.as_mut().unwrap().reverse = true;
+    let functions = futures::executor::block_on(fr.list(tonic::Request::new(filters.clone())))
+        .unwrap()
+        .into_inner();
+    assert_eq!(
+        functions
+            .functions
+            .iter()
+            .map(|f| f.name.as_str())
+            .collect::<Vec<_>>(),
+        vec!["fn-4", "fn-3"]
+    );
+
+    futures::executor::block_on(fr.register(tonic::Request::new(function_data!("fn-3", "3.0.0"))))
+        .unwrap();
+    filters.continuation_token = functions.continuation_token;
+    let functions = futures::executor::block_on(fr.list(tonic::Request::new(filters)))
+        .unwrap()
+        .into_inner();
+    assert_eq!(
+        functions
+            .functions
+            .iter()
+            .map(|f| f.name.as_str())
+            .collect::<Vec<_>>(),
+        vec!["fn-2", "fn-1"]
+    );
+
+    // versions, in reverse
+    let mut filters = filters!("fn-1", 1, {});
+    filters.order.as_mut().unwrap().reverse = true;
+    let functions =
+        futures::executor::block_on(fr.list_versions(tonic::Request::new(filters.clone())))
+            .unwrap()
+            .into_inner();
+    assert_eq!(functions.functions[0].version, "1.0.0-dev");
+
+    filters.continuation_token = functions.continuation_token;
+    let functions =
+        futures::executor::block_on(fr.list_versions(tonic::Request::new(filters.clone())))
+            .unwrap()
+            .into_inner();
+    assert_eq!(functions.functions[0].version, "2.0.0-dev");
+
+    filters.continuation_token = functions.continuation_token;
+    let functions =
+        futures::executor::block_on(fr.list_versions(tonic::Request::new(filters.clone())))
+            .unwrap()
+            .into_inner();
+    assert!(functions.functions.is_empty());
+    assert!(functions.continuation_token.is_empty());
+
+    filters.continuation_token = String::from("🦈");
+    let res = futures::executor::block_on(fr.list(tonic::Request::new(filters)));
+    assert_eq!(res.unwrap_err().code(), tonic::Code::InvalidArgument);
+}
+
 #[test]
 fn test_sorting() {
     // yer a wizard harry
@@ -333,6 +420,7 @@ fn test_sorting() {
             }),
             version_requirement: None,
             publisher_email: String::new(),
+            continuation_token: String::new(),
         })));
 
     assert!(list_request.is_ok());
@@ -370,6 +458,7 @@ fn test_sorting() {
         }),
         version_requirement: None,
         publisher_email: String::new(),
+        continuation_token: String::new(),
     })));
     assert!(list_request.is_ok());
     let functions = list_request.unwrap().into_inner().functions;
@@ -391,6 +480,7 @@ fn test_sorting() {
             }),
             version_requirement: None,
             publisher_email: String::new(),
+            continuation_token: String::new(),
         })));
     assert!(list_request.is_ok());
     let functions = list_request.unwrap().into_inner().functions;
@@ -454,6 +544,77 @@ fn test_register_function() {
     assert!(register_result.is_ok());
 }
 
+#[test]
+fn test_register_batch() {
+    let fr = registry!();
+
+    // one invalid function fails the whole batch
+    let register_result =
+        futures::executor::block_on(fr.register_batch(tonic::Request::new(FunctionDataBatch {
+            functions: vec![
+                function_data!("create-cake", "0.0.1", runtime_spec!()),
+                function_data!("eat-cake", "0.0.1", None),
+            ],
+        })));
+    assert!(matches!(
+        register_result.unwrap_err().code(),
+        tonic::Code::InvalidArgument
+    ));
+    assert!(
+        futures::executor::block_on(fr.list(tonic::Request::new(filters!())))
+            .unwrap()
+            .into_inner()
+            .functions
+            .is_empty()
+    );
+
+    // and so does the same version twice
+    let register_result =
+        futures::executor::block_on(fr.register_batch(tonic::Request::new(FunctionDataBatch {
+            functions: vec![
+                function_data!("create-cake", "0.0.1", runtime_spec!()),
+                function_data!("create-cake", "0.0.1", runtime_spec!()),
+            ],
+        })));
+    assert!(matches!(
+        register_result.unwrap_err().code(),
+        tonic::Code::InvalidArgument
+    ));
+    assert!(
+        futures::executor::block_on(fr.list(tonic::Request::new(filters!())))
+            .unwrap()
+            .into_inner()
+            .functions
+            .is_empty()
+    );
+
+    let functions =
+        futures::executor::block_on(fr.register_batch(tonic::Request::new(FunctionDataBatch {
+            functions: vec![
+                function_data!("create-cake", "0.0.1", runtime_spec!()),
+                function_data!("eat-cake", "0.0.1", runtime_spec!()),
+            ],
+        })))
+        .unwrap()
+        .into_inner()
+        .functions;
+    assert_eq!(
+        functions
+            .iter()
+            .map(|f| format!("{}:{}", f.name, f.version))
+            .collect::<Vec<_>>(),
+        vec!["create-cake:0.0.1-dev", "eat-cake:0.0.1-dev"]
+    );
+    assert_eq!(
+        futures::executor::block_on(fr.list(tonic::Request::new(filters!())))
+            .unwrap()
+            .into_inner()
+            .functions
+            .len(),
+        2
+    );
+}
+
 #[test]
 fn test_register_dev_version() {
     let fr = registry!();
@@ -0,0 +1,192 @@
+use std::time::{Duration, Instant};
+
+use firm_types::{
+    cache::{listing_query, BoundedCache},
+    functions::{Filters, Function, Functions},
+};
+
+use crate::storage::FunctionId;
+
+/// Max number of functions to keep in the cache
+///
+/// A published function version never changes so these never go stale.
+const MAX_FUNCTIONS: usize = 10_000;
+
+/// Max number of `ListVersions` results to keep in the cache
+const MAX_VERSION_LISTINGS: usize = 1_000;
+
+/// How long a `ListVersions` result is kept
+///
+/// Registering a function invalidates the listings for it right away, but
+/// only in this process. This bounds how long it takes for functions
+/// registered through other instances of the registry to show up.
+const VERSION_LISTING_TTL: Duration = Duration::from_secs(30);
+
+/// `ListVersions` filters on an exact name so listings are kept
+/// per name to be able to invalidate them when registering
+#[derive(Debug, Clone, PartialEq, Eq, Hash)]
+struct ListingKey {
+    name: String,
+    query: String,
+}
+
+impl From<&Filters> for ListingKey {
+    fn from(filters: &Filters) -> Self {
+        Self {
+            name: filters.name.clone(),
+            query: listing_query(filters),
+        }
+    }
+}
+
+/// In-process cache of resolved functions and `ListVersions` results
+#[derive(Debug)]
+pub struct FunctionCache {
+    functions: BoundedCache<FunctionId, Function>,
+    version_listings: BoundedCache<ListingKey, (Instant, Functions)>,
+    version_listing_ttl: Duration,
+}
+
+impl Default for FunctionCache {
+    fn default() -> Self {
+        Self::new(MAX_FUNCTIONS, MAX_VERSION_LISTINGS, VERSION_LISTING_TTL)
+    }
+}
+
+impl FunctionCache {
+    fn new(
+        max_functions: usize,
+        max_version_listings: usize,
+        version_listing_ttl: Duration,
+    ) -> Self {
+        Self {
+            functions: BoundedCache::new(max_functions),
+            version_listings: BoundedCache::new(max_version_listings),
+            version_listing_ttl,
+        }
+    }
+
+    pub fn get(&self, id: &FunctionId) -> Option<Function> {
+        self.functions.get(id)
+    }
+
+    pub fn insert(&self, function: &Function) {
+        if let Ok(version) = semver::Version::parse(&function.version) {
+            self.functions.insert(
+                FunctionId {
+                    name: function.name.clone(),
+                    version,
+                },
+                function.clone(),
+            );
+        }
+    }
+
+    pub fn get_versions(&self, filters: &Filters) -> Option<Functions> {
+        self.version_listings
+            .modify(&ListingKey::from(filters), |(cached_at, functions)| {
+                (cached_at.elapsed() < self.version_listing_ttl).then(|| functions.clone())
+            })
+            .flatten()
+    }
+
+    /// Cache the `ListVersions` result `functions` for `filters`, together with all the functions in it
+    pub fn insert_versions(&self, filters: &Filters, functions: &Functions) {
+        functions
+            .functions
+            .iter()
+            .for_each(|function| self.insert(function));
+
+        self.version_listings.insert(
+            ListingKey::from(filters),
+            (Instant::now(), functions.clone()),
+        );
+    }
+
+    /// Forget all `ListVersions` results for the function `name`
+    pub fn invalidate_versions(&self, name: &str) {
+        self.version_listings.retain(|key| key.name != name);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    use firm_types::{filters, functions::VersionRequirement};
+
+    fn function(name: &str, version: &str) -> Function {
+        Function {
+            name: name.to_owned(),
+            version: version.to_owned(),
+            ..Default::default()
+        }
+    }
+
+    fn id(name: &str, version: &str) -> FunctionId {
+        FunctionId {
+            name: name.to_owned(),
+            version: semver::Version::parse(version).unwrap(),
+        }
+    }
+
+    #[test]
+    fn functions() {
+        let cache = FunctionCache::default();
+        cache.insert(&function("sune", "1.0.0"));
+        assert_eq!(
+            cache.get(&id("sune", "1.0.0")),
+            Some(function("sune", "1.0.0"))
+        );
+        assert!(cache.get(&id("sune", "1.1.0")).is_none());
+
+        // not a version, nothing to cache it as
+        cache.insert(&function("sune", "not-a-version"));
+        assert!(cache.get(&id("sune", "1.0.0")).is_some());
+    }
+
+    #[test]
+    fn version_listings() {
+        let cache = FunctionCache::default();
+        let mut filters = filters!("sune");
+        let functions = Functions {
+            functions: vec![function("sune", "1.0.0")],
+            ..Default::default()
+        };
+
+        assert!(cache.get_versions(&filters).is_none());
+        cache.insert_versions(&filters, &functions);
+        assert_eq!(cache.get_versions(&filters), Some(functions.clone()));
+        assert!(
+            cache.get(&id("sune", "1.0.0")).is_some(),
+            "Listed functions must also be cached"
+        );
+
+        // other filters for the same name are different listings
+        filters.version_requirement = Some(VersionRequirement {
+            expression: "^1".to_owned(),
+        });
+        assert!(cache.get_versions(&filters).is_none());
+        cache.insert_versions(&filters, &functions);
+        cache.insert_versions(&filters!("rune"), &functions);
+
+        cache.invalidate_versions("sune");
+        assert!(cache.get_versions(&filters).is_none());
+        assert!(cache.get_versions(&filters!("sune")).is_none());
+        assert!(cache.get_versions(&filters!("rune")).is_some());
+
+        // registered functions stay cached
+        assert!(cache.get(&id("sune", "1.0.0")).is_some());
+    }
+
+    #[test]
+    fn version_listings_expire() {
+        let cache = FunctionCache::new(2, 2, Duration::from_millis(10));
+        let functions = Functions::default();
+        cache.insert_versions(&filters!("sune"), &functions);
+        assert!(cache.get_versions(&filters!("sune")).is_some());
+
+        std::thread::sleep(Duration::from_millis(20));
+        assert!(cache.get_versions(&filters!("sune")).is_none());
+    }
+}
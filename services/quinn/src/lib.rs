@@ -1,3 +1,4 @@
+mod cache;
 pub mod config;
 pub mod registry;
 pub mod storage;
@@ -3,18 +3,25 @@ use std::convert::{TryFrom, TryInto};
 use firm_types::{
     functions::{
         registry_server::Registry, AttachmentData, AttachmentHandle, AttachmentId,
-        AttachmentStreamUpload, Filters, Function, FunctionData, FunctionId, Functions, Nothing,
+        AttachmentStreamUpload, Filters, Function, FunctionData, FunctionDataBatch, FunctionId,
+        Functions, Nothing,
     },
+    pagination::ContinuationToken,
     tonic,
 };
 use futures::TryFutureExt;
 use slog::{o, Logger};
 
-use crate::{config, storage, storage_conversions::FunctionResolver};
+use crate::{
+    cache::FunctionCache,
+    config, storage,
+    storage_conversions::{FunctionResolver, FunctionsResolver},
+};
 
 pub struct RegistryService {
     function_storage: Box<dyn storage::FunctionStorage>,
     attachment_storage: Box<dyn storage::AttachmentStorage>,
+    cache: FunctionCache,
 }
 
 impl RegistryService {
@@ -31,6 +38,7 @@ impl RegistryService {
                 log.new(o!("storage" => "attachments")),
             )
             .map_err(|e| format!("Failed to create attachment storage backed! {}", e))?,
+            cache: FunctionCache::default(),
         })
     }
 }
@@ -41,19 +49,25 @@ impl Registry for RegistryService {
         &self,
         request: tonic::Request<Filters>,
     ) -> Result<tonic::Response<Functions>, tonic::Status> {
+        let filters = storage::Filters::try_from(request.into_inner())?;
+        let limit = filters.order.clone().unwrap_or_default().limit;
         self.function_storage
-            .list(&storage::Filters::try_from(request.into_inner())?)
+            .list(&filters)
             .and_then(|functions| async move {
-                futures::future::try_join_all(functions.into_iter().map(|f| async move {
-                    f.resolve_function(
+                functions
+                    .as_slice()
+                    .resolve_functions(
                         self.function_storage.as_ref(),
                         self.attachment_storage.as_ref(),
                     )
                     .await
-                }))
-                .await
             })
-            .map_ok(|functions| tonic::Response::new(Functions { functions }))
+            .map_ok(|functions| {
+                tonic::Response::new(Functions {
+                    continuation_token: ContinuationToken::next_page(&functions, limit),
+                    functions,
+                })
+            })
             .map_err(|e| e.into())
             .await
     }
@@ -62,19 +76,32 @@ impl Registry for RegistryService {
         &self,
         request: tonic::Request<firm_types::functions::Filters>,
     ) -> Result<tonic::Response<firm_types::functions::Functions>, tonic::Status> {
+        let proto_filters = request.into_inner();
+        if let Some(functions) = self.cache.get_versions(&proto_filters) {
+            return Ok(tonic::Response::new(functions));
+        }
+
+        let filters = storage::Filters::try_from(proto_filters.clone())?;
+        let limit = filters.order.clone().unwrap_or_default().limit;
         self.function_storage
-            .list_versions(&storage::Filters::try_from(request.into_inner())?)
+            .list_versions(&filters)
             .and_then(|functions| async move {
-                futures::future::try_join_all(functions.into_iter().map(|f| async move {
-                    f.resolve_function(
+                functions
+                    .as_slice()
+                    .resolve_functions(
                         self.function_storage.as_ref(),
                         self.attachment_storage.as_ref(),
                     )
                     .await
-                }))
-                .await
             })
-            .map_ok(|functions| tonic::Response::new(Functions { functions }))
+            .map_ok(|functions| {
+                let functions = Functions {
+                    continuation_token: ContinuationToken::next_page(&functions, limit),
+                    functions,
+                };
+                self.cache.insert_versions(&proto_filters, &functions);
+                tonic::Response::new(functions)
+            })
             .map_err(|e| e.into())
             .await
     }
@@ -83,8 +110,13 @@ impl Registry for RegistryService {
         &self,
         request: tonic::Request<FunctionId>,
     ) -> Result<tonic::Response<Function>, tonic::Status> {
+        let id: storage::FunctionId = request.into_inner().try_into()?;
+        if let Some(function) = self.cache.get(&id) {
+            return Ok(tonic::Response::new(function));
+        }
+
         self.function_storage
-            .get(&request.into_inner().try_into()?)
+            .get(&id)
             .map_err(|e| e.into())
             .and_then(|function| async move {
                 function
@@ -96,7 +128,10 @@ impl Registry for RegistryService {
                     .await
             })
             .await
-            .map(tonic::Response::new)
+            .map(|function| {
+                self.cache.insert(&function);
+                tonic::Response::new(function)
+            })
     }
 
     async fn register(
@@ -116,7 +151,48 @@ impl Registry for RegistryService {
                     .await
             })
             .await
-            .map(tonic::Response::new)
+            .map(|function| {
+                // listings of this function's versions are missing the new version
+                self.cache.invalidate_versions(&function.name);
+                self.cache.insert(&function);
+                tonic::Response::new(function)
+            })
+    }
+
+    async fn register_batch(
+        &self,
+        request: tonic::Request<FunctionDataBatch>,
+    ) -> Result<tonic::Response<Functions>, tonic::Status> {
+        let functions = request
+            .into_inner()
+            .functions
+            .into_iter()
+            .map(storage::Function::try_from)
+            .collect::<Result<Vec<_>, _>>()?;
+
+        self.function_storage
+            .insert_batch(functions)
+            .and_then(|functions| async move {
+                functions
+                    .as_slice()
+                    .resolve_functions(
+                        self.function_storage.as_ref(),
+                        self.attachment_storage.as_ref(),
+                    )
+                    .await
+            })
+            .map_ok(|functions| {
+                functions.iter().for_each(|function| {
+                    self.cache.invalidate_versions(&function.name);
+                    self.cache.insert(function);
+                });
+                tonic::Response::new(Functions {
+                    functions,
+                    continuation_token: String::new(),
+                })
+            })
+            .map_err(|e| e.into())
+            .await
     }
 
     async fn register_attachment(
@@ -106,6 +106,8 @@ pub struct Filters {
     pub order: Option<Ordering>,
     pub metadata: HashMap<String, Option<String>>,
     pub publisher_email: String,
+    /// Only list functions after this one in the requested order
+    pub after: Option<FunctionId>,
 }
 
 impl Default for Ordering {
@@ -169,12 +171,22 @@ pub async fn create_storage<S: AsRef<str>>(
 #[async_trait::async_trait]
 pub trait FunctionStorage: Send + Sync {
     async fn insert(&self, function_data: Function) -> Result<Function, StorageError>;
+
+    /// Insert all of `functions` or, if any of them fails, none of them
+    ///
+    /// The inserted functions are returned in the same order as `functions`.
+    async fn insert_batch(&self, functions: Vec<Function>) -> Result<Vec<Function>, StorageError>;
     async fn insert_attachment(
         &self,
         function_attachment_data: FunctionAttachmentData,
     ) -> Result<FunctionAttachment, StorageError>;
     async fn get(&self, id: &FunctionId) -> Result<Function, StorageError>;
     async fn get_attachment(&self, id: &Uuid) -> Result<FunctionAttachment, StorageError>;
+
+    /// Get all attachments in `ids` in one go, in no particular order
+    ///
+    /// Fails with `AttachmentNotFound` if any of the attachments does not exist.
+    async fn get_attachments(&self, ids: &[Uuid]) -> Result<Vec<FunctionAttachment>, StorageError>;
     async fn list(&self, filters: &Filters) -> Result<Vec<Function>, StorageError>;
     async fn list_versions(&self, filters: &Filters) -> Result<Vec<Function>, StorageError>;
 }
@@ -1,22 +1,31 @@
 use std::{
-    collections::hash_map::{Entry, HashMap},
+    collections::{btree_map::Entry, BTreeMap, HashMap, HashSet},
+    ops::Bound,
     sync::RwLock,
 };
 
+use semver::Version;
 use slog::Logger;
 use uuid::Uuid;
 
 use super::{Function, FunctionAttachment, FunctionId, FunctionStorage, StorageError};
 
+/// Functions by name and then version
+///
+/// Both levels are ordered so listings are produced in order by iterating
+/// the index, starting at the continuation point and stopping when the
+/// page is full.
+type FunctionIndex = BTreeMap<String, BTreeMap<Version, Function>>;
+
 pub struct MemoryStorage {
-    functions: RwLock<HashMap<FunctionId, Function>>,
+    functions: RwLock<FunctionIndex>,
     attachments: RwLock<HashMap<Uuid, FunctionAttachment>>,
 }
 
 impl MemoryStorage {
     pub fn new(_log: Logger) -> Self {
         Self {
-            functions: RwLock::new(HashMap::new()),
+            functions: RwLock::new(BTreeMap::new()),
             attachments: RwLock::new(HashMap::new()),
         }
     }
@@ -33,78 +42,101 @@ impl MemoryStorage {
                     format!("Failed to acquire read lock for functions: {}", e).into(),
                 )
             })
-            .map(|f| {
-                let funcs = f
-                    .values()
-                    .filter(|function| {
-                        // Name
-                        group_versions && function.name == filters.name
-                            || function.name.contains(&filters.name)
-                    })
-                    .filter(|function| {
-                        // Version requirement
-                        filters
-                            .version_requirement
-                            .as_ref()
-                            .map_or(true, |requirement| requirement.matches(&function.version))
-                    });
-                let funcs = if group_versions {
-                    either::Either::Right(
-                        funcs
-                            .fold(
-                                HashMap::new(),
-                                |mut hashmap: HashMap<String, &Function>, function| match hashmap
-                                    .entry(function.name.clone())
-                                {
-                                    Entry::Occupied(mut entry) => {
-                                        (entry.get().version < function.version)
-                                            .then(|| entry.insert(function));
-                                        hashmap
-                                    }
-                                    Entry::Vacant(entry) => {
-                                        entry.insert(function);
-                                        hashmap
-                                    }
-                                },
+            .map(|functions| {
+                let order = filters.order.as_ref().cloned().unwrap_or_default();
+                let compare = |a: (&str, &Version), b: (&str, &Version)| match order.key {
+                    firm_types::functions::OrderingKey::NameVersion => match a.0.cmp(b.0) {
+                        std::cmp::Ordering::Equal => b.1.cmp(a.1),
+                        o => o,
+                    },
+                };
+
+                // skip everything up to and including the function to continue after
+                let after = |function: &&Function| {
+                    filters.after.as_ref().map_or(true, |after| {
+                        let position = if group_versions {
+                            // a newer version might have been registered since the last page
+                            // so only the name says where a grouped listing continues
+                            function.name.as_str().cmp(after.name.as_str())
+                        } else {
+                            compare(
+                                (function.name.as_str(), &function.version),
+                                (after.name.as_str(), &after.version),
                             )
-                            .into_values(),
+                        };
+
+                        position
+                            == if order.reverse {
+                                std::cmp::Ordering::Less
+                            } else {
+                                std::cmp::Ordering::Greater
+                            }
+                    })
+                };
+
+                let matches_version = |function: &&Function| {
+                    filters
+                        .version_requirement
+                        .as_ref()
+                        .map_or(true, |requirement| requirement.matches(&function.version))
+                };
+
+                let names = if group_versions {
+                    // no need to look at names before the one to continue after
+                    let name_range = match (&filters.after, order.reverse) {
+                        (Some(after_id), false) => {
+                            (Bound::Included(after_id.name.as_str()), Bound::Unbounded)
+                        }
+                        (Some(after_id), true) => {
+                            (Bound::Unbounded, Bound::Included(after_id.name.as_str()))
+                        }
+                        (None, _) => (Bound::Unbounded, Bound::Unbounded),
+                    };
+                    either::Either::Left(
+                        functions
+                            .range::<str, _>(name_range)
+                            .filter(|(name, _)| name.contains(&filters.name)),
                     )
                 } else {
-                    either::Either::Left(funcs)
+                    either::Either::Right(
+                        functions.get_key_value(filters.name.as_str()).into_iter(),
+                    )
                 };
-                funcs
-                    .filter(|fun| {
-                        // Metadata
-                        filters.metadata.iter().all(|(k, v)| match v {
-                            None => fun.metadata.contains_key(k),
-                            value => fun.metadata.get(k) == value.as_ref(),
-                        })
-                    })
-                    .filter(|function| function.publisher.email.contains(&filters.publisher_email))
-                    .cloned()
-                    .collect::<Vec<Function>>()
-            })
-            .map(|mut hits| {
-                let order = filters.order.as_ref().cloned().unwrap_or_default();
-                hits.sort_unstable_by(|a, b| match order.key {
-                    firm_types::functions::OrderingKey::NameVersion => match a.name.cmp(&b.name) {
-                        std::cmp::Ordering::Equal => b.version.cmp(&a.version),
-                        o => o,
-                    },
-                });
 
-                if order.reverse {
-                    hits.into_iter()
-                        .rev()
-                        .skip(order.offset)
-                        .take(order.limit)
-                        .collect()
+                (if order.reverse {
+                    either::Either::Left(names.rev())
                 } else {
-                    hits.into_iter()
-                        .skip(order.offset)
-                        .take(order.limit)
-                        .collect()
-                }
+                    either::Either::Right(names)
+                })
+                .flat_map(|(_, versions)| {
+                    if group_versions {
+                        // latest matching version only
+                        either::Either::Left(
+                            versions.values().rev().find(matches_version).into_iter(),
+                        )
+                    } else if order.reverse {
+                        either::Either::Right(either::Either::Left(
+                            versions.values().filter(matches_version),
+                        ))
+                    } else {
+                        either::Either::Right(either::Either::Right(
+                            versions.values().rev().filter(matches_version),
+                        ))
+                    }
+                })
+                .filter(|fun| {
+                    // Metadata
+                    filters.metadata.iter().all(|(k, v)| match v {
+                        None => fun.metadata.contains_key(k),
+                        value => fun.metadata.get(k) == value.as_ref(),
+                    })
+                })
+                .filter(|function| function.publisher.email.contains(&filters.publisher_email))
+                .filter(after)
+                .skip(order.offset)
+                .take(order.limit)
+                .cloned()
+                .collect()
             })
     }
 }
@@ -125,11 +157,13 @@ impl FunctionStorage for MemoryStorage {
                     format!("Failed to acquire write lock for functions: {}", e).into(),
                 )
             })?
-            .entry(function_id)
+            .entry(function_id.name)
+            .or_default()
+            .entry(function_id.version)
         {
             Entry::Occupied(entry) => Err(StorageError::VersionExists {
-                name: entry.key().name.clone(),
-                version: entry.key().version.clone(),
+                name: entry.get().name.clone(),
+                version: entry.key().clone(),
             }),
             Entry::Vacant(entry) => {
                 let mut function = function_data;
@@ -143,6 +177,65 @@ impl FunctionStorage for MemoryStorage {
         }
     }
 
+    async fn insert_batch(&self, functions: Vec<Function>) -> Result<Vec<Function>, StorageError> {
+        let mut index = self.functions.write().map_err(|e| {
+            StorageError::BackendError(
+                format!("Failed to acquire write lock for functions: {}", e).into(),
+            )
+        })?;
+
+        // attachments are looked up while the functions are locked so
+        // that nothing is inserted unless all of them exist
+        let attachments = self.attachments.read().map_err(|e| {
+            StorageError::BackendError(
+                format!("Failed to acquire read lock for attachments: {}", e).into(),
+            )
+        })?;
+
+        // check all of them before inserting anything
+        let mut seen = HashSet::new();
+        functions.iter().try_for_each(|function| {
+            if !seen.insert((&function.name, &function.version))
+                || index
+                    .get(&function.name)
+                    .map_or(false, |versions| versions.contains_key(&function.version))
+            {
+                return Err(StorageError::VersionExists {
+                    name: function.name.clone(),
+                    version: function.version.clone(),
+                });
+            }
+
+            function
+                .code
+                .iter()
+                .chain(function.attachments.iter())
+                .try_for_each(|id| {
+                    if attachments.contains_key(id) {
+                        Ok(())
+                    } else {
+                        Err(StorageError::AttachmentNotFound(id.to_string()))
+                    }
+                })
+        })?;
+
+        let created_at = std::time::SystemTime::now()
+            .duration_since(std::time::UNIX_EPOCH)
+            .unwrap_or_default()
+            .as_secs();
+        Ok(functions
+            .into_iter()
+            .map(|mut function| {
+                function.created_at = created_at;
+                index
+                    .entry(function.name.clone())
+                    .or_default()
+                    .insert(function.version.clone(), function.clone());
+                function
+            })
+            .collect())
+    }
+
     async fn insert_attachment(
         &self,
         function_attachment_data: super::FunctionAttachmentData,
@@ -179,7 +272,8 @@ impl FunctionStorage for MemoryStorage {
             })
             .and_then(|functions| {
                 functions
-                    .get(id)
+                    .get(&id.name)
+                    .and_then(|versions| versions.get(&id.version))
                     .cloned()
                     .ok_or_else(|| StorageError::FunctionNotFound(id.to_string()))
             })
@@ -201,6 +295,28 @@ impl FunctionStorage for MemoryStorage {
             })
     }
 
+    async fn get_attachments(&self, ids: &[Uuid]) -> Result<Vec<FunctionAttachment>, StorageError> {
+        self.attachments
+            .read()
+            .map_err(|e| {
+                StorageError::BackendError(
+                    format!("Failed to acquire read lock for attachments: {}", e).into(),
+                )
+            })
+            .and_then(|attachments| {
+                ids.iter()
+                    .collect::<HashSet<_>>()
+                    .into_iter()
+                    .map(|id| {
+                        attachments
+                            .get(id)
+                            .cloned()
+                            .ok_or_else(|| StorageError::AttachmentNotFound(id.to_string()))
+                    })
+                    .collect()
+            })
+    }
+
     async fn list(&self, filters: &super::Filters) -> Result<Vec<Function>, StorageError> {
         MemoryStorage::list(self, filters, true)
     }
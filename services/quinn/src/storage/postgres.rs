@@ -1,5 +1,5 @@
 use std::{
-    collections::hash_map::HashMap,
+    collections::{hash_map::HashMap, HashSet},
     convert::{TryFrom, TryInto},
     time::SystemTime,
 };
@@ -9,7 +9,7 @@ use firm_types::functions::ChannelType;
 use futures::future::TryFutureExt;
 use postgres_types::{FromSql, ToSql};
 use slog::{info, Logger};
-use tokio_postgres::NoTls;
+use tokio_postgres::{GenericClient, NoTls};
 
 use crate::storage;
 
@@ -49,6 +49,7 @@ struct Function {
     created_at: SystemTime,
     publisher_id: Uuid,
     signature: Option<Vec<u8>>,
+    version_key: String,
 }
 
 #[derive(Debug, ToSql, FromSql)]
@@ -214,6 +215,23 @@ impl From<AttachmentWithPublisher> for storage::FunctionAttachment {
     }
 }
 
+/// Everything needed to insert a function with `insert_functions`
+#[derive(Debug, ToSql, FromSql)]
+#[postgres(name = "function_data")]
+struct FunctionData {
+    name: String,
+    version: Version,
+    metadata: HashMap<String, Option<String>>,
+    code: Option<Uuid>,
+    required_inputs: Vec<ChannelSpec>,
+    optional_inputs: Vec<ChannelSpec>,
+    outputs: Vec<ChannelSpec>,
+    runtime: Runtime,
+    attachment_ids: Vec<Uuid>,
+    publisher_id: Uuid,
+    signature: Option<Vec<u8>>,
+}
+
 #[derive(Debug, ToSql, FromSql)]
 #[postgres(name = "function_with_attachments")]
 struct FunctionWithAttachments {
@@ -488,6 +506,34 @@ impl PostgresStorage {
     }
 }
 
+/// Get the attachments with `ids` using `client`, which can be a connection or a transaction
+///
+/// Fails with `AttachmentNotFound` for the first id that does not exist.
+async fn query_attachments<C: GenericClient>(
+    client: &C,
+    ids: &[Uuid],
+) -> Result<Vec<storage::FunctionAttachment>, storage::StorageError> {
+    let attachments = client
+        .query("select get_attachments($1)", &[&ids])
+        .await
+        .map_err(|e| {
+            storage::StorageError::BackendError(format!("Failed to get attachments: {}", e).into())
+        })?
+        .into_iter()
+        .map(|row| row.get::<_, AttachmentWithPublisher>(0).into())
+        .collect::<Vec<storage::FunctionAttachment>>();
+
+    let found = attachments
+        .iter()
+        .map(|attachment| attachment.id)
+        .collect::<HashSet<_>>();
+    ids.iter()
+        .find(|id| !found.contains(id))
+        .map_or(Ok(attachments), |id| {
+            Err(storage::StorageError::AttachmentNotFound(id.to_string()))
+        })
+}
+
 struct StringAdapter(storage::OrderingKey);
 
 impl std::fmt::Display for StringAdapter {
@@ -546,6 +592,117 @@ impl storage::FunctionStorage for PostgresStorage {
             .and_then(|row| row.get::<_, FunctionWithAttachments>(0).try_into())
     }
 
+    async fn insert_batch(
+        &self,
+        functions: Vec<storage::Function>,
+    ) -> Result<Vec<storage::Function>, storage::StorageError> {
+        // the insert skips functions that already exist so duplicates
+        // in the batch have to be found before inserting
+        let mut seen = HashSet::new();
+        if let Some(duplicate) = functions
+            .iter()
+            .find(|function| !seen.insert((&function.name, &function.version)))
+        {
+            return Err(storage::StorageError::VersionExists {
+                name: duplicate.name.clone(),
+                version: duplicate.version.clone(),
+            });
+        }
+
+        if functions.is_empty() {
+            return Ok(Vec::new());
+        }
+
+        let mut connection = self.get_connection().await?;
+        let transaction = connection
+            .transaction()
+            .await
+            .map_err(|e| storage::StorageError::BackendError(Box::new(e)))?;
+
+        // the attachments have no foreign key for the code so the insert would
+        // accept a missing code attachment, check all of them in one go instead
+        let attachment_ids = functions
+            .iter()
+            .flat_map(|function| function.code.iter().chain(function.attachments.iter()))
+            .copied()
+            .collect::<HashSet<_>>()
+            .into_iter()
+            .collect::<Vec<_>>();
+        if !attachment_ids.is_empty() {
+            query_attachments(&transaction, &attachment_ids).await?;
+        }
+
+        let mut publisher_ids: HashMap<(String, String), Uuid> = HashMap::new();
+        let mut keys = Vec::with_capacity(functions.len());
+        let mut function_data = Vec::with_capacity(functions.len());
+        for function in functions {
+            let publisher_key = (function.publisher.name, function.publisher.email);
+            let publisher_id = match publisher_ids.get(&publisher_key) {
+                Some(id) => *id,
+                None => {
+                    let id = transaction
+                        .query_one(
+                            "select insert_or_get_publisher($1, $2)",
+                            &[&publisher_key.0, &publisher_key.1],
+                        )
+                        .await
+                        .map_err(|e| storage::StorageError::BackendError(Box::new(e)))?
+                        .get::<_, Publisher>(0)
+                        .id;
+                    publisher_ids.insert(publisher_key, id);
+                    id
+                }
+            };
+
+            function_data.push(FunctionData {
+                name: function.name.clone(),
+                version: Version::from(&function.version),
+                metadata: HStore(function.metadata).into(),
+                code: function.code,
+                required_inputs: ChannelSpecs::from(function.required_inputs).0,
+                optional_inputs: ChannelSpecs::from(function.optional_inputs).0,
+                outputs: ChannelSpecs::from(function.outputs).0,
+                runtime: function.runtime.into(),
+                attachment_ids: function.attachments,
+                publisher_id,
+                signature: function.signature,
+            });
+            keys.push((function.name, function.version));
+        }
+
+        let mut inserted = transaction
+            .query("select insert_functions($1)", &[&function_data])
+            .await
+            .map_err(|e| storage::StorageError::BackendError(Box::new(e)))?
+            .into_iter()
+            .map(|row| {
+                storage::Function::try_from(row.get::<_, FunctionWithAttachments>(0))
+                    .map(|function| ((function.name.clone(), function.version.clone()), function))
+            })
+            .collect::<Result<HashMap<_, _>, _>>()?;
+
+        // functions that already exist are skipped by the insert, returning
+        // without committing rolls back the rest of the batch
+        let functions = keys
+            .into_iter()
+            .map(|key| {
+                inserted
+                    .remove(&key)
+                    .ok_or(storage::StorageError::VersionExists {
+                        name: key.0,
+                        version: key.1,
+                    })
+            })
+            .collect::<Result<Vec<_>, _>>()?;
+
+        transaction
+            .commit()
+            .await
+            .map_err(|e| storage::StorageError::BackendError(Box::new(e)))?;
+
+        Ok(functions)
+    }
+
     async fn insert_attachment(
         &self,
         function_attachment_data: storage::FunctionAttachmentData,
@@ -621,6 +778,17 @@ impl storage::FunctionStorage for PostgresStorage {
             .map(|row| row.get::<_, AttachmentWithPublisher>(0).into())
     }
 
+    async fn get_attachments(
+        &self,
+        ids: &[Uuid],
+    ) -> Result<Vec<storage::FunctionAttachment>, storage::StorageError> {
+        if ids.is_empty() {
+            return Ok(Vec::new());
+        }
+
+        query_attachments(&*self.get_connection().await?, ids).await
+    }
+
     async fn list(
         &self,
         filters: &storage::Filters,
@@ -629,7 +797,7 @@ impl storage::FunctionStorage for PostgresStorage {
         self.get_connection()
             .await?
             .query(
-                "select list_functions($1, $2, $3, $4, $5, $6, $7, $8)",
+                "select list_functions($1, $2, $3, $4, $5, $6, $7, $8, $9, $10)",
                 &[
                     &filters.name,
                     &filters.metadata,
@@ -654,6 +822,11 @@ impl storage::FunctionStorage for PostgresStorage {
                             }
                         }),
                     &filters.publisher_email,
+                    &filters.after.as_ref().map(|after| after.name.as_str()),
+                    &filters
+                        .after
+                        .as_ref()
+                        .map(|after| Version::from(&after.version)),
                 ],
             )
             .await
@@ -677,7 +850,7 @@ impl storage::FunctionStorage for PostgresStorage {
         self.get_connection()
             .await?
             .query(
-                "select list_versions($1, $2, $3, $4, $5, $6, $7, $8)",
+                "select list_versions($1, $2, $3, $4, $5, $6, $7, $8, $9, $10)",
                 &[
                     &filters.name,
                     &filters.metadata,
@@ -702,6 +875,11 @@ impl storage::FunctionStorage for PostgresStorage {
                             }
                         }),
                     &filters.publisher_email,
+                    &filters.after.as_ref().map(|after| after.name.as_str()),
+                    &filters
+                        .after
+                        .as_ref()
+                        .map(|after| Version::from(&after.version)),
                 ],
             )
             .await
@@ -1216,6 +1394,61 @@ attachment_storage_uri = "https://i-am-attachment.org"
         });
     }
 
+    #[tokio::test]
+    async fn get_attachments() {
+        with_db!(db, {
+            let storage = db.unwrap();
+            let publisher = storage::Publisher {
+                name: "Sten Snultra".to_owned(),
+                email: "stensnulta@fisk.se".to_owned(),
+            };
+
+            let mut ids = Vec::new();
+            for name in &["first", "second", "third"] {
+                ids.push(
+                    storage
+                        .insert_attachment(storage::FunctionAttachmentData {
+                            name: name.to_string(),
+                            metadata: HashMap::new(),
+                            checksums: super::super::Checksums {
+                                sha256: "6f7c7128c358626cfea2a83173b1626ec18412962969baba819e1ece1b22907e"
+                                    .to_owned(),
+                            },
+                            publisher: publisher.clone(),
+                            signature: None,
+                        })
+                        .await
+                        .unwrap()
+                        .id,
+                );
+            }
+
+            let res = storage.get_attachments(&ids[..2]).await;
+            assert!(res.is_ok());
+            let mut names = res
+                .unwrap()
+                .into_iter()
+                .map(|a| {
+                    assert_eq!(a.data.publisher, publisher);
+                    a.data.name
+                })
+                .collect::<Vec<_>>();
+            names.sort();
+            assert_eq!(names, vec!["first", "second"]);
+
+            // nothing to get
+            let res = storage.get_attachments(&[]).await;
+            assert!(res.unwrap().is_empty());
+
+            // one nonexistent fails them all
+            let res = storage.get_attachments(&[ids[2], Uuid::nil()]).await;
+            assert!(matches!(
+                res.unwrap_err(),
+                storage::StorageError::AttachmentNotFound(id) if id == Uuid::nil().to_string()
+            ));
+        });
+    }
+
     #[tokio::test]
     async fn list() {
         with_db!(db, {
@@ -1392,6 +1625,216 @@ attachment_storage_uri = "https://i-am-attachment.org"
         })
     }
 
+    #[tokio::test]
+    async fn list_latest_version() {
+        with_db!(db, {
+            let storage = db.unwrap();
+            let function = |version: Version| storage::Function {
+                name: "tage".to_owned(),
+                version,
+                runtime: storage::Runtime {
+                    name: "springtid".to_owned(),
+                    entrypoint: String::new(),
+                    arguments: HashMap::new(),
+                },
+                required_inputs: HashMap::new(),
+                optional_inputs: HashMap::new(),
+                outputs: HashMap::new(),
+                metadata: HashMap::new(),
+                code: None,
+                attachments: vec![],
+                created_at: 0,
+                publisher: storage::Publisher {
+                    name: String::from("sune"),
+                    email: String::from("sune@sune.com"),
+                },
+                signature: None,
+            };
+
+            // older versions registered later must not replace the latest
+            for version in &["2.0.0", "1.0.0", "2.0.0-beta"] {
+                storage
+                    .insert(function(Version::parse(version).unwrap()))
+                    .await
+                    .unwrap();
+            }
+
+            let rows = storage
+                .list(&storage::Filters {
+                    name: String::from("ag"),
+                    ..Default::default()
+                })
+                .await
+                .unwrap();
+            assert_eq!(rows.len(), 1);
+            assert_eq!(rows[0].version, Version::new(2, 0, 0));
+
+            storage
+                .insert(function(Version::new(2, 1, 0)))
+                .await
+                .unwrap();
+            let rows = storage.list(&storage::Filters::default()).await.unwrap();
+            assert_eq!(rows.len(), 1);
+            assert_eq!(rows[0].version, Version::new(2, 1, 0));
+
+            // version requirements select the latest matching version
+            let rows = storage
+                .list(&storage::Filters {
+                    version_requirement: Some(VersionReq::parse("<2").unwrap()),
+                    ..Default::default()
+                })
+                .await
+                .unwrap();
+            assert_eq!(rows.len(), 1);
+            assert_eq!(rows[0].version, Version::new(1, 0, 0));
+        });
+    }
+
+    #[tokio::test]
+    async fn insert_batch() {
+        with_db!(db, {
+            let storage = db.unwrap();
+            let function = |name: &str, version: Version| storage::Function {
+                name: name.to_owned(),
+                version,
+                runtime: storage::Runtime {
+                    name: "springtid".to_owned(),
+                    entrypoint: String::new(),
+                    arguments: HashMap::new(),
+                },
+                required_inputs: HashMap::new(),
+                optional_inputs: HashMap::new(),
+                outputs: HashMap::new(),
+                metadata: HashMap::new(),
+                code: None,
+                attachments: vec![],
+                created_at: 0,
+                publisher: storage::Publisher {
+                    name: String::from("sune"),
+                    email: String::from("sune@sune.com"),
+                },
+                signature: None,
+            };
+
+            let inserted = storage
+                .insert_batch(vec![
+                    function("tage", Version::new(1, 0, 0)),
+                    function("tage", Version::new(2, 0, 0)),
+                    function("rune", Version::new(1, 0, 0)),
+                ])
+                .await
+                .unwrap();
+            assert_eq!(
+                inserted
+                    .iter()
+                    .map(|f| (f.name.as_str(), f.version.to_string()))
+                    .collect::<Vec<_>>(),
+                vec![
+                    ("tage", "1.0.0".to_owned()),
+                    ("tage", "2.0.0".to_owned()),
+                    ("rune", "1.0.0".to_owned())
+                ],
+                "Inserted functions must be returned in the order they were given"
+            );
+
+            let rows = storage.list(&storage::Filters::default()).await.unwrap();
+            assert_eq!(rows.len(), 2);
+            assert_eq!(rows[1].name, "tage");
+            assert_eq!(rows[1].version, Version::new(2, 0, 0));
+
+            // one existing version fails the whole batch
+            let res = storage
+                .insert_batch(vec![
+                    function("tage", Version::new(3, 0, 0)),
+                    function("rune", Version::new(1, 0, 0)),
+                ])
+                .await;
+            assert!(matches!(
+                res.unwrap_err(),
+                storage::StorageError::VersionExists { .. }
+            ));
+            assert!(storage
+                .get(&storage::FunctionId {
+                    name: "tage".to_owned(),
+                    version: Version::new(3, 0, 0),
+                })
+                .await
+                .is_err());
+
+            // so do duplicates in the batch itself
+            let res = storage
+                .insert_batch(vec![
+                    function("tage", Version::new(3, 0, 0)),
+                    function("tage", Version::new(3, 0, 0)),
+                ])
+                .await;
+            assert!(matches!(
+                res.unwrap_err(),
+                storage::StorageError::VersionExists { .. }
+            ));
+
+            // and missing attachments, also for the code
+            let attachment = storage
+                .insert_attachment(storage::FunctionAttachmentData {
+                    name: "code".to_owned(),
+                    metadata: HashMap::new(),
+                    checksums: super::super::Checksums {
+                        sha256: "6f7c7128c358626cfea2a83173b1626ec18412962969baba819e1ece1b22907e"
+                            .to_owned(),
+                    },
+                    publisher: storage::Publisher {
+                        name: String::from("sune"),
+                        email: String::from("sune@sune.com"),
+                    },
+                    signature: None,
+                })
+                .await
+                .unwrap()
+                .id;
+            let missing = Uuid::new_v4();
+            let with_code = |name: &str, code: Uuid| storage::Function {
+                code: Some(code),
+                ..function(name, Version::new(3, 0, 0))
+            };
+            let with_attachment = |name: &str, attachment: Uuid| storage::Function {
+                attachments: vec![attachment],
+                ..function(name, Version::new(3, 0, 0))
+            };
+            for batch in vec![
+                vec![with_code("tage", attachment), with_code("rune", missing)],
+                vec![
+                    with_attachment("tage", attachment),
+                    with_attachment("rune", missing),
+                ],
+            ] {
+                let res = storage.insert_batch(batch).await;
+                assert!(matches!(
+                    res.unwrap_err(),
+                    storage::StorageError::AttachmentNotFound(id) if id == missing.to_string()
+                ));
+                assert!(storage
+                    .get(&storage::FunctionId {
+                        name: "tage".to_owned(),
+                        version: Version::new(3, 0, 0),
+                    })
+                    .await
+                    .is_err());
+            }
+
+            let inserted = storage
+                .insert_batch(vec![
+                    with_code("tage", attachment),
+                    with_attachment("rune", attachment),
+                ])
+                .await
+                .unwrap();
+            assert_eq!(inserted[0].code, Some(attachment));
+            assert_eq!(inserted[1].attachments, vec![attachment]);
+
+            assert!(storage.insert_batch(vec![]).await.unwrap().is_empty());
+        });
+    }
+
     #[tokio::test]
     async fn order_offset_and_limit() {
         with_db!(db, {
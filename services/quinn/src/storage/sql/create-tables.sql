@@ -1,5 +1,6 @@
 create extension if not exists "uuid-ossp";
 create extension if not exists "hstore";
+create extension if not exists "pg_trgm";
 
 
 ---------------------------------------------
@@ -84,6 +85,46 @@ create table if not exists functions (
 );
 
 
+-- sortable key for the major, minor and patch parts of a version, prerelease
+-- and build are left out and need to be compared on the version itself
+create or replace function version_key(
+    version_ version
+) returns varchar(32) as
+$$
+    select lpad((version_).major::text, 10, '0') || '.' ||
+           lpad((version_).minor::text, 10, '0') || '.' ||
+           lpad((version_).patch::text, 10, '0');
+$$ language sql immutable;
+
+alter table functions add column if not exists version_key varchar(32) collate "C"
+    generated always as (version_key(version)) stored;
+
+create index if not exists functions_name_version_key_idx on functions (name, version_key);
+
+
+-- trigram index for searching on parts of function names
+create index if not exists functions_name_trgm_idx on functions using gin (name gin_trgm_ops);
+
+
+-- latest version of each function, maintained by insert_function so that
+-- listing functions does not have to rank all versions of all functions
+do $$ begin
+    if not exists (select from pg_tables where schemaname = current_schema() and tablename = 'latest_functions') then
+        create table latest_functions (
+            name varchar(128),
+            version version,
+            function_id uuid references functions (id) on delete cascade on update cascade,
+            constraint latest_name_key primary key(name)
+        );
+
+        insert into latest_functions
+        select distinct on (name) name, version, id from functions order by name, version desc;
+    end if;
+end $$;
+
+create index if not exists latest_functions_name_trgm_idx on latest_functions using gin (name gin_trgm_ops);
+
+
 create table if not exists attachments (
     id uuid primary key default uuid_generate_v4(),
     name varchar(128),
@@ -169,10 +210,104 @@ begin
 
     -- insert attachment ids in relation table
     insert into attachments_to_functions values (inserted_function.id, unnest(attachment_ids));
+
+    insert into latest_functions values (inserted_function.name, inserted_function.version, inserted_function.id)
+    on conflict on constraint latest_name_key do update
+        set version = excluded.version, function_id = excluded.function_id
+        where latest_functions.version < excluded.version;
+
     return row(inserted_function, attachment_ids, (select (publishers::publishers) from publishers where publishers.id = publisher_id limit 1))::function_with_attachments;
 end;
 $$ language plpgsql;
 
+do $$ begin
+    create type function_data as (
+        name varchar(128),
+        version version,
+        metadata hstore,
+        code uuid,
+        required_inputs channel_spec[],
+        optional_inputs channel_spec[],
+        outputs channel_spec[],
+        runtime runtime,
+        attachment_ids uuid[],
+        publisher_id uuid,
+        signature bytea
+    );
+exception
+    when duplicate_object then null;
+end $$;
+
+-- insert several functions in one statement, functions that already exist
+-- are left out of the result for the caller to decide what to do about them
+create or replace function insert_functions (
+    functions_ function_data[]
+) returns setof function_with_attachments as
+$$
+    with new_functions_ as
+    (
+        select * from unnest(functions_)
+    ),
+    inserted_ as
+    (
+        insert into functions (
+            name,
+            version,
+            metadata,
+            code,
+            required_inputs,
+            optional_inputs,
+            outputs,
+            runtime,
+            publisher_id,
+            signature
+        )
+        select
+            name,
+            version,
+            metadata,
+            code,
+            required_inputs,
+            optional_inputs,
+            outputs,
+            runtime,
+            publisher_id,
+            signature
+        from new_functions_
+        on conflict on constraint name_version_key do nothing
+        returning functions::functions as function_
+    ),
+    inserted_attachments_ as
+    (
+        insert into attachments_to_functions
+        select (inserted_.function_).id, unnest(new_functions_.attachment_ids)
+        from inserted_
+        join new_functions_ on
+            new_functions_.name = (inserted_.function_).name
+            and new_functions_.version = (inserted_.function_).version
+    ),
+    latest_ as
+    (
+        insert into latest_functions
+        select distinct on ((function_).name) (function_).name, (function_).version, (function_).id
+        from inserted_
+        order by (function_).name, (function_).version desc
+        on conflict on constraint latest_name_key do update
+            set version = excluded.version, function_id = excluded.function_id
+            where latest_functions.version < excluded.version
+    )
+    select (
+        inserted_.function_,
+        new_functions_.attachment_ids,
+        publishers::publishers
+    )::function_with_attachments
+    from inserted_
+    join new_functions_ on
+        new_functions_.name = (inserted_.function_).name
+        and new_functions_.version = (inserted_.function_).version
+    join publishers on publishers.id = (inserted_.function_).publisher_id;
+$$ language sql;
+
 create or replace function get_function (
     name_ varchar(128),
     version_ version
@@ -230,6 +365,66 @@ $$
 $$ language sql;
 
 
+-- lowest and highest version keys that can match all of the comparators, used
+-- to narrow down the versions to check with version_matches to an index range
+create or replace function version_key_lower_bound(
+    comparators version_comparator[]
+) returns varchar(32) as
+$$
+    select coalesce(max(version_key(comparator.version)), '')
+    from unnest(comparators) as comparator
+    where comparator.op in ('>', '>=', '=');
+$$ language sql immutable;
+
+create or replace function version_key_upper_bound(
+    comparators version_comparator[]
+) returns varchar(32) as
+$$
+    select coalesce(min(version_key(comparator.version)), '~')
+    from unnest(comparators) as comparator
+    where comparator.op in ('<', '<=', '=');
+$$ language sql immutable;
+
+
+-- list functions used to take an offset only, replaced by versions that can continue after a function
+drop function if exists list_functions_internal(varchar, hstore, bigint, bigint, varchar, bool, version_comparator[], varchar, bool);
+-- a function to list with its attachment ids and publisher, nothing if it does
+-- not have the metadata or the publisher asked for
+create or replace function list_functions_row(
+    function_ functions,
+    metadata_ hstore,
+    publisher_email_ varchar(128)
+) returns setof function_with_attachments as
+$$
+    select (
+        function_,
+        array(
+            select attachments_to_functions.attachment_id
+            from attachments_to_functions
+            where attachments_to_functions.function_id = (function_).id
+        ),
+        publishers::publishers
+    )::function_with_attachments
+    from publishers
+    where
+        publishers.id = (function_).publisher_id
+    and
+        (function_).metadata ?& akeys(metadata_)
+    and
+        (
+            -- remove all null values since it is enough that they fulfill the above
+            coalesce((select hstore(array_agg(key), array_agg(value)) from each(metadata_) where value is not null), ''::hstore)
+        ) <@ (function_).metadata
+    and
+        publishers.email like ('%' || publisher_email_ || '%');
+$$ language sql stable;
+
+-- There is one query per direction so that each of them orders by plain index
+-- columns, latest_name_key when grouping versions and name_version_key for the
+-- versions of one function. Postgres then reads the index in order and stops
+-- at the limit instead of sorting everything before every page.
+--
+-- name_version is the only ordering there is, so order_by_ is not looked at.
 create or replace function list_functions_internal(
     name_ varchar(128),
     metadata_ hstore,
@@ -239,54 +434,110 @@ create or replace function list_functions_internal(
     reverse_ bool,
     version_filters_ version_comparator[],
     publisher_email_ varchar(128),
-    group_versions_ bool
+    group_versions_ bool,
+    after_name_ varchar(128),
+    after_version_ version
 ) returns setof function_with_attachments as
 $$
-    with all_ as
-    (
-        select
-            functions::functions as functions_,
-            -- rust does not like nulls in the array (who does?)
-            array_remove(array_agg(attachments_to_functions.attachment_id), null) as attachments_,
-            publishers::publishers as publishers_,
-            row_number() over (partition by functions.name order by version desc) as row_number_
+begin
+    -- a grouped listing continues after the name since a newer version
+    -- might have been registered after the last page
+    if group_versions_ and not reverse_ then
+        return query
+        select listed_.*
+        from latest_functions
+        cross join lateral (
+            select functions::functions as function_
+            from functions
+            where
+                functions.name = latest_functions.name
+            and
+                functions.version_key between version_key_lower_bound(version_filters_)
+                    and version_key_upper_bound(version_filters_)
+            and
+                version_matches(functions.version, version_filters_)
+            order by functions.version desc
+            limit 1
+        ) as latest_
+        cross join lateral list_functions_row(latest_.function_, metadata_, publisher_email_) as listed_
+        where
+            latest_functions.name like ('%' || name_ || '%')
+        and
+            (after_name_ is null or latest_functions.name > after_name_)
+        order by latest_functions.name asc
+        offset offset_ limit limit_;
+
+    elsif group_versions_ then
+        return query
+        select listed_.*
+        from latest_functions
+        cross join lateral (
+            select functions::functions as function_
+            from functions
+            where
+                functions.name = latest_functions.name
+            and
+                functions.version_key between version_key_lower_bound(version_filters_)
+                    and version_key_upper_bound(version_filters_)
+            and
+                version_matches(functions.version, version_filters_)
+            order by functions.version desc
+            limit 1
+        ) as latest_
+        cross join lateral list_functions_row(latest_.function_, metadata_, publisher_email_) as listed_
+        where
+            latest_functions.name like ('%' || name_ || '%')
+        and
+            (after_name_ is null or latest_functions.name < after_name_)
+        order by latest_functions.name desc
+        offset offset_ limit limit_;
+
+    elsif not reverse_ then
+        return query
+        select listed_.*
         from functions
-        left join attachments_to_functions on attachments_to_functions.function_id = functions.id
-        left join publishers on publishers.id = functions.publisher_id
-        where 
-            case when group_versions_ then
-                functions.name like ('%' || name_ || '%')
-            else
-                functions.name = name_
-            end
+        cross join lateral list_functions_row(functions, metadata_, publisher_email_) as listed_
+        where
+            functions.name = name_
+        and
+            functions.version_key between version_key_lower_bound(version_filters_)
+                and version_key_upper_bound(version_filters_)
         and
             version_matches(functions.version, version_filters_)
-        group by functions.name, functions.version, publishers.*
-    )
-    select (functions_, attachments_, publishers_)::function_with_attachments from all_
-    where
-        (row_number_ = 1 or group_versions_ = false)
         and
             (
-                (functions_).metadata ?& akeys(metadata_)
-                and
-                (
-                    -- remove all null values since it is enough that they fulfill the above
-                    coalesce((select hstore(array_agg(key), array_agg(value)) from each(metadata_) where value is not null), ''::hstore)
-                ) <@ (functions_).metadata
+                after_name_ is null
+                or functions.name > after_name_
+                or (functions.name = after_name_ and functions.version < after_version_)
             )
+        order by functions.version desc
+        offset offset_ limit limit_;
+
+    else
+        return query
+        select listed_.*
+        from functions
+        cross join lateral list_functions_row(functions, metadata_, publisher_email_) as listed_
+        where
+            functions.name = name_
         and
-            (publishers_).email like ('%' || publisher_email_ || '%')
-    order by
-        -- TODO: 🤮 This code is very ugly and there is most likely
-        -- a better way to write this
-        case when order_by_ = 'name_version' and not reverse_ then (functions_).name end asc,
-        case when order_by_ = 'name_version' and reverse_ then (functions_).name end desc,
-        case when order_by_ = 'name_version' and not reverse_ then (functions_).version end desc,
-        case when order_by_ = 'name_version' and reverse_ then (functions_).version end asc
-    offset offset_ limit limit_;
-$$ language sql;
+            functions.version_key between version_key_lower_bound(version_filters_)
+                and version_key_upper_bound(version_filters_)
+        and
+            version_matches(functions.version, version_filters_)
+        and
+            (
+                after_name_ is null
+                or functions.name < after_name_
+                or (functions.name = after_name_ and functions.version > after_version_)
+            )
+        order by functions.version asc
+        offset offset_ limit limit_;
+    end if;
+end;
+$$ language plpgsql;
 
+drop function if exists list_functions(varchar, hstore, bigint, bigint, varchar, bool, version_comparator[], varchar);
 create or replace function list_functions(
     name_ varchar(128),
     metadata_ hstore,
@@ -295,7 +546,9 @@ create or replace function list_functions(
     order_by_ varchar(128),
     reverse_ bool,
     version_filters_ version_comparator[],
-    publisher_email_ varchar(128)
+    publisher_email_ varchar(128),
+    after_name_ varchar(128),
+    after_version_ version
 ) returns setof function_with_attachments as
 $$
     select list_functions_internal(
@@ -307,11 +560,14 @@ $$
         reverse_,
         version_filters_,
         publisher_email_,
-        true
+        true,
+        after_name_,
+        after_version_
     );
 $$ language sql;
 
 
+drop function if exists list_versions(varchar, hstore, bigint, bigint, varchar, bool, version_comparator[], varchar);
 create or replace function list_versions(
     name_ varchar(128),
     metadata_ hstore,
@@ -320,7 +576,9 @@ create or replace function list_versions(
     order_by_ varchar(128),
     reverse_ bool,
     version_filters_ version_comparator[],
-    publisher_email_ varchar(128)
+    publisher_email_ varchar(128),
+    after_name_ varchar(128),
+    after_version_ version
 ) returns setof function_with_attachments as
 $$
     select list_functions_internal(
@@ -332,7 +590,9 @@ $$
         reverse_,
         version_filters_,
         publisher_email_,
-        false
+        false,
+        after_name_,
+        after_version_
     );
 $$ language sql;
 
@@ -351,6 +611,20 @@ $$
 $$ language sql;
 
 
+create or replace function get_attachments (
+    ids_ uuid[]
+) returns setof attachment_with_publisher as
+$$
+    select (
+        attachments::attachments,
+        publishers::publishers
+    )::attachment_with_publisher
+    from attachments
+    left join publishers on publishers.id = attachments.publisher_id
+    where attachments.id = any(ids_);
+$$ language sql;
+
+
 create or replace function insert_attachment (
     name varchar(128),
     metadata hstore,
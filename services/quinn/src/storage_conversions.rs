@@ -1,10 +1,11 @@
 use std::{
-    collections::HashMap,
+    collections::{HashMap, HashSet},
     convert::{TryFrom, TryInto},
 };
 
 use firm_types::{
     functions::{Filters, Function as ProtoFunction, FunctionId, OrderingKey},
+    pagination::ContinuationToken,
     tonic,
 };
 
@@ -13,8 +14,8 @@ use crate::{
     validation,
 };
 
-use futures::FutureExt;
 use storage::{Function, FunctionAttachment};
+use uuid::Uuid;
 
 trait CheckEmptyString {
     fn check_empty(self, field_name: &str) -> Result<String, tonic::Status>;
@@ -81,6 +82,16 @@ impl TryFrom<Filters> for storage::Filters {
                 })
                 .transpose()?,
             publisher_email: req.publisher_email,
+            after: ContinuationToken::decode(&req.continuation_token)
+                .map_err(|e| tonic::Status::invalid_argument(e.to_string()))?
+                .map(|token| {
+                    FunctionId {
+                        name: token.name,
+                        version: token.version,
+                    }
+                    .try_into()
+                })
+                .transpose()?,
         })
     }
 }
@@ -260,6 +271,16 @@ pub trait FunctionResolver {
     ) -> Result<ProtoFunction, StorageError>;
 }
 
+/// Resolves many functions at once, fetching all their attachments in one batch
+#[async_trait::async_trait]
+pub trait FunctionsResolver {
+    async fn resolve_functions(
+        self,
+        function_store: &dyn FunctionStorage,
+        attachment_store: &dyn AttachmentStorage,
+    ) -> Result<Vec<ProtoFunction>, StorageError>;
+}
+
 struct AttachmentResolver<'a>(&'a dyn AttachmentStorage, FunctionAttachment);
 
 impl<'a> From<AttachmentResolver<'a>> for firm_types::functions::Attachment {
@@ -285,67 +306,109 @@ impl<'a> From<AttachmentResolver<'a>> for firm_types::functions::Attachment {
     }
 }
 
+fn resolve_attachment(
+    id: &Uuid,
+    attachments: &HashMap<Uuid, FunctionAttachment>,
+    attachment_store: &dyn AttachmentStorage,
+) -> Result<firm_types::functions::Attachment, StorageError> {
+    attachments
+        .get(id)
+        .cloned()
+        .map(|attachment| AttachmentResolver(attachment_store, attachment).into())
+        .ok_or_else(|| StorageError::AttachmentNotFound(id.to_string()))
+}
+
+fn to_proto_function(
+    function: &Function,
+    attachments: &HashMap<Uuid, FunctionAttachment>,
+    attachment_store: &dyn AttachmentStorage,
+) -> Result<ProtoFunction, StorageError> {
+    Ok(ProtoFunction {
+        runtime: Some(firm_types::functions::RuntimeSpec {
+            name: function.runtime.name.clone(),
+            entrypoint: function.runtime.entrypoint.clone(),
+            arguments: function.runtime.arguments.clone(),
+        }),
+        code: function
+            .code
+            .as_ref()
+            .map(|id| resolve_attachment(id, attachments, attachment_store))
+            .transpose()?,
+        name: function.name.clone(),
+        version: function.version.to_string(),
+        metadata: function.metadata.clone(),
+        required_inputs: function
+            .required_inputs
+            .iter()
+            .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
+            .collect(),
+        optional_inputs: function
+            .optional_inputs
+            .iter()
+            .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
+            .collect(),
+        outputs: function
+            .outputs
+            .iter()
+            .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
+            .collect(),
+        attachments: function
+            .attachments
+            .iter()
+            .map(|id| resolve_attachment(id, attachments, attachment_store))
+            .collect::<Result<Vec<_>, _>>()?,
+        created_at: function.created_at,
+        publisher: Some(firm_types::functions::Publisher {
+            name: function.publisher.name.clone(),
+            email: function.publisher.email.clone(),
+        }),
+        signature: function
+            .signature
+            .as_ref()
+            .map(|sig| firm_types::functions::Signature {
+                signature: sig.clone(),
+            }),
+    })
+}
+
+#[async_trait::async_trait]
+impl FunctionsResolver for &[Function] {
+    async fn resolve_functions(
+        self,
+        function_store: &dyn FunctionStorage,
+        attachment_store: &dyn AttachmentStorage,
+    ) -> Result<Vec<ProtoFunction>, StorageError> {
+        let attachment_ids = self
+            .iter()
+            .flat_map(|function| function.code.iter().chain(function.attachments.iter()))
+            .copied()
+            .collect::<HashSet<_>>()
+            .into_iter()
+            .collect::<Vec<_>>();
+
+        let attachments = function_store
+            .get_attachments(&attachment_ids)
+            .await?
+            .into_iter()
+            .map(|attachment| (attachment.id, attachment))
+            .collect::<HashMap<_, _>>();
+
+        self.iter()
+            .map(|function| to_proto_function(function, &attachments, attachment_store))
+            .collect()
+    }
+}
+
 #[async_trait::async_trait]
 impl FunctionResolver for &Function {
-    #[allow(clippy::eval_order_dependence)] // clippy firing on things it shouldn't (https://github.com/rust-lang/rust-clippy/issues/4637)
     async fn resolve_function(
         self,
         function_store: &dyn FunctionStorage,
         attachment_store: &dyn AttachmentStorage,
     ) -> Result<ProtoFunction, StorageError> {
-        Ok(ProtoFunction {
-            runtime: Some(firm_types::functions::RuntimeSpec {
-                name: self.runtime.name.clone(),
-                entrypoint: self.runtime.entrypoint.clone(),
-                arguments: self.runtime.arguments.clone(),
-            }),
-            code: futures::future::OptionFuture::from(
-                self.code
-                    .map(|id| async move { function_store.get_attachment(&id).await }),
-            )
+        std::slice::from_ref(self)
+            .resolve_functions(function_store, attachment_store)
             .await
-            .transpose()?
-            .map(|attachment_data| AttachmentResolver(attachment_store, attachment_data).into()),
-            name: self.name.clone(),
-            version: self.version.to_string(),
-            metadata: self.metadata.clone(),
-            required_inputs: self
-                .required_inputs
-                .iter()
-                .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
-                .collect(),
-            optional_inputs: self
-                .optional_inputs
-                .iter()
-                .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
-                .collect(),
-            outputs: self
-                .outputs
-                .iter()
-                .map(|(k, cs)| (k.to_owned(), cs.clone().into()))
-                .collect(),
-            attachments: futures::future::try_join_all(self.attachments.iter().map(
-                |attachment_id| async move {
-                    function_store
-                        .get_attachment(attachment_id)
-                        .map(|at_res| {
-                            at_res.map(|at| AttachmentResolver(attachment_store, at).into())
-                        })
-                        .await
-                },
-            ))
-            .await?,
-            created_at: self.created_at,
-            publisher: Some(firm_types::functions::Publisher {
-                name: self.publisher.name.clone(),
-                email: self.publisher.email.clone(),
-            }),
-            signature: self
-                .signature
-                .as_ref()
-                .map(|sig| firm_types::functions::Signature {
-                    signature: sig.clone(),
-                }),
-        })
+            .map(|mut functions| functions.remove(0))
     }
 }
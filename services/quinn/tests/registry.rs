@@ -1,7 +1,9 @@
 use ::config::File as ConfigFile;
 
 use firm_types::{
-    functions::{registry_server::Registry, Filters, FunctionId, Ordering},
+    functions::{
+        registry_server::Registry, AttachmentId, Filters, FunctionDataBatch, FunctionId, Ordering,
+    },
     tonic,
 };
 use quinn::{config, registry::RegistryService, storage::OrderingKey};
@@ -59,6 +61,77 @@ fn register_duplicate() {
     ));
 }
 
+#[test]
+fn register_batch() {
+    let registry = registry_with_memory_storage!();
+    let functions = futures::executor::block_on(registry.register_batch(tonic::Request::new(
+        FunctionDataBatch {
+            functions: vec![
+                function_data!("sune", "1.0.0"),
+                function_data!("sune", "1.1.0"),
+                function_data!("rune", "1.0.0"),
+            ],
+        },
+    )))
+    .unwrap()
+    .into_inner()
+    .functions
+    .into_iter()
+    .map(|f| format!("{}:{}", f.name, f.version))
+    .collect::<Vec<_>>();
+    assert_eq!(functions, vec!["sune:1.0.0", "sune:1.1.0", "rune:1.0.0"]);
+
+    // one existing version fails the whole batch
+    let r = futures::executor::block_on(registry.register_batch(tonic::Request::new(
+        FunctionDataBatch {
+            functions: vec![
+                function_data!("tage", "1.0.0"),
+                function_data!("sune", "1.1.0"),
+            ],
+        },
+    )));
+    assert!(matches!(
+        r.unwrap_err().code(),
+        tonic::Code::InvalidArgument
+    ));
+    assert!(
+        futures::executor::block_on(registry.list_versions(tonic::Request::new(filters!("tage"))))
+            .unwrap()
+            .into_inner()
+            .functions
+            .is_empty(),
+        "No functions in a failed batch are expected to be registered"
+    );
+
+    // and so does one missing attachment
+    let r = futures::executor::block_on(registry.register_batch(tonic::Request::new(
+        FunctionDataBatch {
+            functions: vec![
+                function_data!("tage", "1.0.0"),
+                function_data!(
+                    "bune",
+                    "1.0.0",
+                    runtime_spec!(),
+                    None,
+                    [AttachmentId {
+                        uuid: uuid::Uuid::new_v4().to_string()
+                    }],
+                    {}
+                ),
+            ],
+        },
+    )));
+    assert!(matches!(r.unwrap_err().code(), tonic::Code::NotFound));
+    assert!(
+        futures::executor::block_on(registry.list_versions(tonic::Request::new(filters!("tage"))))
+            .unwrap()
+            .into_inner()
+            .functions
+            .is_empty(),
+        "No functions in a failed batch are expected to be registered"
+    );
+}
+
 #[test]
 fn register_attachment() {
     let registry = registry_with_memory_storage!();
@@ -122,6 +195,70 @@ fn list_function() {
     );
 }
 
+#[test]
+fn list_functions_with_attachments() {
+    let registry = registry_with_memory_storage!();
+    let attachment_ids = ["code", "shared", "own"]
+        .iter()
+        .map(|name| {
+            futures::executor::block_on(
+                registry.register_attachment(tonic::Request::new(attachment_data!(*name))),
+            )
+            .unwrap()
+            .into_inner()
+            .id
+            .unwrap()
+        })
+        .collect::<Vec<_>>();
+
+    futures::executor::block_on(registry.register(tonic::Request::new(function_data!(
+        "with-code",
+        "1.0.0",
+        runtime_spec!(),
+        attachment_ids[0].clone(),
+        [attachment_ids[1].clone()],
+        {}
+    ))))
+    .unwrap();
+    futures::executor::block_on(registry.register(tonic::Request::new(function_data!(
+        "without-code",
+        "1.0.0",
+        runtime_spec!(),
+        None,
+        [attachment_ids[1].clone(), attachment_ids[2].clone()],
+        {}
+    ))))
+    .unwrap();
+
+    let functions = futures::executor::block_on(registry.list(tonic::Request::new(filters!())))
+        .unwrap()
+        .into_inner()
+        .functions;
+    assert_eq!(functions.len(), 2);
+
+    assert_eq!(functions[0].name, "with-code");
+    assert_eq!(functions[0].code.as_ref().unwrap().name, "code");
+    assert_eq!(
+        functions[0]
+            .attachments
+            .iter()
+            .map(|a| a.name.as_str())
+            .collect::<Vec<_>>(),
+        vec!["shared"]
+    );
+
+    assert_eq!(functions[1].name, "without-code");
+    assert!(functions[1].code.is_none());
+    assert_eq!(
+        functions[1]
+            .attachments
+            .iter()
+            .map(|a| a.name.as_str())
+            .collect::<Vec<_>>(),
+        vec!["shared", "own"]
+    );
+}
+
 // Filtering
 #[test]
 fn list_functions() {
@@ -394,6 +531,7 @@ fn sorting() {
 
             version_requirement: None,
             publisher_email: String::from("legs.mcrunfast@people.com"),
+            continuation_token: String::new(),
         })));
 
     assert!(list_request.is_ok());
@@ -423,6 +561,7 @@ fn sorting() {
 
             version_requirement: None,
             publisher_email: String::from("legs.mcrunfast@people.com"),
+            continuation_token: String::new(),
         })));
 
     assert!(list_request.is_ok());
@@ -503,6 +642,7 @@ fn sorting() {
 
         version_requirement: None,
         publisher_email: String::from("smash.limpjaw@employee.com"),
+        continuation_token: String::new(),
     })));
     assert!(list_request.is_ok());
     let functions = list_request.unwrap().into_inner().functions;
@@ -521,3 +661,135 @@ fn sorting() {
         "Reversed sorting of functions should put 1.1.0 first"
     );
 }
+
+#[test]
+fn paging() {
+    let registry = registry_with_memory_storage!();
+    ["a", "b", "c", "d", "e"].iter().for_each(|name| {
+        ["1.0.0", "1.1.0", "2.0.0"].iter().for_each(|version| {
+            futures::executor::block_on(
+                registry.register(tonic::Request::new(function_data!(*name, *version))),
+            )
+            .unwrap();
+        })
+    });
+
+    let page_through = |filters: Filters, list_versions: bool| {
+        let mut filters = filters;
+        let mut pages = Vec::new();
+        loop {
+            let functions = futures::executor::block_on(if list_versions {
+                registry.list_versions(tonic::Request::new(filters.clone()))
+            } else {
+                registry.list(tonic::Request::new(filters.clone()))
+            })
+            .unwrap()
+            .into_inner();
+            pages.push(
+                functions
+                    .functions
+                    .into_iter()
+                    .map(|f| format!("{}:{}", f.name, f.version))
+                    .collect::<Vec<_>>(),
+            );
+            if functions.continuation_token.is_empty() {
+                break pages;
+            }
+            filters.continuation_token = functions.continuation_token;
+        }
+    };
+
+    let mut filters = filters!("", 2, 0, {});
+    assert_eq!(
+        page_through(filters.clone(), false),
+        vec![
+            vec!["a:2.0.0", "b:2.0.0"],
+            vec!["c:2.0.0", "d:2.0.0"],
+            vec!["e:2.0.0"]
+        ]
+    );
+
+    filters.order.as_mut().unwrap().reverse = true;
+    assert_eq!(
+        page_through(filters.clone(), false),
+        vec![
+            vec!["e:2.0.0", "d:2.0.0"],
+            vec!["c:2.0.0", "b:2.0.0"],
+            vec!["a:2.0.0"]
+        ]
+    );
+
+    // a newer version registered between pages does not repeat the name
+    let functions =
+        futures::executor::block_on(registry.list(tonic::Request::new(filters.clone())))
+            .unwrap()
+            .into_inner();
+    futures::executor::block_on(
+        registry.register(tonic::Request::new(function_data!("d", "3.0.0"))),
+    )
+    .unwrap();
+    filters.continuation_token = functions.continuation_token;
+    assert_eq!(
+        futures::executor::block_on(registry.list(tonic::Request::new(filters)))
+            .unwrap()
+            .into_inner()
+            .functions
+            .into_iter()
+            .map(|f| format!("{}:{}", f.name, f.version))
+            .collect::<Vec<_>>(),
+        vec!["c:2.0.0", "b:2.0.0"]
+    );
+
+    // a full last page gives one more, empty, page
+    assert_eq!(
+        page_through(filters!("c", 2, 0, {}), true),
+        vec![vec!["c:2.0.0", "c:1.1.0"], vec!["c:1.0.0"]]
+    );
+    assert_eq!(
+        page_through(filters!("c", 3, 0, {}), true),
+        vec![vec!["c:2.0.0", "c:1.1.0", "c:1.0.0"], vec![]]
+    );
+
+    let mut filters = filters!("", 2, 0, {});
+    filters.continuation_token = String::from("not a token");
+    let res = futures::executor::block_on(registry.list(tonic::Request::new(filters)));
+    assert!(matches!(
+        res.unwrap_err().code(),
+        tonic::Code::InvalidArgument
+    ));
+}
+
+#[test]
+fn list_versions_exact_name() {
+    let registry = registry_with_memory_storage!();
+    [("sune", "1.0.0"), ("sune", "1.1.0"), ("sune-a", "2.0.0")]
+        .iter()
+        .for_each(|(name, version)| {
+            futures::executor::block_on(
+                registry.register(tonic::Request::new(function_data!(*name, *version))),
+            )
+            .unwrap();
+        });
+
+    let functions =
+        futures::executor::block_on(registry.list_versions(tonic::Request::new(filters!("sune"))))
+            .unwrap()
+            .into_inner()
+            .functions
+            .into_iter()
+            .map(|f| format!("{}:{}", f.name, f.version))
+            .collect::<Vec<_>>();
+    assert_eq!(
+        functions,
+        vec!["sune:1.1.0", "sune:1.0.0"],
+        "Only versions of the function with exactly that name are expected"
+    );
+
+    // list still matches on parts of the name
+    let functions =
+        futures::executor::block_on(registry.list(tonic::Request::new(filters!("sune"))))
+            .unwrap()
+            .into_inner()
+            .functions;
+    assert_eq!(functions.len(), 2);
+}